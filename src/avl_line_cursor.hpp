@@ -0,0 +1,99 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+  line cursor for the AVL-of-leaves cores (rope, prope). it keeps the
+  root-to-leaf path of its row, so next/prev stay inside the current leaf
+  most of the time and only climb when they cross a leaf boundary: a full
+  pass is O(n) instead of one O(log n) descent per line.
+  Node needs left/right (raw or smart pointers), lines_count and a lines
+  container whose elements convert to string_view.
+*/
+template <typename Node>
+class AvlLineCursor {
+public:
+  AvlLineCursor(const Node* root, int r) : root_(root) { seek(r); }
+
+  bool valid() const { return leaf_ != nullptr; }
+  int row() const { return row_; }
+
+  void seek(int r) {
+    path_.clear();
+    leaf_ = nullptr;
+    row_ = r;
+    if (!root_ || r < 0 || static_cast<size_t>(r) >= root_->lines_count) return;
+    const Node* n = root_;
+    size_t k = static_cast<size_t>(r);
+    while (!is_leaf(n)) {
+      path_.push_back(n);
+      size_t lc = left(n)->lines_count;
+      if (k < lc) n = left(n);
+      else { k -= lc; n = right(n); }
+    }
+    leaf_ = n;
+    idx_ = k;
+  }
+
+  void next() {
+    if (!leaf_) { seek(row_ + 1); return; }
+    ++row_;
+    if (idx_ + 1 < leaf_->lines.size()) { ++idx_; return; }
+    const Node* child = leaf_;
+    while (!path_.empty()) {
+      const Node* p = path_.back();
+      if (left(p) == child) {
+        const Node* n = right(p);
+        while (!is_leaf(n)) { path_.push_back(n); n = left(n); }
+        leaf_ = n;
+        idx_ = 0;
+        return;
+      }
+      child = p;
+      path_.pop_back();
+    }
+    leaf_ = nullptr;
+  }
+
+  void prev() {
+    if (!leaf_) { seek(row_ - 1); return; }
+    --row_;
+    if (idx_ > 0) { --idx_; return; }
+    const Node* child = leaf_;
+    while (!path_.empty()) {
+      const Node* p = path_.back();
+      if (right(p) == child) {
+        const Node* n = left(p);
+        while (!is_leaf(n)) { path_.push_back(n); n = right(n); }
+        leaf_ = n;
+        idx_ = n->lines.size() - 1;
+        return;
+      }
+      child = p;
+      path_.pop_back();
+    }
+    leaf_ = nullptr;
+  }
+
+  /*leaf lines are contiguous, scratch is never needed*/
+  std::string_view view(std::string&) const { return line(); }
+  size_t length() const { return line().size(); }
+  std::string slice(size_t col, size_t len) const {
+    std::string_view v = line();
+    return col < v.size() ? std::string(v.substr(col, len)) : std::string();
+  }
+
+private:
+  static const Node* left(const Node* n) { return std::to_address(n->left); }
+  static const Node* right(const Node* n) { return std::to_address(n->right); }
+  static bool is_leaf(const Node* n) { return !n->left && !n->right; }
+  std::string_view line() const { return std::string_view(leaf_->lines[idx_]); }
+
+  const Node* root_;
+  std::vector<const Node*> path_; /* internal nodes above leaf_ */
+  const Node* leaf_ = nullptr;
+  size_t idx_ = 0;
+  int row_ = 0;
+};
@@ -0,0 +1,440 @@
+#include "btree_text_buffer_core.hpp"
+#include <algorithm>
+#include <iterator>
+
+size_t BTreeTextBufferCore::total(const Node* n) {
+  if (!n) return 0;
+  if (n->leaf) return static_cast<const Leaf*>(n)->lines.size();
+  const Inner* in = static_cast<const Inner*>(n);
+  size_t t = 0;
+  for (int i = 0; i < in->n; ++i) t += in->counts[i];
+  return t;
+}
+
+size_t BTreeTextBufferCore::fill(const Node* n) {
+  if (n->leaf) return static_cast<const Leaf*>(n)->lines.size();
+  return static_cast<size_t>(static_cast<const Inner*>(n)->n);
+}
+
+bool BTreeTextBufferCore::underflow(const Node* n) {
+  return fill(n) < (n->leaf ? LEAF_MIN_LINES : static_cast<size_t>(MIN_FANOUT));
+}
+
+int BTreeTextBufferCore::find_child(const Inner* in, size_t& row) {
+  int i = 0;
+  while (i + 1 < in->n && row >= in->counts[i]) { row -= in->counts[i]; ++i; }
+  return i;
+}
+
+// split m items into ceil(m / cap) groups of near-equal size (each >= cap / 2)
+static std::vector<size_t> group_sizes(size_t m, size_t cap) {
+  size_t g = std::max<size_t>(1, (m + cap - 1) / cap);
+  std::vector<size_t> sizes(g, m / g);
+  for (size_t i = 0; i < m % g; ++i) sizes[i]++;
+  return sizes;
+}
+
+BTreeTextBufferCore::NodeList BTreeTextBufferCore::make_leaves(std::vector<std::string>&& lines) {
+  NodeList out;
+  size_t pos = 0;
+  for (size_t sz : group_sizes(lines.size(), LEAF_MAX_LINES)) {
+    auto leaf = std::make_unique<Leaf>();
+    leaf->lines.reserve(LEAF_MAX_LINES);
+    leaf->lines.insert(leaf->lines.end(), std::make_move_iterator(lines.begin() + pos),
+                       std::make_move_iterator(lines.begin() + pos + sz));
+    pos += sz;
+    out.push_back(std::move(leaf));
+  }
+  return out;
+}
+
+BTreeTextBufferCore::NodeList BTreeTextBufferCore::make_inners(NodeList&& kids) {
+  NodeList out;
+  size_t pos = 0;
+  for (size_t sz : group_sizes(kids.size(), FANOUT)) {
+    auto in = std::make_unique<Inner>();
+    for (size_t k = 0; k < sz; ++k, ++pos) {
+      in->counts[in->n] = static_cast<uint32_t>(total(kids[pos].get()));
+      in->kids[in->n++] = std::move(kids[pos]);
+    }
+    out.push_back(std::move(in));
+  }
+  return out;
+}
+
+// inserts ss before local row of n; returns the new right siblings of n when it had to split
+BTreeTextBufferCore::NodeList BTreeTextBufferCore::insert_rec(Node* n, size_t row, std::span<const std::string> ss) {
+  if (n->leaf) {
+    auto& lines = static_cast<Leaf*>(n)->lines;
+    lines.insert(lines.begin() + row, ss.begin(), ss.end());
+    if (lines.size() <= LEAF_MAX_LINES) return {};
+    auto sizes = group_sizes(lines.size(), LEAF_MAX_LINES);
+    std::vector<std::string> rest(std::make_move_iterator(lines.begin() + sizes[0]),
+                                  std::make_move_iterator(lines.end()));
+    lines.erase(lines.begin() + sizes[0], lines.end());
+    return make_leaves(std::move(rest));
+  }
+  Inner* in = static_cast<Inner*>(n);
+  int i = 0;
+  while (i + 1 < in->n && row > in->counts[i]) { row -= in->counts[i]; ++i; }
+  NodeList extra = insert_rec(in->kids[i].get(), row, ss);
+  in->counts[i] = static_cast<uint32_t>(total(in->kids[i].get()));
+  if (extra.empty()) return {};
+  int k = static_cast<int>(extra.size());
+  if (in->n + k <= FANOUT) {
+    for (int j = in->n - 1; j > i; --j) {
+      in->kids[j + k] = std::move(in->kids[j]);
+      in->counts[j + k] = in->counts[j];
+    }
+    for (int j = 0; j < k; ++j) {
+      in->counts[i + 1 + j] = static_cast<uint32_t>(total(extra[j].get()));
+      in->kids[i + 1 + j] = std::move(extra[j]);
+    }
+    in->n += k;
+    return {};
+  }
+  // overflow: lay all children out in order and regroup them; n keeps the first group
+  NodeList all;
+  all.reserve(in->n + k);
+  for (int j = 0; j <= i; ++j) all.push_back(std::move(in->kids[j]));
+  for (auto& e : extra) all.push_back(std::move(e));
+  for (int j = i + 1; j < in->n; ++j) all.push_back(std::move(in->kids[j]));
+  auto sizes = group_sizes(all.size(), FANOUT);
+  in->n = 0;
+  for (size_t j = 0; j < sizes[0]; ++j) {
+    in->counts[in->n] = static_cast<uint32_t>(total(all[j].get()));
+    in->kids[in->n++] = std::move(all[j]);
+  }
+  return make_inners(NodeList(std::make_move_iterator(all.begin() + sizes[0]),
+                              std::make_move_iterator(all.end())));
+}
+
+void BTreeTextBufferCore::remove_kid(Inner* in, int i) {
+  for (int j = i; j + 1 < in->n; ++j) {
+    in->kids[j] = std::move(in->kids[j + 1]);
+    in->counts[j] = in->counts[j + 1];
+  }
+  in->n--;
+  in->kids[in->n].reset();
+  in->counts[in->n] = 0;
+}
+
+// merge kids l and l+1 when they fit in one node, otherwise even them out
+void BTreeTextBufferCore::merge_or_rebalance(Inner* in, int l) {
+  Node* a = in->kids[l].get();
+  Node* b = in->kids[l + 1].get();
+  if (a->leaf) {
+    auto& la = static_cast<Leaf*>(a)->lines;
+    auto& lb = static_cast<Leaf*>(b)->lines;
+    size_t sum = la.size() + lb.size();
+    if (sum <= LEAF_MAX_LINES) {
+      la.insert(la.end(), std::make_move_iterator(lb.begin()), std::make_move_iterator(lb.end()));
+      in->counts[l] = static_cast<uint32_t>(la.size());
+      remove_kid(in, l + 1);
+      return;
+    }
+    size_t want = sum / 2;
+    if (la.size() < want) {
+      size_t k = want - la.size();
+      la.insert(la.end(), std::make_move_iterator(lb.begin()), std::make_move_iterator(lb.begin() + k));
+      lb.erase(lb.begin(), lb.begin() + k);
+    } else {
+      size_t k = la.size() - want;
+      lb.insert(lb.begin(), std::make_move_iterator(la.end() - k), std::make_move_iterator(la.end()));
+      la.erase(la.end() - k, la.end());
+    }
+    in->counts[l] = static_cast<uint32_t>(la.size());
+    in->counts[l + 1] = static_cast<uint32_t>(lb.size());
+    return;
+  }
+  Inner* ia = static_cast<Inner*>(a);
+  Inner* ib = static_cast<Inner*>(b);
+  int sum = ia->n + ib->n;
+  if (sum <= FANOUT) {
+    for (int j = 0; j < ib->n; ++j) {
+      ia->counts[ia->n] = ib->counts[j];
+      ia->kids[ia->n++] = std::move(ib->kids[j]);
+    }
+    in->counts[l] = static_cast<uint32_t>(total(ia));
+    remove_kid(in, l + 1);
+    // a range erase can leave a lone short child on either side of the seam
+    fix_underflow(ia);
+    return;
+  }
+  int want = sum / 2;
+  if (ia->n < want) {
+    int k = want - ia->n;
+    for (int j = 0; j < k; ++j) {
+      ia->counts[ia->n] = ib->counts[j];
+      ia->kids[ia->n++] = std::move(ib->kids[j]);
+    }
+    for (int j = k; j < ib->n; ++j) {
+      ib->kids[j - k] = std::move(ib->kids[j]);
+      ib->counts[j - k] = ib->counts[j];
+    }
+    ib->n -= k;
+  } else {
+    int k = ia->n - want;
+    for (int j = ib->n - 1; j >= 0; --j) {
+      ib->kids[j + k] = std::move(ib->kids[j]);
+      ib->counts[j + k] = ib->counts[j];
+    }
+    for (int j = 0; j < k; ++j) {
+      ib->kids[j] = std::move(ia->kids[want + j]);
+      ib->counts[j] = ia->counts[want + j];
+    }
+    ib->n += k;
+    ia->n = want;
+  }
+  in->counts[l] = static_cast<uint32_t>(total(ia));
+  in->counts[l + 1] = static_cast<uint32_t>(total(ib));
+  fix_underflow(ia);
+  fix_underflow(ib);
+}
+
+void BTreeTextBufferCore::fix_underflow(Inner* in) {
+  int i = 0;
+  while (i < in->n && in->n > 1) {
+    if (!underflow(in->kids[i].get())) { ++i; continue; }
+    int l = (i + 1 < in->n) ? i : i - 1;
+    int before = in->n;
+    merge_or_rebalance(in, l);
+    // after a merge the combined node may still be short, so look at it again
+    i = (in->n < before) ? l : l + 2;
+  }
+}
+
+// erase local rows [a, b) of n; whole children are dropped, partial ones recursed into
+void BTreeTextBufferCore::erase_rec(Node* n, size_t a, size_t b) {
+  if (n->leaf) {
+    auto& lines = static_cast<Leaf*>(n)->lines;
+    lines.erase(lines.begin() + a, lines.begin() + b);
+    return;
+  }
+  Inner* in = static_cast<Inner*>(n);
+  size_t off = 0;
+  int w = 0;
+  for (int i = 0; i < in->n; ++i) {
+    size_t c = in->counts[i];
+    size_t lo = std::max(a, off), hi = std::min(b, off + c);
+    if (lo < hi && lo == off && hi == off + c) { in->kids[i].reset(); off += c; continue; }
+    if (lo < hi) {
+      erase_rec(in->kids[i].get(), lo - off, hi - off);
+      in->counts[i] = static_cast<uint32_t>(total(in->kids[i].get()));
+    }
+    off += c;
+    if (w != i) { in->kids[w] = std::move(in->kids[i]); in->counts[w] = in->counts[i]; }
+    ++w;
+  }
+  for (int i = w; i < in->n; ++i) { in->kids[i].reset(); in->counts[i] = 0; }
+  in->n = w;
+  fix_underflow(in);
+}
+
+void BTreeTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
+  adopt_lines(std::vector<std::string>(lines));
+}
+
+void BTreeTextBufferCore::adopt_lines(std::vector<std::string>&& lines) {
+  root_.reset();
+  count_ = lines.size();
+  if (lines.empty()) return;
+  NodeList level = make_leaves(std::move(lines));
+  lines.clear();
+  while (level.size() > 1) level = make_inners(std::move(level));
+  root_ = std::move(level.front());
+}
+
+std::string BTreeTextBufferCore::get_line(int r) const {
+  std::string scratch;
+  return std::string(get_line_view(r, scratch));
+}
+
+std::string_view BTreeTextBufferCore::get_line_view(int r, std::string&) const {
+  if (r < 0 || static_cast<size_t>(r) >= count_) return {};
+  size_t row = static_cast<size_t>(r);
+  const Node* cur = root_.get();
+  while (!cur->leaf) {
+    const Inner* in = static_cast<const Inner*>(cur);
+    cur = in->kids[find_child(in, row)].get();
+  }
+  return static_cast<const Leaf*>(cur)->lines[row];
+}
+
+void BTreeTextBufferCore::insert_line(size_t row, const std::string& s) {
+  insert_lines(row, std::span<const std::string>(&s, 1));
+}
+
+void BTreeTextBufferCore::insert_line(size_t row, std::string_view s) {
+  std::string tmp(s);
+  insert_lines(row, std::span<const std::string>(&tmp, 1));
+}
+
+void BTreeTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
+  insert_lines(row, std::span<const std::string>(ss.begin(), ss.end()));
+}
+
+void BTreeTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  if (ss.empty()) return;
+  if (row > count_) row = count_;
+  if (!root_) root_ = std::make_unique<Leaf>();
+  NodeList extra = insert_rec(root_.get(), row, ss);
+  count_ += ss.size();
+  // the root split: grow the tree upwards until one node is left
+  if (!extra.empty()) {
+    NodeList level;
+    level.push_back(std::move(root_));
+    for (auto& e : extra) level.push_back(std::move(e));
+    while (level.size() > 1) level = make_inners(std::move(level));
+    root_ = std::move(level.front());
+  }
+}
+
+void BTreeTextBufferCore::erase_line(size_t row) { erase_lines(row, row + 1); }
+
+void BTreeTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
+  if (end_row < start_row) end_row = start_row;
+  if (start_row >= count_) return;
+  if (end_row > count_) end_row = count_;
+  if (start_row == end_row) return;
+  if (start_row == 0 && end_row == count_) { root_.reset(); count_ = 0; return; }
+  erase_rec(root_.get(), start_row, end_row);
+  count_ -= end_row - start_row;
+  // collapse single-child roots left behind by merges
+  while (!root_->leaf && static_cast<Inner*>(root_.get())->n == 1) {
+    root_ = std::move(static_cast<Inner*>(root_.get())->kids[0]);
+  }
+}
+
+void BTreeTextBufferCore::replace_line(size_t row, const std::string& s) { replace_line(row, std::string_view(s)); }
+
+std::string& BTreeTextBufferCore::line_ref(size_t row) {
+  Node* cur = root_.get();
+  while (!cur->leaf) {
+    Inner* in = static_cast<Inner*>(cur);
+    cur = in->kids[find_child(in, row)].get();
+  }
+  return static_cast<Leaf*>(cur)->lines[row];
+}
+
+void BTreeTextBufferCore::replace_line(size_t row, std::string_view s) {
+  if (row >= count_) return;
+  line_ref(row).assign(s.data(), s.size());
+}
+
+/*the line is edited in its leaf, only the touched bytes of it move*/
+void BTreeTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= count_ || s.empty()) return;
+  std::string& l = line_ref(row);
+  l.insert(std::min(col, l.size()), s);
+}
+
+void BTreeTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= count_) return;
+  std::string& l = line_ref(row);
+  if (col < l.size()) l.erase(col, len);
+}
+
+void BTreeTextBufferCore::split_line(size_t row, size_t col) {
+  if (row >= count_) return;
+  std::string& l = line_ref(row);
+  col = std::min(col, l.size());
+  std::string tail(l, col);
+  l.erase(col);
+  insert_line(row + 1, std::string_view(tail));
+}
+
+void BTreeTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= count_) return;
+  std::string next = get_line(static_cast<int>(row + 1));
+  line_ref(row) += next;
+  erase_line(row + 1);
+}
+
+void BTreeTextBufferCore::LineCursor::seek(int r) {
+  path_.clear();
+  leaf_ = nullptr;
+  row_ = r;
+  if (!root_ || r < 0 || static_cast<size_t>(r) >= total(root_)) return;
+  size_t row = static_cast<size_t>(r);
+  const Node* cur = root_;
+  while (!cur->leaf) {
+    const Inner* in = static_cast<const Inner*>(cur);
+    int i = find_child(in, row);
+    path_.emplace_back(in, i);
+    cur = in->kids[i].get();
+  }
+  leaf_ = static_cast<const Leaf*>(cur);
+  idx_ = row;
+}
+
+void BTreeTextBufferCore::LineCursor::descend(const Node* n, bool leftmost) {
+  while (!n->leaf) {
+    const Inner* in = static_cast<const Inner*>(n);
+    int i = leftmost ? 0 : in->n - 1;
+    path_.emplace_back(in, i);
+    n = in->kids[i].get();
+  }
+  leaf_ = static_cast<const Leaf*>(n);
+  idx_ = leftmost ? 0 : leaf_->lines.size() - 1;
+}
+
+void BTreeTextBufferCore::LineCursor::next() {
+  if (!leaf_) { seek(row_ + 1); return; }
+  ++row_;
+  if (idx_ + 1 < leaf_->lines.size()) { ++idx_; return; }
+  while (!path_.empty()) {
+    auto& [in, i] = path_.back();
+    if (i + 1 < in->n) { ++i; descend(in->kids[i].get(), true); return; }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void BTreeTextBufferCore::LineCursor::prev() {
+  if (!leaf_) { seek(row_ - 1); return; }
+  --row_;
+  if (idx_ > 0) { --idx_; return; }
+  while (!path_.empty()) {
+    auto& [in, i] = path_.back();
+    if (i > 0) { --i; descend(in->kids[i].get(), false); return; }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+int BTreeTextBufferCore::height() const {
+  int h = 0;
+  for (const Node* cur = root_.get(); cur; ++h) {
+    cur = cur->leaf ? nullptr : static_cast<const Inner*>(cur)->kids[0].get();
+  }
+  return h;
+}
+
+bool BTreeTextBufferCore::check_invariants(std::string* why) const {
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  if (!root_) return count_ == 0 ? true : fail("empty tree with nonzero count");
+  if (total(root_.get()) != count_) return fail("bad cached line count");
+  int leaf_depth = -1;
+  bool ok = true;
+  auto walk = [&](auto&& self, const Node* n, int depth, bool is_root) -> void {
+    if (!ok) return;
+    if (n->leaf) {
+      size_t sz = static_cast<const Leaf*>(n)->lines.size();
+      if (leaf_depth < 0) leaf_depth = depth;
+      if (depth != leaf_depth) ok = fail("leaves at different depths");
+      else if (sz == 0 || sz > LEAF_MAX_LINES) ok = fail("leaf size out of bounds");
+      else if (!is_root && sz < LEAF_MIN_LINES) ok = fail("leaf underflow");
+      return;
+    }
+    const Inner* in = static_cast<const Inner*>(n);
+    if (in->n > FANOUT || in->n < (is_root ? 2 : MIN_FANOUT)) { ok = fail("fanout out of bounds"); return; }
+    for (int i = 0; i < in->n; ++i) {
+      if (!in->kids[i]) { ok = fail("missing child"); return; }
+      if (in->counts[i] != total(in->kids[i].get())) { ok = fail("bad child count"); return; }
+      self(self, in->kids[i].get(), depth + 1, false);
+    }
+  };
+  walk(walk, root_.get(), 0, true);
+  return ok;
+}
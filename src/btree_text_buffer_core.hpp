@@ -0,0 +1,131 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include "i_text_buffer_core.hpp"
+
+/*
+  b+tree backend: wide internal nodes keep their children's line counts in
+  one contiguous array, so finding the child for a row is a short linear
+  scan over one or two cache lines instead of a pointer chase per level.
+  all leaves sit at the same depth and hold up to LEAF_MAX_LINES lines.
+*/
+class BTreeTextBufferCore : public TextBufferCoreCRTP<BTreeTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "btree"; }
+  static constexpr int FANOUT = 32;
+  static constexpr int MIN_FANOUT = FANOUT / 2;
+  static constexpr size_t LEAF_MAX_LINES = 64;
+  static constexpr size_t LEAF_MIN_LINES = LEAF_MAX_LINES / 4;
+
+  void init_from_lines(const std::vector<std::string>& lines);
+  void adopt_lines(std::vector<std::string>&& lines);
+  int line_count() const { return static_cast<int>(count_); }
+  std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
+
+  void insert_line(size_t row, const std::string& s);
+  void insert_line(size_t row, std::string_view s);
+  void insert_lines(size_t row, const std::vector<std::string>& ss);
+  void insert_lines(size_t row, std::span<const std::string> ss);
+  void erase_line(size_t row);
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
+  void replace_line(size_t row, const std::string& s);
+  void replace_line(size_t row, std::string_view s);
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col);
+  void join_lines(size_t row);
+
+  /*debug: verify uniform depth, counts and fill bounds*/
+  bool check_invariants(std::string* why = nullptr) const;
+  int height() const;
+
+  /*forward to CRTP impl*/
+  void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_adopt_lines(std::vector<std::string>&& lines) { adopt_lines(std::move(lines)); }
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
+  void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
+  void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
+  void do_erase_line(size_t row) { erase_line(row); }
+  void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
+  void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
+  void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+
+private:
+  struct Node {
+    explicit Node(bool is_leaf) : leaf(is_leaf) {}
+    virtual ~Node() = default;
+    bool leaf;
+  };
+  struct Leaf : Node {
+    Leaf() : Node(true) {}
+    std::vector<std::string> lines;
+  };
+  struct Inner : Node {
+    Inner() : Node(false) {}
+    int n = 0;                              /* children in use */
+    uint32_t counts[FANOUT] = {};           /* lines under each child, contiguous for the scan */
+    std::unique_ptr<Node> kids[FANOUT];
+  };
+  using NodeList = std::vector<std::unique_ptr<Node>>;
+
+  std::unique_ptr<Node> root_;
+  size_t count_ = 0;
+
+  static size_t total(const Node* n);
+  static size_t fill(const Node* n);
+  static bool underflow(const Node* n);
+  /*index of the child holding row; row becomes relative to that child*/
+  static int find_child(const Inner* in, size_t& row);
+  /*descends to the leaf holding row and hands out its line for in-place edits*/
+  std::string& line_ref(size_t row);
+  static NodeList make_leaves(std::vector<std::string>&& lines);
+  static NodeList make_inners(NodeList&& kids);
+  static NodeList insert_rec(Node* n, size_t row, std::span<const std::string> ss);
+  static void erase_rec(Node* n, size_t a, size_t b);
+  static void fix_underflow(Inner* in);
+  static void merge_or_rebalance(Inner* in, int l);
+  static void remove_kid(Inner* in, int i);
+
+public:
+  /*keeps the (inner, child) path of its row: next/prev are amortized O(1)*/
+  class LineCursor {
+  public:
+    LineCursor(const Node* root, int r) : root_(root) { seek(r); }
+    bool valid() const { return leaf_ != nullptr; }
+    int row() const { return row_; }
+    void seek(int r);
+    void next();
+    void prev();
+    std::string_view view(std::string&) const { return leaf_->lines[idx_]; }
+    size_t length() const { return leaf_->lines[idx_].size(); }
+    std::string slice(size_t col, size_t len) const {
+      const std::string& l = leaf_->lines[idx_];
+      return col < l.size() ? l.substr(col, len) : std::string();
+    }
+
+  private:
+    void descend(const Node* n, bool leftmost);
+    const Node* root_;
+    std::vector<std::pair<const Inner*, int>> path_;
+    const Leaf* leaf_ = nullptr;
+    size_t idx_ = 0;
+    int row_ = 0;
+  };
+  LineCursor line_cursor(int r) const { return LineCursor(root_.get(), r); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
+};
+
+static_assert(TextBufferCoreCRTPConcept<BTreeTextBufferCore>, "BTree backend must satisfy CRTP concept");
@@ -0,0 +1,548 @@
+#include "byte_rope_text_buffer_core.hpp"
+#include "newline_scan.hpp"
+#include <algorithm>
+#include <cstring>
+
+void ByteRopeTextBufferCore::recalc(Node* n) {
+  if (!n) return;
+  if (is_leaf(n)) {
+    n->bytes = n->chunk.size();
+    n->newlines = ::count_newlines(n->chunk.data(), n->chunk.size()).newlines;
+    n->height = 1;
+    return;
+  }
+  n->bytes = count_bytes(n->left.get()) + count_bytes(n->right.get());
+  n->newlines = count_newlines(n->left.get()) + count_newlines(n->right.get());
+  n->height = 1 + std::max(node_height(n->left.get()), node_height(n->right.get()));
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::rotate_left(std::unique_ptr<Node> x) {
+  auto y = std::move(x->right);
+  x->right = std::move(y->left);
+  recalc(x.get());
+  y->left = std::move(x);
+  recalc(y.get());
+  return y;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::rotate_right(std::unique_ptr<Node> y) {
+  auto x = std::move(y->left);
+  y->left = std::move(x->right);
+  recalc(y.get());
+  x->right = std::move(y);
+  recalc(x.get());
+  return x;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::balance(std::unique_ptr<Node> n) {
+  if (!n) return n;
+  recalc(n.get());
+  int bf = balance_factor(n.get());
+  if (bf > 1) {
+    if (balance_factor(n->left.get()) < 0) n->left = rotate_left(std::move(n->left));
+    return rotate_right(std::move(n));
+  } else if (bf < -1) {
+    if (balance_factor(n->right.get()) > 0) n->right = rotate_right(std::move(n->right));
+    return rotate_left(std::move(n));
+  }
+  return n;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::make_leaf(std::string&& chunk) {
+  auto n = std::make_unique<Node>();
+  n->chunk = std::move(chunk);
+  recalc(n.get());
+  return n;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::make_internal(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+  auto p = std::make_unique<Node>();
+  p->left = std::move(a);
+  p->right = std::move(b);
+  recalc(p.get());
+  return p;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::join(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+  if (!a) return b;
+  if (!b) return a;
+  int ha = node_height(a.get());
+  int hb = node_height(b.get());
+  if (ha > hb + 1) {
+    a->right = join(std::move(a->right), std::move(b));
+    return balance(std::move(a));
+  }
+  if (hb > ha + 1) {
+    b->left = join(std::move(a), std::move(b->left));
+    return balance(std::move(b));
+  }
+  return make_internal(std::move(a), std::move(b));
+}
+
+void ByteRopeTextBufferCore::fix_left_spine(Node* n) {
+  if (!n || is_leaf(n)) { recalc(n); return; }
+  fix_left_spine(n->left.get());
+  recalc(n);
+}
+
+void ByteRopeTextBufferCore::fix_right_spine(Node* n) {
+  if (!n || is_leaf(n)) { recalc(n); return; }
+  fix_right_spine(n->right.get());
+  recalc(n);
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node>
+ByteRopeTextBufferCore::pop_leftmost(std::unique_ptr<Node> n, std::string& out) {
+  if (is_leaf(n.get())) { out = std::move(n->chunk); return nullptr; }
+  n->left = pop_leftmost(std::move(n->left), out);
+  if (!n->left) return std::move(n->right);
+  return balance(std::move(n));
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::concat(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+  if (!a) return b;
+  if (!b) return a;
+  Node* la = a.get(); while (!is_leaf(la)) la = la->right.get();
+  Node* lb = b.get(); while (!is_leaf(lb)) lb = lb->left.get();
+  size_t sa = la->chunk.size();
+  size_t sb = lb->chunk.size();
+  if (sa >= CHUNK_MIN && sb >= CHUNK_MIN) return join(std::move(a), std::move(b));
+  if (sa + sb <= CHUNK_MAX) {
+    std::string moved;
+    b = pop_leftmost(std::move(b), moved);
+    la->chunk += moved;
+    fix_right_spine(a.get());
+    return join(std::move(a), std::move(b));
+  }
+  size_t keep = (sa + sb) / 2;
+  if (sa > keep) {
+    lb->chunk.insert(0, la->chunk, keep, std::string::npos);
+    la->chunk.resize(keep);
+  } else {
+    size_t take = keep - sa;
+    la->chunk.append(lb->chunk, 0, take);
+    lb->chunk.erase(0, take);
+  }
+  fix_right_spine(a.get());
+  fix_left_spine(b.get());
+  return join(std::move(a), std::move(b));
+}
+
+std::pair<std::unique_ptr<ByteRopeTextBufferCore::Node>, std::unique_ptr<ByteRopeTextBufferCore::Node>>
+ByteRopeTextBufferCore::split(std::unique_ptr<Node> n, size_t k) {
+  if (!n) return {nullptr, nullptr};
+  if (k == 0) return {nullptr, std::move(n)};
+  if (k >= n->bytes) return {std::move(n), nullptr};
+  if (is_leaf(n.get())) {
+    std::string right = n->chunk.substr(k);
+    n->chunk.resize(k);
+    recalc(n.get());
+    return {std::move(n), make_leaf(std::move(right))};
+  }
+  size_t left_bytes = count_bytes(n->left.get());
+  if (k < left_bytes) {
+    auto [a, b] = split(std::move(n->left), k);
+    return {std::move(a), join(std::move(b), std::move(n->right))};
+  }
+  if (k == left_bytes) return {std::move(n->left), std::move(n->right)};
+  auto [a, b] = split(std::move(n->right), k - left_bytes);
+  return {join(std::move(n->left), std::move(a)), std::move(b)};
+}
+
+// small inserts land in one chunk; an overflowing chunk is halved
+std::unique_ptr<ByteRopeTextBufferCore::Node>
+ByteRopeTextBufferCore::insert_at(std::unique_ptr<Node> n, size_t pos, std::string_view data) {
+  if (is_leaf(n.get())) {
+    n->chunk.insert(pos, data);
+    if (n->chunk.size() <= CHUNK_MAX) { recalc(n.get()); return n; }
+    std::string right = n->chunk.substr(n->chunk.size() / 2);
+    n->chunk.resize(n->chunk.size() / 2);
+    recalc(n.get());
+    return make_internal(std::move(n), make_leaf(std::move(right)));
+  }
+  size_t lb = count_bytes(n->left.get());
+  if (pos < lb) n->left = insert_at(std::move(n->left), pos, data);
+  else n->right = insert_at(std::move(n->right), pos - lb, data);
+  return balance(std::move(n));
+}
+
+std::vector<std::string> ByteRopeTextBufferCore::cut_chunks(std::string_view data) {
+  size_t n = data.size();
+  size_t g = (n + CHUNK_MAX - 1) / CHUNK_MAX;
+  std::vector<std::string> chunks;
+  chunks.reserve(g);
+  for (size_t i = 0; i < g; ++i) {
+    size_t b = i * n / g, e = (i + 1) * n / g;
+    chunks.emplace_back(data.substr(b, e - b));
+  }
+  return chunks;
+}
+
+std::unique_ptr<ByteRopeTextBufferCore::Node> ByteRopeTextBufferCore::build(std::vector<std::string>& chunks, size_t l, size_t r) {
+  if (l >= r) return nullptr;
+  if (r - l == 1) return make_leaf(std::move(chunks[l]));
+  size_t mid = l + (r - l) / 2;
+  auto left = build(chunks, l, mid);
+  auto right = build(chunks, mid, r);
+  return join(std::move(left), std::move(right));
+}
+
+void ByteRopeTextBufferCore::read_at(const Node* n, size_t pos, size_t len, std::string& out) {
+  if (!n || len == 0) return;
+  if (is_leaf(n)) { out.append(n->chunk, pos, len); return; }
+  size_t lb = count_bytes(n->left.get());
+  if (pos < lb) {
+    size_t take = std::min(len, lb - pos);
+    read_at(n->left.get(), pos, take, out);
+    read_at(n->right.get(), 0, len - take, out);
+  } else {
+    read_at(n->right.get(), pos - lb, len, out);
+  }
+}
+
+size_t ByteRopeTextBufferCore::newline_pos(size_t k) const {
+  const Node* cur = root_.get();
+  size_t base = 0;
+  while (!is_leaf(cur)) {
+    size_t ln = count_newlines(cur->left.get());
+    if (k <= ln) { cur = cur->left.get(); continue; }
+    k -= ln;
+    base += count_bytes(cur->left.get());
+    cur = cur->right.get();
+  }
+  const char* data = cur->chunk.data();
+  const char* end = data + cur->chunk.size();
+  const char* p = data;
+  for (;;) {
+    const char* q = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    if (--k == 0) return base + static_cast<size_t>(q - data);
+    p = q + 1;
+  }
+}
+
+size_t ByteRopeTextBufferCore::line_start(size_t row) const {
+  return row == 0 ? 0 : newline_pos(row) + 1;
+}
+
+size_t ByteRopeTextBufferCore::newlines_before(size_t pos) const {
+  const Node* cur = root_.get();
+  size_t k = 0;
+  while (!is_leaf(cur)) {
+    size_t lb = count_bytes(cur->left.get());
+    if (pos < lb) { cur = cur->left.get(); continue; }
+    pos -= lb;
+    k += count_newlines(cur->left.get());
+    cur = cur->right.get();
+  }
+  return k + ::count_newlines(cur->chunk.data(), pos).newlines;
+}
+
+std::pair<int, size_t> ByteRopeTextBufferCore::byte_to_row(size_t off) const {
+  if (!root_) return {0, 0};
+  off = std::min(off, byte_count());
+  size_t row = newlines_before(off);
+  return {static_cast<int>(row), off - line_start(row)};
+}
+
+void ByteRopeTextBufferCore::insert_bytes(size_t pos, std::string_view data) {
+  if (data.empty()) return;
+  if (root_ && data.size() <= CHUNK_MAX) { root_ = insert_at(std::move(root_), pos, data); return; }
+  auto chunks = cut_chunks(data);
+  auto M = build(chunks, 0, chunks.size());
+  auto [A, B] = split(std::move(root_), pos);
+  root_ = concat(concat(std::move(A), std::move(M)), std::move(B));
+}
+
+void ByteRopeTextBufferCore::erase_bytes(size_t pos, size_t len) {
+  if (len == 0) return;
+  auto [A, B] = split(std::move(root_), pos);
+  auto [M, C] = split(std::move(B), len);
+  root_ = concat(std::move(A), std::move(C));
+}
+
+template <typename Lines>
+void ByteRopeTextBufferCore::init_from(const Lines& lines, size_t n) {
+  // stream the lines straight into full chunks, no intermediate joined copy
+  std::vector<std::string> chunks;
+  std::string cur;
+  cur.reserve(CHUNK_MAX);
+  auto put = [&](std::string_view piece) {
+    while (!piece.empty()) {
+      size_t take = std::min(piece.size(), CHUNK_MAX - cur.size());
+      cur.append(piece.substr(0, take));
+      piece.remove_prefix(take);
+      if (cur.size() == CHUNK_MAX) {
+        chunks.push_back(std::move(cur));
+        cur = std::string();
+        cur.reserve(CHUNK_MAX);
+      }
+    }
+  };
+  for (size_t i = 0; i < n; ++i) { put(lines[i]); put("\n"); }
+  if (!cur.empty()) chunks.push_back(std::move(cur));
+  root_ = build(chunks, 0, chunks.size());
+}
+
+void ByteRopeTextBufferCore::init_from_lines(const std::vector<std::string>& lines) { init_from(lines, lines.size()); }
+
+void ByteRopeTextBufferCore::init_from_arena(const LineArena& arena) { init_from(arena, arena.size()); }
+
+std::string ByteRopeTextBufferCore::get_line(int r) const {
+  if (r < 0 || r >= line_count()) return std::string();
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  std::string out;
+  out.reserve(end - start);
+  read_at(root_.get(), start, end - start, out);
+  return out;
+}
+
+std::string_view ByteRopeTextBufferCore::get_line_view(int r, std::string& scratch) const {
+  if (r < 0 || r >= line_count()) return {};
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  // a line that sits inside one chunk is returned in place
+  const Node* cur = root_.get();
+  size_t base = 0;
+  while (!is_leaf(cur)) {
+    size_t lb = count_bytes(cur->left.get());
+    if (start < base + lb) cur = cur->left.get();
+    else { base += lb; cur = cur->right.get(); }
+  }
+  if (end <= base + cur->chunk.size()) return std::string_view(cur->chunk).substr(start - base, end - start);
+  scratch.clear();
+  scratch.reserve(end - start);
+  read_at(root_.get(), start, end - start, scratch);
+  return scratch;
+}
+
+size_t ByteRopeTextBufferCore::line_length(int r) const {
+  if (r < 0 || r >= line_count()) return 0;
+  return newline_pos(static_cast<size_t>(r) + 1) - line_start(static_cast<size_t>(r));
+}
+
+std::string ByteRopeTextBufferCore::line_slice(int r, size_t col, size_t len) const {
+  if (r < 0 || r >= line_count()) return std::string();
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  if (col >= end - start) return std::string();
+  len = std::min(len, end - start - col);
+  std::string out;
+  out.reserve(len);
+  read_at(root_.get(), start + col, len, out);
+  return out;
+}
+
+void ByteRopeTextBufferCore::insert_line(size_t row, const std::string& s) { insert_line(row, std::string_view(s)); }
+
+void ByteRopeTextBufferCore::insert_line(size_t row, std::string_view s) {
+  size_t L = static_cast<size_t>(line_count()); if (row > L) row = L;
+  std::string data;
+  data.reserve(s.size() + 1);
+  data.append(s);
+  data.push_back('\n');
+  insert_bytes(line_start(row), data);
+}
+
+void ByteRopeTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
+  insert_lines(row, std::span<const std::string>(ss.begin(), ss.end()));
+}
+
+void ByteRopeTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  if (ss.empty()) return;
+  size_t L = static_cast<size_t>(line_count()); if (row > L) row = L;
+  size_t total = 0;
+  for (const auto& s : ss) total += s.size() + 1;
+  std::string data;
+  data.reserve(total);
+  for (const auto& s : ss) { data += s; data.push_back('\n'); }
+  insert_bytes(line_start(row), data);
+}
+
+void ByteRopeTextBufferCore::erase_line(size_t row) { erase_lines(row, row + 1); }
+
+void ByteRopeTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
+  size_t L = static_cast<size_t>(line_count());
+  if (end_row < start_row) end_row = start_row;
+  if (start_row >= L) return;
+  if (end_row > L) end_row = L;
+  size_t a = line_start(start_row);
+  erase_bytes(a, line_start(end_row) - a);
+}
+
+void ByteRopeTextBufferCore::replace_line(size_t row, const std::string& s) { replace_line(row, std::string_view(s)); }
+
+void ByteRopeTextBufferCore::replace_line(size_t row, std::string_view s) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t end = newline_pos(row + 1);
+  erase_bytes(start, end - start);
+  insert_bytes(start, s);
+}
+
+void ByteRopeTextBufferCore::replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+  size_t L = static_cast<size_t>(line_count());
+  start_row = std::min(start_row, L);
+  end_row = std::clamp(end_row, start_row, L);
+  size_t total = 0;
+  for (const auto& s : ss) total += s.size() + 1;
+  std::string data;
+  data.reserve(total);
+  for (const auto& s : ss) { data += s; data.push_back('\n'); }
+  size_t a = line_start(start_row);
+  erase_bytes(a, line_start(end_row) - a);
+  insert_bytes(a, data);
+}
+
+void ByteRopeTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t len = newline_pos(row + 1) - start;
+  insert_bytes(start + std::min(col, len), s);
+}
+
+void ByteRopeTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t line_len = newline_pos(row + 1) - start;
+  if (col >= line_len) return;
+  erase_bytes(start + col, std::min(len, line_len - col));
+}
+
+void ByteRopeTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= static_cast<size_t>(line_count())) return;
+  erase_bytes(newline_pos(row + 1), 1);
+}
+
+void ByteRopeTextBufferCore::LineCursor::locate(size_t pos) {
+  path_.clear();
+  const Node* n = core_->root_.get();
+  base_ = 0;
+  while (!is_leaf(n)) {
+    path_.push_back(n);
+    size_t lb = count_bytes(n->left.get());
+    if (pos < base_ + lb) n = n->left.get();
+    else { base_ += lb; n = n->right.get(); }
+  }
+  leaf_ = n;
+}
+
+void ByteRopeTextBufferCore::LineCursor::next_leaf() {
+  const Node* child = leaf_;
+  size_t nb = base_ + leaf_->chunk.size();
+  while (!path_.empty()) {
+    const Node* p = path_.back();
+    if (p->left.get() == child) {
+      const Node* n = p->right.get();
+      while (!is_leaf(n)) { path_.push_back(n); n = n->left.get(); }
+      leaf_ = n;
+      base_ = nb;
+      return;
+    }
+    child = p;
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void ByteRopeTextBufferCore::LineCursor::prev_leaf() {
+  const Node* child = leaf_;
+  while (!path_.empty()) {
+    const Node* p = path_.back();
+    if (p->right.get() == child) {
+      const Node* n = p->left.get();
+      while (!is_leaf(n)) { path_.push_back(n); n = n->right.get(); }
+      leaf_ = n;
+      base_ -= n->chunk.size();
+      return;
+    }
+    child = p;
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void ByteRopeTextBufferCore::LineCursor::seek(int r) {
+  path_.clear();
+  leaf_ = nullptr;
+  row_ = r;
+  if (r < 0 || r >= core_->line_count()) return;
+  start_ = core_->line_start(static_cast<size_t>(r));
+  end_ = core_->newline_pos(static_cast<size_t>(r) + 1);
+  locate(end_);
+}
+
+void ByteRopeTextBufferCore::LineCursor::next() {
+  if (!leaf_) { seek(row_ + 1); return; }
+  if (++row_ >= core_->line_count()) { leaf_ = nullptr; path_.clear(); return; }
+  start_ = end_ + 1;
+  size_t pos = start_;
+  for (;;) {
+    // the text ends with '\n', so a next chunk exists while pos is inside it
+    while (pos >= base_ + leaf_->chunk.size()) next_leaf();
+    const char* d = leaf_->chunk.data();
+    size_t off = pos - base_;
+    const void* q = std::memchr(d + off, '\n', leaf_->chunk.size() - off);
+    if (q) { end_ = base_ + static_cast<size_t>(static_cast<const char*>(q) - d); return; }
+    pos = base_ + leaf_->chunk.size();
+  }
+}
+
+void ByteRopeTextBufferCore::LineCursor::prev() {
+  if (!leaf_) { seek(row_ - 1); return; }
+  if (--row_ < 0) { leaf_ = nullptr; path_.clear(); return; }
+  end_ = start_ - 1;
+  while (end_ < base_) prev_leaf();
+  const char* d = leaf_->chunk.data();
+  for (size_t i = end_ - base_; i-- > 0;) {
+    if (d[i] == '\n') { start_ = base_ + i + 1; return; }
+  }
+  // the row starts in an earlier chunk (or at 0)
+  start_ = base_ == 0 ? 0 : core_->line_start(static_cast<size_t>(row_));
+}
+
+std::string_view ByteRopeTextBufferCore::LineCursor::view(std::string& scratch) const {
+  if (start_ >= base_) return std::string_view(leaf_->chunk).substr(start_ - base_, end_ - start_);
+  scratch.clear();
+  scratch.reserve(end_ - start_);
+  read_at(core_->root_.get(), start_, end_ - start_, scratch);
+  return scratch;
+}
+
+std::string ByteRopeTextBufferCore::LineCursor::slice(size_t col, size_t len) const {
+  if (col >= length()) return std::string();
+  len = std::min(len, length() - col);
+  std::string out;
+  out.reserve(len);
+  read_at(core_->root_.get(), start_ + col, len, out);
+  return out;
+}
+
+bool ByteRopeTextBufferCore::check_invariants(std::string* why) const {
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  bool ok = true;
+  auto walk = [&](auto&& self, const Node* n) -> void {
+    if (!ok) return;
+    if (is_leaf(n)) {
+      if (n->chunk.empty() || n->chunk.size() > CHUNK_MAX) ok = fail("chunk size out of bounds");
+      else if (n->bytes != n->chunk.size() || n->height != 1 ||
+               n->newlines != static_cast<size_t>(std::count(n->chunk.begin(), n->chunk.end(), '\n'))) ok = fail("bad leaf aggregates");
+      return;
+    }
+    if (!n->left || !n->right) { ok = fail("internal node with one child"); return; }
+    if (!n->chunk.empty()) { ok = fail("internal node holds bytes"); return; }
+    self(self, n->left.get());
+    self(self, n->right.get());
+    if (!ok) return;
+    if (n->bytes != n->left->bytes + n->right->bytes || n->newlines != n->left->newlines + n->right->newlines) ok = fail("bad aggregates");
+    else if (n->height != 1 + std::max(n->left->height, n->right->height)) ok = fail("bad height");
+    else if (std::abs(balance_factor(n)) > 1) ok = fail("AVL balance violated");
+  };
+  if (!root_) return true;
+  walk(walk, root_.get());
+  if (!ok) return false;
+  const Node* last = root_.get();
+  while (!is_leaf(last)) last = last->right.get();
+  if (last->chunk.back() != '\n') return fail("text does not end with a newline");
+  return true;
+}
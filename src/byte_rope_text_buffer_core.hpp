@@ -0,0 +1,165 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <span>
+#include "i_text_buffer_core.hpp"
+
+/*
+  byte rope backend: AVL tree over fixed-size byte chunks of the text, every
+  line stored with its trailing '\n'. nodes aggregate bytes and newlines, so
+  a row is located by newline count and a huge single line is just a run of
+  chunks: reading a window of it or editing inside it costs O(log n + size)
+  instead of copying the whole line.
+*/
+class ByteRopeTextBufferCore : public TextBufferCoreCRTP<ByteRopeTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "byterope"; }
+  static constexpr size_t CHUNK_MAX = 4096;
+  static constexpr size_t CHUNK_MIN = CHUNK_MAX / 4;
+
+  void init_from_lines(const std::vector<std::string>& lines);
+  void init_from_arena(const LineArena& arena);
+  int line_count() const { return static_cast<int>(count_newlines(root_.get())); }
+  std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
+  size_t line_length(int r) const;
+  std::string line_slice(int r, size_t col, size_t len) const;
+
+  void insert_line(size_t row, const std::string& s);
+  void insert_line(size_t row, std::string_view s);
+  void insert_lines(size_t row, const std::vector<std::string>& ss);
+  void insert_lines(size_t row, std::span<const std::string> ss);
+  void erase_line(size_t row);
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
+  void replace_line(size_t row, const std::string& s);
+  void replace_line(size_t row, std::string_view s);
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss);
+
+  /*edits inside one line, O(log n + edit size) however long the line is*/
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col) { insert_text(row, col, "\n"); }
+  void join_lines(size_t row);
+  size_t byte_size() const { return count_bytes(root_.get()); }
+  /*saved-text offsets: the stored text is the saved one plus a final '\n'*/
+  size_t byte_count() const { return byte_size() == 0 ? 0 : byte_size() - 1; }
+  size_t row_to_byte(int r) const { return line_start(static_cast<size_t>(r)); }
+  std::pair<int, size_t> byte_to_row(size_t off) const;
+
+  /*debug: verify AVL balance, aggregates and chunk sizes*/
+  bool check_invariants(std::string* why = nullptr) const;
+  int height() const { return node_height(root_.get()); }
+
+  /*forward to CRTP impl*/
+  void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_init_from_arena(const LineArena& arena) { init_from_arena(arena); }
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  size_t do_line_length(int r) const { return line_length(r); }
+  std::string do_line_slice(int r, size_t col, size_t len) const { return line_slice(r, col, len); }
+  void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
+  void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
+  void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
+  void do_erase_line(size_t row) { erase_line(row); }
+  void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
+  void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
+  void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+  size_t do_byte_count() const { return byte_count(); }
+  size_t do_row_to_byte(int r) const { return row_to_byte(r); }
+  std::pair<int, size_t> do_byte_to_row(size_t off) const { return byte_to_row(off); }
+
+private:
+  /*
+    leaves: no children, 1..CHUNK_MAX bytes, height 1.
+    internal nodes: always two children, no bytes.
+  */
+  struct Node {
+    std::unique_ptr<Node> left;
+    std::unique_ptr<Node> right;
+    std::string chunk;   /* non-empty only for leaves */
+    size_t bytes = 0;    /* aggregated byte count */
+    size_t newlines = 0; /* aggregated '\n' count */
+    int height = 1;      /* AVL height */
+  };
+  std::unique_ptr<Node> root_;
+
+  static bool is_leaf(const Node* n) { return !n->left && !n->right; }
+  static size_t count_bytes(const Node* n) { return n ? n->bytes : 0; }
+  static size_t count_newlines(const Node* n) { return n ? n->newlines : 0; }
+  static int node_height(const Node* n) { return n ? n->height : 0; }
+  static int balance_factor(const Node* n) { return n ? (node_height(n->left.get()) - node_height(n->right.get())) : 0; }
+  static void recalc(Node* n);
+  static std::unique_ptr<Node> rotate_left(std::unique_ptr<Node> x);
+  static std::unique_ptr<Node> rotate_right(std::unique_ptr<Node> y);
+  static std::unique_ptr<Node> balance(std::unique_ptr<Node> n);
+
+  static std::unique_ptr<Node> make_leaf(std::string&& chunk);
+  static std::unique_ptr<Node> make_internal(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
+  static std::unique_ptr<Node> join(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
+  /*join that also merges/rebalances the two chunks meeting at the seam*/
+  static std::unique_ptr<Node> concat(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
+  static std::pair<std::unique_ptr<Node>, std::unique_ptr<Node>> split(std::unique_ptr<Node> n, size_t k);
+  static std::unique_ptr<Node> pop_leftmost(std::unique_ptr<Node> n, std::string& out);
+  static void fix_left_spine(Node* n);
+  static void fix_right_spine(Node* n);
+  static std::unique_ptr<Node> insert_at(std::unique_ptr<Node> n, size_t pos, std::string_view data);
+  static std::unique_ptr<Node> build(std::vector<std::string>& chunks, size_t l, size_t r);
+  static std::vector<std::string> cut_chunks(std::string_view data);
+  static void read_at(const Node* n, size_t pos, size_t len, std::string& out);
+
+  /*byte offset of the k-th '\n' (1-based), k <= line_count()*/
+  size_t newline_pos(size_t k) const;
+  /*first byte of row; row == line_count() gives byte_size()*/
+  size_t line_start(size_t row) const;
+  /*number of '\n' in bytes [0, pos)*/
+  size_t newlines_before(size_t pos) const;
+  void insert_bytes(size_t pos, std::string_view data);
+  void erase_bytes(size_t pos, size_t len);
+  /*the first n lines of lines, each ended by a '\n'; lines[i] is a string or a view*/
+  template <typename Lines>
+  void init_from(const Lines& lines, size_t n);
+
+public:
+  /*
+    tracks the byte range of its row and the chunk holding the row's '\n';
+    next() scans on from there, so a forward pass is O(bytes) overall.
+    prev() falls back to a descent only when a line spans chunks.
+  */
+  class LineCursor {
+  public:
+    LineCursor(const ByteRopeTextBufferCore& core, int r) : core_(&core) { seek(r); }
+    bool valid() const { return leaf_ != nullptr; }
+    int row() const { return row_; }
+    void seek(int r);
+    void next();
+    void prev();
+    std::string_view view(std::string& scratch) const;
+    size_t length() const { return end_ - start_; }
+    std::string slice(size_t col, size_t len) const;
+
+  private:
+    void locate(size_t pos);
+    void next_leaf();
+    void prev_leaf();
+    const ByteRopeTextBufferCore* core_;
+    std::vector<const Node*> path_; /* internal nodes above leaf_ */
+    const Node* leaf_ = nullptr;
+    size_t base_ = 0;  /* byte offset of leaf_ */
+    size_t start_ = 0; /* first byte of the row */
+    size_t end_ = 0;   /* the row's '\n' */
+    int row_ = 0;
+  };
+  LineCursor line_cursor(int r) const { return LineCursor(*this, r); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
+};
+
+static_assert(TextBufferCoreCRTPConcept<ByteRopeTextBufferCore>, "ByteRope backend must satisfy CRTP concept");
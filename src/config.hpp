@@ -2,20 +2,73 @@
 
 /*here you can choose the text buffer backend*/
 
+#define TB_BACKEND_AUTO   0 /*every backend below in one binary, picked per document and switchable with :backend*/
 #define TB_BACKEND_VECTOR 1
 #define TB_BACKEND_GAP    2
 #define TB_BACKEND_ROPE   3
+#define TB_BACKEND_PROPE  4 /*persistent rope, O(1) snapshots*/
+#define TB_BACKEND_BTREE  5 /*b+tree rope, wide cache-friendly nodes*/
+#define TB_BACKEND_BYTEROPE 6 /*rope of byte chunks, for huge single lines*/
+#define TB_BACKEND_PIECE  7 /*piece table over the mapped file, no copy on open*/
+#define TB_BACKEND_TIERED 8 /*tiered vector, O(1) reads and O(sqrt n) middle edits*/
 
 #ifndef TB_BACKEND
-#define TB_BACKEND TB_BACKEND_ROPE
+#define TB_BACKEND TB_BACKEND_AUTO
 #endif
 
-#if TB_BACKEND == TB_BACKEND_VECTOR
+/*auto: files at or above either limit open on the rope, smaller ones on the vector*/
+#ifndef TB_AUTO_ROPE_BYTES
+#define TB_AUTO_ROPE_BYTES (1024 * 1024)
+#endif
+#ifndef TB_AUTO_ROPE_LINES
+#define TB_AUTO_ROPE_LINES 20000
+#endif
+/*auto: files with a line at or above this many bytes open on the byterope*/
+#ifndef TB_AUTO_BYTEROPE_LINE_BYTES
+#define TB_AUTO_BYTEROPE_LINE_BYTES (1024 * 1024)
+#endif
+/*auto: files at or above this size stay mapped and open on the piece table*/
+#ifndef TB_AUTO_PIECE_BYTES
+#define TB_AUTO_PIECE_BYTES (64 * 1024 * 1024)
+#endif
+/*files at or above this size that get mapped keep a sidecar newline index, see NewlineIndex*/
+#ifndef TB_NEWLINE_CACHE_BYTES
+#define TB_NEWLINE_CACHE_BYTES (64 * 1024 * 1024)
+#endif
+/*view mode: keep the start of every this many lines; memory is 8 bytes per checkpoint*/
+#ifndef TB_VIEW_CHECKPOINT_LINES
+#define TB_VIEW_CHECKPOINT_LINES 4096
+#endif
+/*the editor opens files at or above this size progressively: first screens now, the rest in the background*/
+#ifndef TB_PROGRESSIVE_BYTES
+#define TB_PROGRESSIVE_BYTES (16 * 1024 * 1024)
+#endif
+/*bytes loaded before a progressive open returns, and per background batch after it*/
+#ifndef TB_PROGRESSIVE_FIRST_BYTES
+#define TB_PROGRESSIVE_FIRST_BYTES (256 * 1024)
+#endif
+#ifndef TB_PROGRESSIVE_BATCH_BYTES
+#define TB_PROGRESSIVE_BATCH_BYTES (4 * 1024 * 1024)
+#endif
+
+#if TB_BACKEND == TB_BACKEND_AUTO
+#define TB_BACKEND_NAME "auto"
+#elif TB_BACKEND == TB_BACKEND_VECTOR
 #define TB_BACKEND_NAME "vector"
 #elif TB_BACKEND == TB_BACKEND_GAP
 #define TB_BACKEND_NAME "gap"
 #elif TB_BACKEND == TB_BACKEND_ROPE
 #define TB_BACKEND_NAME "rope"
+#elif TB_BACKEND == TB_BACKEND_PROPE
+#define TB_BACKEND_NAME "prope"
+#elif TB_BACKEND == TB_BACKEND_BTREE
+#define TB_BACKEND_NAME "btree"
+#elif TB_BACKEND == TB_BACKEND_BYTEROPE
+#define TB_BACKEND_NAME "byterope"
+#elif TB_BACKEND == TB_BACKEND_PIECE
+#define TB_BACKEND_NAME "piece"
+#elif TB_BACKEND == TB_BACKEND_TIERED
+#define TB_BACKEND_NAME "tiered"
 #else
 #define TB_BACKEND_NAME "unknown"
 #endif
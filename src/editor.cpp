@@ -2,9 +2,11 @@
 #include "editor.hpp"
 #include <sstream>
 #include <algorithm>
+#include <chrono>
 #include <cctype>
 #include <functional>
 #include <limits>
+#include <string_view>
 #include "file_reader.hpp"
 #include "undo_manager.hpp"
 #include "pane_layout.hpp"
@@ -14,6 +16,8 @@ static constexpr int CTRL_R = 'R'-64;
 static constexpr int CTRL_d = 'D'-64; 
 static constexpr int CTRL_w = 'W'-64;
 static constexpr int ESC = 27;
+/*rows searched for highlights either side of the cursor in a view*/
+static constexpr int VIEW_HITS_ROWS = 1000;
 static inline bool is_space(unsigned char c) {
   return std::isspace(c) != 0;
 }
@@ -26,7 +30,7 @@ static inline bool is_word(unsigned char c) {
 static inline bool is_symbol(unsigned char c) {
   return !is_space(c) && !is_word(c);
 }
-static int next_word_start_same_line(const std::string& line, int col) {
+static int next_word_start_same_line(std::string_view line, int col) {
   int len = static_cast<int>(line.size());
   if (col < 0) col = 0;
   if (col > len) col = len;
@@ -43,7 +47,7 @@ static int next_word_start_same_line(const std::string& line, int col) {
   while (col + 1 < len && is_symbol(static_cast<unsigned char>(line[col + 1]))) col++;
   return std::min(len, col + 1);
 }
-static int next_word_end_same_line(const std::string& line, int col) {
+static int next_word_end_same_line(std::string_view line, int col) {
   int len = static_cast<int>(line.size());
   if (col < 0) col = 0;
   if (col > len) col = len;
@@ -75,7 +79,6 @@ const Editor::Document& Editor::doc() const { return *pane().doc; }
 void Editor::set_active_pane(int idx) {
   if (idx < 0 || idx >= (int)panes.size()) return;
   if (idx == active_pane) return;
-  commit_insert_buffer();
   active_pane = idx;
   input.reset();
   pending_op = PendingOp::None;
@@ -101,10 +104,8 @@ int Editor::create_pane_from_file(const std::optional<std::filesystem::path>& fi
     }
     if (!p.doc) {
       auto d = std::make_shared<Document>();
-      bool ok = true; std::string m;
-      d->buf = TextBuffer::from_file(*file, m, ok);
       d->file_path = *file;
-      message = m;
+      message = load_document(*d, *file);
       d->modified = false;
       doc_table[key] = d;
       p.doc = d;
@@ -232,10 +233,9 @@ void Editor::open_path_in_pane(int idx, const std::filesystem::path& path) {
   if (auto it = doc_table.find(key); it != doc_table.end()) {
     if (auto existing = it->second.lock()) p.doc = existing;
   }
-  if (!p.doc || (p.doc->file_path && normalize_key(*p.doc->file_path) != key)) {
+  if (!p.doc || p.doc->read_only || (p.doc->file_path && normalize_key(*p.doc->file_path) != key)) {
     auto d = std::make_shared<Document>();
-    bool ok = true; std::string m;
-    d->buf = TextBuffer::from_file(path, m, ok);
+    std::string m = load_document(*d, path);
     d->modified = false;
     d->file_path = path;
     d->last_change.reset();
@@ -246,9 +246,79 @@ void Editor::open_path_in_pane(int idx, const std::filesystem::path& path) {
   }
 }
 
+std::string Editor::load_document(Document& d, const std::filesystem::path& path) {
+  std::string m;
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (!ec && size >= TB_PROGRESSIVE_BYTES) {
+    d.loading = ProgressiveLoad::start(path, d.buf, m);
+    if (d.loading) {
+      if (d.loading->done()) d.loading.reset();
+      return m;
+    }
+  }
+  bool ok = true;
+  d.buf = TextBuffer::from_file(path, m, ok);
+  return m;
+}
 
-Editor::Editor(const std::optional<std::filesystem::path>& file) {
-  active_pane = create_pane_from_file(file);
+void Editor::open_view_in_pane(int idx, const std::filesystem::path& path) {
+  if (idx < 0 || idx >= (int)panes.size()) return;
+#if TB_BACKEND == TB_BACKEND_AUTO
+  auto d = std::make_shared<Document>();
+  std::string m;
+  ProgressiveLoad::Options opt;
+  opt.backend = MappedViewTextBufferCore::get_name_sv();
+  auto load = ProgressiveLoad::start(path, d->buf, m, opt);
+  if (!load) {
+    if (idx == active_pane) message = m;
+    return;
+  }
+  if (!load->done()) d->loading = std::move(load);
+  d->file_path = path;
+  d->read_only = true;
+  // not in doc_table: :edit or a split of the path must get an editable document, not this one
+  Pane& p = panes[idx];
+  p.doc = d;
+  p.cur = Cursor{};
+  p.vp = Viewport{};
+  if (idx == active_pane) message = m;
+#else
+  (void)path;
+  if (idx == active_pane) message = "view: needs the auto build (TB_BACKEND_AUTO)";
+#endif
+}
+
+bool Editor::pump_loads() {
+  // a document shown in several panes is pumped once; the slice is split between documents
+  std::vector<Document*> docs;
+  for (auto& p : panes) {
+    if (p.doc && p.doc->loading && std::find(docs.begin(), docs.end(), p.doc.get()) == docs.end()) docs.push_back(p.doc.get());
+  }
+  if (docs.empty()) return false;
+  auto slice = std::chrono::microseconds(8000 / static_cast<int>(docs.size()));
+  bool any = false;
+  for (Document* d : docs) {
+    if (d->loading->pump(d->buf, slice)) {
+      d->loading.reset();
+      if (d == &doc() && d->file_path) message = std::string("opened file: ") + d->file_path->string();
+    } else {
+      any = true;
+    }
+  }
+  return any;
+}
+
+void Editor::wait_loaded(int rows) {
+  Document& d = doc();
+  if (!d.loading) return;
+  d.loading->wait_rows(d.buf, rows);
+  if (d.loading->done()) d.loading.reset();
+}
+
+Editor::Editor(const std::optional<std::filesystem::path>& file, bool read_only) {
+  active_pane = create_pane_from_file(read_only ? std::nullopt : file);
+  if (read_only && file) open_view_in_pane(active_pane, *file);
   layout = std::make_unique<SplitNode>();
   layout->type = SplitNode::Type::Leaf;
   layout->pane = active_pane;
@@ -257,10 +327,24 @@ Editor::Editor(const std::optional<std::filesystem::path>& file) {
 }
 
 void Editor::run() {
+  using clock = std::chrono::steady_clock;
+  bool dirty = true, loading = false;
+  auto last_render = clock::now();
   while (!should_quit) {
-    render();
+    bool was_loading = loading;
+    loading = pump_loads();
+    // while a file streams in, redraw for its progress a few times a second and poll for keys
+    auto now = clock::now();
+    if (dirty || was_loading != loading || (loading && now - last_render >= std::chrono::milliseconds(50))) {
+      render();
+      last_render = now;
+      dirty = false;
+    }
+    timeout(loading ? 1 : -1);
     int ch = getch();
+    if (ch == ERR) continue;
     handle_input(ch);
+    dirty = true;
   }
 }
 
@@ -276,8 +360,6 @@ void Editor::commit_group() {
 void Editor::push_op(const Operation& op) { doc().um.push_op(op); }
 
 void Editor::render() {
-  int override_row = insert_buffer_active ? insert_buffer_row : -1;
-  std::string override_line = insert_buffer_active ? insert_buffer_line : std::string();
   std::vector<PaneRect> rects;
   collect_layout(rects);
   if (rects.empty() && layout) {
@@ -295,9 +377,10 @@ void Editor::render() {
     info.vp = const_cast<Viewport*>(&p.vp);
     info.file_path = p.doc->file_path;
     info.modified = p.doc->modified;
+    info.read_only = p.doc->read_only;
+    if (p.doc->loading) info.load_percent = p.doc->loading->percent();
     info.is_active = (pr.pane == active_pane);
     info.area = pr.rect;
-    if (info.is_active) { info.override_row = override_row; info.override_line = override_line; }
     infos.push_back(std::move(info));
   }
   renderer.render(term, infos, mode, message, cmdline, visual_active, visual_anchor, show_line_numbers, relative_line_numbers, enable_color, last_search_hits);
@@ -319,6 +402,17 @@ void Editor::handle_normal_input(int ch) {
       default: break;
     }
   }
+  if (doc().read_only) {
+    switch (ch) {
+      case 'x': case 'i': case 'a': case 'o': case 'O': case '.': case 'u': case CTRL_R:
+      case 'd': case 'p': case '>': case '<':
+        input.reset();
+        pending_op = PendingOp::None;
+        message = "read-only view";
+        return;
+      default: break;
+    }
+  }
   if (ch != 'd' && ch != 'y' && ch != 'g' && ch != '>' && ch != '<') input.reset();
   switch (ch) {
     case CTRL_w: pending_ctrl_w = true; break;
@@ -343,7 +437,7 @@ void Editor::handle_normal_input(int ch) {
     } break;
     case 'x': begin_group(); delete_char(); commit_group(); break;
     case 'i': begin_group(); mode = Mode::Insert; break;
-    case 'a': begin_group(); pane().cur.col = std::min((int)doc().buf.line(pane().cur.row).size(), pane().cur.col + 1); mode = Mode::Insert; break;
+    case 'a': begin_group(); pane().cur.col = std::min(doc().buf.line_length(pane().cur.row), pane().cur.col + 1); mode = Mode::Insert; break;
     case 'o': {
       std::string indent; if (auto_indent) indent = compute_indent_for_line(pane().cur.row);
       begin_group();
@@ -403,8 +497,9 @@ void Editor::handle_normal_input(int ch) {
       if (n == 0) { move_to_top(); }
       else {
         int target = static_cast<int>(std::max<size_t>(1, n)) - 1;
+        wait_loaded(target + 1);
         pane().cur.row = std::min(target, std::max(0, doc().buf.line_count() - 1));
-        pane().cur.col = std::min(pane().cur.col, (int)doc().buf.line(pane().cur.row).size());
+        pane().cur.col = std::min(pane().cur.col, doc().buf.line_length(pane().cur.row));
       }
     } break;
     case 'G': {
@@ -412,8 +507,9 @@ void Editor::handle_normal_input(int ch) {
       if (n == 0) { move_to_bottom(); }
       else {
         int target = static_cast<int>(std::max<size_t>(1, n)) - 1;
+        wait_loaded(target + 1);
         pane().cur.row = std::min(target, std::max(0, doc().buf.line_count() - 1));
-        pane().cur.col = std::min(pane().cur.col, (int)doc().buf.line(pane().cur.row).size());
+        pane().cur.col = std::min(pane().cur.col, doc().buf.line_length(pane().cur.row));
       }
     } break;
     case 'w': {
@@ -493,21 +589,19 @@ void Editor::handle_normal_input(int ch) {
 }
 
 void Editor::handle_insert_input(int ch) {
-  if (ch == ESC) { commit_insert_buffer(); commit_group(); mode = Mode::Normal; return; }
+  if (ch == ESC) { commit_group(); mode = Mode::Normal; return; }
   if (ch == KEY_BACKSPACE || ch == 127) { apply_backspace(); return; }
   if (ch == '\t') {
-    if (!insert_buffer_active || insert_buffer_row != pane().cur.row) begin_insert_buffer();
     int n = std::max(1, tab_width);
     for (int i = 0; i < n; ++i) { apply_insert_char(' '); }
     return;
   }
   if (ch == '('|| ch == '{'||ch == '[') {
     if (auto_pair) {
-      if (!insert_buffer_active || insert_buffer_row != pane().cur.row) begin_insert_buffer();
       char opening = (char)ch;
       char closing = (opening=='(')?')':(opening=='{'?'}':']');
       apply_insert_char(opening);
-      if (!(pane().cur.col < (int)insert_buffer_line.size() && insert_buffer_line[pane().cur.col] == closing)) {
+      if (doc().buf.line_slice(pane().cur.row, pane().cur.col, 1) != std::string(1, closing)) {
         apply_insert_char(closing);
         pane().cur.col = std::max(0, pane().cur.col - 1);
       }
@@ -516,16 +610,11 @@ void Editor::handle_insert_input(int ch) {
   }
   if (ch == '\n' || ch == KEY_ENTER || ch == '\r') {
     std::string indent;
-    if (auto_indent) {
-      if (insert_buffer_active && insert_buffer_row == pane().cur.row) indent = compute_indent_for_line(pane().cur.row);
-      else indent = compute_indent_for_line(pane().cur.row);
-    }
+    if (auto_indent) indent = compute_indent_for_line(pane().cur.row);
     begin_group();
-    commit_insert_buffer();
     split_line_at_cursor();
     if (auto_indent) apply_indent_to_newline(indent);
     commit_group();
-    begin_insert_buffer();
     return;
   }
   if (ch >= 32 && ch <= 126) {
@@ -534,58 +623,33 @@ void Editor::handle_insert_input(int ch) {
   }
 }
 
-void Editor::begin_insert_buffer() {
-  insert_buffer_active = true;
-  insert_buffer_row = pane().cur.row;
-  insert_buffer_line = doc().buf.line(pane().cur.row);
-}
-
 void Editor::apply_insert_char(int ch) {
-  if (!insert_buffer_active || insert_buffer_row != pane().cur.row) begin_insert_buffer();
   begin_group();
+  int len = doc().buf.line_length(pane().cur.row);
   if (pane().cur.col < 0) pane().cur.col = 0;
-  if (pane().cur.col > static_cast<int>(insert_buffer_line.size())) pane().cur.col = static_cast<int>(insert_buffer_line.size());
-  insert_buffer_line.insert(insert_buffer_line.begin() + pane().cur.col, static_cast<char>(ch));
-  push_op({Operation::InsertChar, pane().cur.row, pane().cur.col, std::string(1, (char)ch), std::string()});
+  if (pane().cur.col > len) pane().cur.col = len;
+  char c = static_cast<char>(ch);
+  push_op({Operation::InsertChar, pane().cur.row, pane().cur.col, std::string(1, c), std::string()});
   doc().modified = true;
+  // in-line edit: on the rope this stays in the hot line's gap buffer
+  doc().buf.insert_text(pane().cur.row, pane().cur.col, std::string_view(&c, 1));
   pane().cur.col++;
-  doc().buf.replace_line(insert_buffer_row, insert_buffer_line);
   doc().um.clear_redo();
   commit_group();
 }
 
 void Editor::apply_backspace() {
-  if (!insert_buffer_active || insert_buffer_row != pane().cur.row) begin_insert_buffer();
   if (pane().cur.col > 0) {
     begin_group();
-    char c = insert_buffer_line[pane().cur.col - 1];
-    insert_buffer_line.erase(insert_buffer_line.begin() + pane().cur.col - 1);
-    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col - 1, std::string(1, c), std::string()});
+    std::string c = doc().buf.line_slice(pane().cur.row, pane().cur.col - 1, 1);
+    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col - 1, c, std::string()});
     pane().cur.col--; doc().modified = true;
-    doc().buf.replace_line(insert_buffer_row, insert_buffer_line);
+    doc().buf.erase_text(pane().cur.row, pane().cur.col, 1);
     doc().um.clear_redo();
     commit_group();
   } else {
-    // At line start: commit buffer then use existing merge logic
-    commit_insert_buffer();
+    // at line start: merge with the previous line
     backspace();
-    begin_insert_buffer();
-  }
-}
-
-void Editor::commit_insert_buffer() {
-  if (insert_buffer_active) {
-    std::string old = doc().buf.line(insert_buffer_row);
-    std::string neu = insert_buffer_line;
-    // 若已在逐字符写回，则 old == neu，不再推送整行 ReplaceLine，以避免一次性撤销整行
-    if (old != neu) {
-      doc().buf.replace_line(insert_buffer_row, neu);
-      push_op({Operation::ReplaceLine, insert_buffer_row, pane().cur.col, old, neu});
-      doc().um.clear_redo();
-    }
-    insert_buffer_active = false;
-    insert_buffer_row = -1;
-    insert_buffer_line.clear();
   }
 }
 
@@ -667,7 +731,7 @@ void Editor::handle_mouse() {
   if (screen_col < indent) return; // clicking in line-number gutter does nothing
   int rel = screen_col - indent;
   int buf_col = pane().vp.left_col + rel;
-  int line_len = (buf_row >= 0 && buf_row < doc().buf.line_count()) ? (int)doc().buf.line(buf_row).size() : 0;
+  int line_len = (buf_row >= 0 && buf_row < doc().buf.line_count()) ? doc().buf.line_length(buf_row) : 0;
   int maxc = virtualedit_onemore ? line_len : (line_len > 0 ? line_len - 1 : 0);
   buf_col = std::clamp(buf_col, 0, maxc);
   if (me.bstate & (BUTTON1_CLICKED | BUTTON1_PRESSED | BUTTON1_RELEASED | BUTTON1_DOUBLE_CLICKED)) {
@@ -812,9 +876,8 @@ static std::vector<int> kmp_build(const std::string& pat) {
   return pi;
 }
 
-static int kmp_find_first_from(const std::string& s, const std::string& pat, size_t start) {
+static int kmp_find_first_from(std::string_view s, const std::string& pat, const std::vector<int>& pi, size_t start) {
   if (pat.empty()) return -1;
-  auto pi = kmp_build(pat);
   size_t j = 0;
   for (size_t i = start; i < s.size(); ++i) {
     while (j > 0 && s[i] != pat[j]) j = pi[j - 1];
@@ -824,9 +887,8 @@ static int kmp_find_first_from(const std::string& s, const std::string& pat, siz
   return -1;
 }
 
-static void kmp_find_all(const std::string& s, const std::string& pat, std::vector<int>& out) {
+static void kmp_find_all(std::string_view s, const std::string& pat, const std::vector<int>& pi, std::vector<int>& out) {
   out.clear(); if (pat.empty()) return;
-  auto pi = kmp_build(pat);
   size_t j = 0;
   for (size_t i = 0; i < s.size(); ++i) {
     while (j > 0 && s[i] != pat[j]) j = pi[j - 1];
@@ -837,34 +899,42 @@ static void kmp_find_all(const std::string& s, const std::string& pat, std::vect
 
 void Editor::search_forward(const std::string& pattern) {
   if (pattern.empty()) { message = "pattern empty"; return; }
-  int rows = doc().buf.line_count();
+  auto pi = kmp_build(pattern);
+  std::string scratch;
   {
-    const auto& line = doc().buf.line(pane().cur.row);
-    int pos = kmp_find_first_from(line, pattern, (size_t)std::min((int)line.size(), pane().cur.col + 1));
+    std::string_view line = doc().buf.line_view(pane().cur.row, scratch);
+    int pos = kmp_find_first_from(line, pattern, pi, (size_t)std::min((int)line.size(), pane().cur.col + 1));
     if (pos >= 0) { pane().cur.col = pos; return; }
   }
-  for (int r = pane().cur.row + 1; r < rows; ++r) {
-    const auto& s = doc().buf.line(r);
-    int pos = kmp_find_first_from(s, pattern, 0);
-    if (pos >= 0) { pane().cur.row = r; pane().cur.col = pos; return; }
+  // a file still loading is searched as its lines come in
+  for (int r = pane().cur.row + 1;;) {
+    int rows = doc().buf.line_count();
+    for (auto it = doc().buf.line_cursor(r); r < rows; ++r, it.next()) {
+      std::string_view s = it.view(scratch);
+      int pos = kmp_find_first_from(s, pattern, pi, 0);
+      if (pos >= 0) { pane().cur.row = r; pane().cur.col = pos; return; }
+    }
+    if (!doc().loading) break;
+    wait_loaded(rows + 1);
   }
   message = "not found pattern";
 }
 
 void Editor::search_backward(const std::string& pattern) {
   if (pattern.empty()) { message = "pattern empty"; return; }
+  auto pi = kmp_build(pattern);
+  std::string scratch;
+  std::vector<int> pos;
   {
-    const auto& line = doc().buf.line(pane().cur.row);
-    std::vector<int> pos;
-    kmp_find_all(line, pattern, pos);
+    std::string_view line = doc().buf.line_view(pane().cur.row, scratch);
+    kmp_find_all(line, pattern, pi, pos);
     int target = -1; for (int p : pos) if (p < pane().cur.col) target = p; 
     if (target >= 0) { pane().cur.col = target; return; }
   }
-  for (int r = pane().cur.row - 1; r >= 0; --r) {
-    const auto& s = doc().buf.line(r);
-    std::vector<int> pos;
-    kmp_find_all(s, pattern, pos);
-    if (!pos.empty()) { pane().cur.row = r; pane().cur.col = pos.back(); return; }
+  if (pane().cur.row > 0) for (auto it = doc().buf.line_cursor(pane().cur.row - 1); it.valid(); it.prev()) {
+    std::string_view s = it.view(scratch);
+    kmp_find_all(s, pattern, pi, pos);
+    if (!pos.empty()) { pane().cur.row = it.row(); pane().cur.col = pos.back(); return; }
   }
   message = "not found pattern";
 }
@@ -878,18 +948,29 @@ void Editor::repeat_last_search(bool is_forward) {
 void Editor::recompute_search_hits(const std::string& pattern) {
   last_search_hits.clear();
   if (pattern.empty()) return;
-  int rows = doc().buf.line_count();
-  for (int r = 0; r < rows; ++r) {
-    const auto& s = doc().buf.line(r);
-    std::vector<int> pos;
-    kmp_find_all(s, pattern, pos);
+  int first = 0, rows = 0;
+  if (doc().read_only) {
+    // a view may be bigger than memory: only hits around the cursor are collected
+    first = std::max(0, pane().cur.row - VIEW_HITS_ROWS);
+    rows = std::min(doc().buf.line_count(), pane().cur.row + VIEW_HITS_ROWS);
+  } else {
+    wait_loaded();
+    rows = doc().buf.line_count();
+  }
+  auto pi = kmp_build(pattern);
+  std::string scratch;
+  std::vector<int> pos;
+  auto it = doc().buf.line_cursor(first);
+  for (int r = first; r < rows; ++r, it.next()) {
+    std::string_view s = it.view(scratch);
+    kmp_find_all(s, pattern, pi, pos);
     for (int p : pos) last_search_hits.push_back({r, p, (int)pattern.size()});
   }
   if (!last_search_hits.empty()) {
     const SearchHit* next = nullptr;
     for (const auto& h : last_search_hits) { if (h.row > pane().cur.row || (h.row == pane().cur.row && h.col >= pane().cur.col)) { next = &h; break; } }
     if (!next) next = &last_search_hits.front();
-    message = std::string("matches:") + std::to_string((int)last_search_hits.size()) + " next " + std::to_string(next->row + 1) + ":" + std::to_string(next->col + 1);
+    message = std::string(doc().read_only ? "matches nearby:" : "matches:") + std::to_string((int)last_search_hits.size()) + " next " + std::to_string(next->row + 1) + ":" + std::to_string(next->col + 1);
   } else {
     message = "not found pattern";
   }
@@ -970,8 +1051,7 @@ void Editor::delete_selection() {
         }
         push_op({Operation::DeleteLinesBlock, r0 + 1, 0, mid, std::string()});
       }
-      doc().buf.replace_line(r0, neu_first);
-      doc().buf.erase_lines(r0 + 1, r1 + 1);
+      doc().buf.apply_edits({{static_cast<size_t>(r0), static_cast<size_t>(r1 - r0 + 1), {neu_first}}});
       pane().cur.row = r0; pane().cur.col = (int)left.size();
     }
   }
@@ -1017,12 +1097,10 @@ void Editor::move_up() { if (pane().cur.row > 0) { pane().cur.row--; pane().cur.
 void Editor::move_down() { if (pane().cur.row + 1 < doc().buf.line_count()) { pane().cur.row++; pane().cur.col = std::min(pane().cur.col, max_col_for_row(pane().cur.row)); } }
 
 void Editor::delete_char() {
-  std::string s = doc().buf.line(pane().cur.row);
-  if (pane().cur.col < (int)s.size()) {
-    char c = s[pane().cur.col];
-    s.erase(s.begin() + pane().cur.col);
-    doc().buf.replace_line(pane().cur.row, s);
-    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col, std::string(1, c), std::string()});
+  if (pane().cur.col < doc().buf.line_length(pane().cur.row)) {
+    std::string c = doc().buf.line_slice(pane().cur.row, pane().cur.col, 1);
+    doc().buf.erase_text(pane().cur.row, pane().cur.col, 1);
+    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col, c, std::string()});
     doc().modified = true; doc().um.clear_redo();
   }
 }
@@ -1033,7 +1111,7 @@ void Editor::delete_line() {
   push_op({Operation::DeleteLine, pane().cur.row, 0, doc().buf.line(pane().cur.row), std::string()});
   doc().buf.erase_line(pane().cur.row);
   if (pane().cur.row >= doc().buf.line_count()) pane().cur.row = std::max(0, doc().buf.line_count() - 1);
-  pane().cur.col = std::min(pane().cur.col, (int)doc().buf.line(pane().cur.row).size());
+  pane().cur.col = std::min(pane().cur.col, doc().buf.line_length(pane().cur.row));
   doc().modified = true; doc().um.clear_redo();
 }
 
@@ -1053,7 +1131,7 @@ void Editor::delete_lines_range(int start_row, int count) {
   reg.linewise = true;
   doc().buf.erase_lines(start_row, start_row + n);
   pane().cur.row = std::min(start_row, std::max(0, doc().buf.line_count() - 1));
-  pane().cur.col = std::min(pane().cur.col, (int)doc().buf.line(pane().cur.row).size());
+  pane().cur.col = std::min(pane().cur.col, doc().buf.line_length(pane().cur.row));
   doc().modified = true; doc().um.clear_redo();
 }
 
@@ -1136,30 +1214,25 @@ void Editor::insert_line_above() {
 }
 
 void Editor::split_line_at_cursor() {
-  std::string s = doc().buf.line(pane().cur.row);
-  std::string left = s.substr(0, pane().cur.col);
-  std::string right = s.substr(pane().cur.col);
-  doc().buf.replace_line(pane().cur.row, left);
-  doc().buf.insert_line(pane().cur.row + 1, right);
+  int len = doc().buf.line_length(pane().cur.row);
+  std::string right = doc().buf.line_slice(pane().cur.row, pane().cur.col, std::max(0, len - pane().cur.col));
+  doc().buf.split_line(pane().cur.row, pane().cur.col);
   push_op({Operation::InsertLine, pane().cur.row + 1, 0, right, std::string()});
   pane().cur.row++; pane().cur.col = 0; doc().modified = true; doc().um.clear_redo();
 }
 
 void Editor::backspace() {
   if (pane().cur.col > 0) {
-    std::string s = doc().buf.line(pane().cur.row);
-    char c = s[pane().cur.col - 1];
-    s.erase(s.begin() + pane().cur.col - 1);
-    doc().buf.replace_line(pane().cur.row, s);
-    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col - 1, std::string(1, c), std::string()});
+    std::string c = doc().buf.line_slice(pane().cur.row, pane().cur.col - 1, 1);
+    doc().buf.erase_text(pane().cur.row, pane().cur.col - 1, 1);
+    push_op({Operation::DeleteChar, pane().cur.row, pane().cur.col - 1, c, std::string()});
     pane().cur.col--; doc().modified = true; doc().um.clear_redo();
   } else if (pane().cur.row > 0) {
     std::string prev = doc().buf.line(pane().cur.row - 1);
     std::string curr = doc().buf.line(pane().cur.row);
     int old_row = pane().cur.row;
     int old_col = prev.size();
-    doc().buf.replace_line(pane().cur.row - 1, prev + curr);
-    doc().buf.erase_line(pane().cur.row);
+    doc().buf.join_lines(pane().cur.row - 1);
     push_op({Operation::ReplaceLine, old_row - 1, (int)prev.size(), prev, prev + curr});
     pane().cur.row = old_row - 1; pane().cur.col = old_col; doc().modified = true; doc().um.clear_redo();
   }
@@ -1181,6 +1254,8 @@ void Editor::move_to_top() {
 }
 
 void Editor::move_to_bottom() {
+  // the last line is only known once the whole file is in
+  wait_loaded();
   pane().cur.row = doc().buf.line_count() - 1;
   pane().cur.col = std::min(pane().cur.col, max_col_for_row(pane().cur.row));
 }
@@ -1193,8 +1268,9 @@ basicly you need to consider the following cases:
 4. pane().cur.col is a symbol
 */
 void Editor::move_to_next_word_left(){
+  std::string scratch;
   while (true) {
-    const auto& line = doc().buf.line(pane().cur.row);
+    std::string_view line = doc().buf.line_view(pane().cur.row, scratch);
     int len = (int)line.size();
     if (pane().cur.col >= len) {
       if (pane().cur.row + 1 >= doc().buf.line_count()) { pane().cur.col = len; break; }
@@ -1234,8 +1310,9 @@ void Editor::move_to_next_word_left(){
 
 
 void Editor::move_to_next_word_right() {
+  std::string scratch;
   while (true) {
-    const auto& line = doc().buf.line(pane().cur.row);
+    std::string_view line = doc().buf.line_view(pane().cur.row, scratch);
     int len = (int)line.size();
     if (pane().cur.col >= len) {
       if (pane().cur.row + 1 >= doc().buf.line_count()) { pane().cur.col = len; break; }
@@ -1267,7 +1344,8 @@ void Editor::move_to_next_word_right() {
         if (pane().cur.col >= len) {
           if (pane().cur.row + 1 >= doc().buf.line_count()) { pane().cur.col = len; break; }
           pane().cur.row++; pane().cur.col = 0;
-          const auto& line2 = doc().buf.line(pane().cur.row);
+          std::string scratch2;
+          std::string_view line2 = doc().buf.line_view(pane().cur.row, scratch2);
           int len2 = (int)line2.size();
           while (pane().cur.col < len2 && is_space((unsigned char)line2[pane().cur.col])) pane().cur.col++;
           if (pane().cur.col < len2) {
@@ -1302,12 +1380,13 @@ void Editor::move_to_next_word_right() {
 void Editor::move_to_previous_word_left() {
   auto isSpace = [](unsigned char c){ return std::isspace(c) != 0; };
   auto isWord  = [](unsigned char c){ return std::isalnum(c) != 0 || c == '_'; };
+  std::string scratch;
   while (true) {
-    const auto& line = doc().buf.line(pane().cur.row);
+    std::string_view line = doc().buf.line_view(pane().cur.row, scratch);
     int len = (int)line.size();
     if (pane().cur.col == 0) {
       if (pane().cur.row == 0) { pane().cur.col = 0; break; }
-      pane().cur.row--; pane().cur.col = (int)doc().buf.line(pane().cur.row).size();
+      pane().cur.row--; pane().cur.col = doc().buf.line_length(pane().cur.row);
       continue;
     }
     pane().cur.col--;
@@ -1490,21 +1569,28 @@ void Editor::indent_lines(int start_row, int count) {
   if (count <= 0) return;
   int end = std::min(doc().buf.line_count(), start_row + count);
   std::string pad(std::max(1, tab_width), ' ');
-  for (int r = start_row; r < end; ++r) {
-    std::string old = doc().buf.line(r);
+  std::vector<LineEdit> edits;
+  edits.reserve(static_cast<size_t>(std::max(0, end - start_row)));
+  std::string scratch;
+  for (auto it = doc().buf.line_cursor(start_row); it.valid() && it.row() < end; it.next()) {
+    std::string old(it.view(scratch));
     std::string neu = pad + old;
-    push_op({Operation::ReplaceLine, r, 0, old, neu});
-    doc().buf.replace_line(r, neu);
-    doc().modified = true;
+    push_op({Operation::ReplaceLine, it.row(), 0, std::move(old), neu});
+    edits.push_back({static_cast<size_t>(it.row()), 1, {std::move(neu)}});
   }
+  if (edits.empty()) return;
+  doc().buf.apply_edits(std::move(edits));
+  doc().modified = true;
 }
 
 void Editor::dedent_lines(int start_row, int count) {
   if (count <= 0) return;
   int end = std::min(doc().buf.line_count(), start_row + count);
   int max_cols = std::max(1, tab_width);
-  for (int r = start_row; r < end; ++r) {
-    std::string old = doc().buf.line(r);
+  std::vector<LineEdit> edits;
+  std::string scratch;
+  for (auto it = doc().buf.line_cursor(start_row); it.valid() && it.row() < end; it.next()) {
+    std::string_view old = it.view(scratch);
     size_t remove_bytes = 0;
     int removed_cols = 0;
     while (remove_bytes < old.size() && removed_cols < max_cols) {
@@ -1514,11 +1600,13 @@ void Editor::dedent_lines(int start_row, int count) {
       break;
     }
     if (remove_bytes == 0) continue;
-    std::string neu = old.substr(remove_bytes);
-    push_op({Operation::ReplaceLine, r, 0, old, neu});
-    doc().buf.replace_line(r, neu);
-    doc().modified = true;
+    std::string neu(old.substr(remove_bytes));
+    push_op({Operation::ReplaceLine, it.row(), 0, std::string(old), neu});
+    edits.push_back({static_cast<size_t>(it.row()), 1, {std::move(neu)}});
   }
+  if (edits.empty()) return;
+  doc().buf.apply_edits(std::move(edits));
+  doc().modified = true;
 }
 
 void Editor::set_tab_width(int width) {
@@ -1529,7 +1617,7 @@ void Editor::set_tab_width(int width) {
 
 int Editor::max_col_for_row(int row) const {
   if (row < 0 || row >= doc().buf.line_count()) return 0;
-  int len = (int)doc().buf.line(row).size();
+  int len = doc().buf.line_length(row);
   if (virtualedit_onemore) return len;
   return (len > 0) ? (len - 1) : 0;
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <optional>
 #include <filesystem>
+#include <limits>
 #include <string>
 #include <vector>
 #include "types.hpp"
@@ -11,21 +12,28 @@
 #include "ncurses_terminal.hpp"
 #include "cmd_registry.hpp"
 #include "pane_layout.hpp"
+#include "progressive_load.hpp"
 #include <memory>
 #include <unordered_map>
 
 class Editor {
 public:
-  explicit Editor(const std::optional<std::filesystem::path>& file);
+  /*read_only opens file in view mode, see open_view_in_pane*/
+  explicit Editor(const std::optional<std::filesystem::path>& file, bool read_only = false);
   void run();
 
 private:
+  friend struct EditorTestAccess;
   struct Document {
     TextBuffer buf;
     UndoManager um;
     std::optional<UndoEntry> last_change;
     std::optional<std::filesystem::path> file_path;
     bool modified = false;
+    /*a view: the file stays mapped and cannot be edited*/
+    bool read_only = false;
+    /*set while a big file is still streaming in; see ProgressiveLoad*/
+    std::unique_ptr<ProgressiveLoad> loading;
   };
 
   struct Pane {
@@ -46,6 +54,13 @@ private:
   bool close_or_quit(bool force);
   int active_pane_count() const;
   void open_path_in_pane(int idx, const std::filesystem::path& path);
+  static std::string load_document(Document& d, const std::filesystem::path& path);
+  /*open path read-only on the mapped view core, for files too big to load*/
+  void open_view_in_pane(int idx, const std::filesystem::path& path);
+  /*append ready batches of every loading document; true while any is still loading*/
+  bool pump_loads();
+  /*block until the active document has rows lines, or all of them*/
+  void wait_loaded(int rows = std::numeric_limits<int>::max());
   void collect_layout(std::vector<PaneRect>& out) const;
   void focus_next_pane();
   void focus_direction(char dir);
@@ -78,9 +93,6 @@ private:
   bool virtualedit_onemore = false;
   enum class PendingOp { None, Delete, Yank };
   PendingOp pending_op = PendingOp::None;
-  bool insert_buffer_active = false;
-  int insert_buffer_row = -1;
-  std::string insert_buffer_line;
   std::vector<Pane> panes;
   int active_pane = 0;
   std::unique_ptr<SplitNode> layout;
@@ -93,10 +105,8 @@ private:
   void handle_insert_input(int ch);
   void handle_command_input(int ch);
   void handle_mouse();
-  void begin_insert_buffer();
   void apply_insert_char(int ch);
   void apply_backspace();
-  void commit_insert_buffer();
   void execute_command();
   void register_commands();
   void move_left();
@@ -2,6 +2,7 @@
 #include <ncurses.h>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <string>
 #include <filesystem>
 
@@ -12,6 +13,9 @@
 void Editor::register_commands() {
   registry.register_command("w", [this](const std::vector<std::string>& args){
     std::string mm;
+    // a file still loading is saved whole
+    wait_loaded();
+    if (args.empty() && doc().read_only) { message = "read-only view: use :w <path>"; return; }
     if (!args.empty()) { if (buf.write_file(args[0], mm)) { modified = false; } message = mm; }
     else if (file_path) { if (buf.write_file(*file_path, mm)) { modified = false; } message = mm; }
     else { message = "don't have path, use :w <path>"; }
@@ -22,6 +26,8 @@ void Editor::register_commands() {
   registry.register_command("q!", [this](const std::vector<std::string>&){ close_or_quit(true); });
   registry.register_command("wq", [this](const std::vector<std::string>& args){
     std::string mm;
+    if (args.empty() && doc().read_only) { close_or_quit(false); return; }
+    wait_loaded();
     if (file_path) { if (buf.write_file(*file_path, mm)) { modified = false; close_or_quit(true); } message = mm; }
     else {
       if (!args.empty()) { if (buf.write_file(args[0], mm)) { modified = false; close_or_quit(true); } message = mm; }
@@ -119,10 +125,28 @@ void Editor::register_commands() {
     message = std::string("searchhl=") + v;
   });
   registry.register_command("backend", [this](const std::vector<std::string>& args){
-    (void)args;
+    if (!args.empty() && doc().read_only) { message = "read-only view"; return; }
+    if (!args.empty() && !buf.set_backend(args[0])) {
+      message = "backend: use :backend " + TextBuffer::backend_names();
+      return;
+    }
     message = "backend=";
     message += buf.backend_name();
   });
+  registry.register_command("goto", [this](const std::vector<std::string>& args){
+    // vim style: :goto N puts the cursor on byte N of the file, 1-based
+    size_t n = 1;
+    if (!args.empty()) {
+      const std::string& s = args[0];
+      bool ok = !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c){ return std::isdigit(c) != 0; });
+      if (!ok) { message = "goto: use :goto <byte>"; return; }
+      try { n = std::stoull(s); } catch (...) { message = "goto: invalid number"; return; }
+    }
+    wait_loaded();
+    Cursor c = buf.byte_to_cursor(n == 0 ? 0 : n - 1);
+    pane().cur.row = c.row;
+    pane().cur.col = std::min(c.col, max_col_for_row(c.row));
+  });
   registry.register_command("set onemore", [this](const std::vector<std::string>& args){
     if (args.empty()){
       virtualedit_onemore = !virtualedit_onemore;
@@ -190,6 +214,37 @@ void Editor::register_commands() {
       else { message = "set autoindent: use :set autoindent on|off"; }
     }
   });
+  registry.register_command("set maxmem", [this](const std::vector<std::string>& args){
+    // like vim, a bare number is in KB; 0 lifts the cap
+    if (args.empty() || args[0].empty()) { message = "set maxmem: use :set maxmem=<size>[K|M|G]"; return; }
+    std::string s = args[0];
+    size_t unit = 1024;
+    switch (std::toupper(static_cast<unsigned char>(s.back()))) {
+      case 'K': unit = size_t(1) << 10; s.pop_back(); break;
+      case 'M': unit = size_t(1) << 20; s.pop_back(); break;
+      case 'G': unit = size_t(1) << 30; s.pop_back(); break;
+      default: break;
+    }
+    bool ok = !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c){ return std::isdigit(c) != 0; });
+    if (!ok) { message = "set maxmem: size must be a number"; return; }
+    size_t n = 0;
+    try { n = std::stoull(s); } catch (...) { message = "set maxmem: invalid number"; return; }
+    if (n > SIZE_MAX / unit) { message = "set maxmem: size too large"; return; }
+    if (doc().read_only) { message = "read-only view"; return; }
+    // lifting the cap never moves the document; other backends have none to lift
+    if (n == 0) {
+      buf.set_memory_budget(0);
+      message = "maxmem=0";
+      return;
+    }
+    // the budget needs the edits kept apart from the file, which only the piece table does;
+    // moving there spills the text as it goes rather than copying it all to the heap first
+    if (!buf.set_memory_budget(n * unit) && !(buf.set_backend("piece", n * unit) && buf.set_memory_budget(n * unit))) {
+      message = "set maxmem: needs the piece backend";
+      return;
+    }
+    message = "maxmem=" + args[0] + " backend=" + std::string(buf.backend_name());
+  });
   registry.register_command("vsplit", [this](const std::vector<std::string>& args){
     std::optional<std::filesystem::path> p;
     if (!args.empty()) p = std::filesystem::path(args[0]);
@@ -235,6 +290,12 @@ void Editor::register_commands() {
       split_vertical(p);
     }
   });
+  registry.register_command("view", [this](const std::vector<std::string>& args){
+    if (!args.empty()) { open_view_in_pane(active_pane, args[0]); return; }
+    if (!file_path) { message = "view <file>"; return; }
+    if (modified) { message = "unsaved changes: :w first"; return; }
+    open_view_in_pane(active_pane, *file_path);
+  });
 }
 
 #undef buf
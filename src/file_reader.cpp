@@ -3,107 +3,166 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <thread>
-#include <future>
 #include <algorithm>
+#include <cstring>
+#include "posix_fd.hpp"
+#include "newline_scan.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/*the whole file mapped for one read, unmapped on scope exit*/
+class ReadMapping {
+public:
+  ReadMapping() = default;
+  ReadMapping(const ReadMapping&) = delete;
+  ReadMapping& operator=(const ReadMapping&) = delete;
+  ~ReadMapping() { if (mem_) ::munmap(mem_, n_); }
+
+  bool open(const std::filesystem::path& path, std::string& msg) {
+    UniqueFd fd(::open(path.string().c_str(), O_RDONLY));
+    if (!fd.valid()) { msg = std::string("can not open file: ") + path.string(); return false; }
+    struct stat st{};
+    if (::fstat(fd.get(), &st) != 0) { msg = std::string("can not read file stat: ") + path.string(); return false; }
+    n_ = static_cast<size_t>(st.st_size);
+    if (n_ == 0) return true;
+    void* mem = ::mmap(nullptr, n_, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (mem == MAP_FAILED) { n_ = 0; msg = std::string("can not mmap file: ") + path.string(); return false; }
+    mem_ = mem;
+    (void)::madvise(mem_, n_, MADV_SEQUENTIAL);
+    return true;
+  }
+  const char* data() const { return static_cast<const char*>(mem_); }
+  size_t size() const { return n_; }
+
+private:
+  void* mem_ = nullptr;
+  size_t n_ = 0;
+};
+
+/*
+  the file cut into equal parts of at least PART_MIN bytes, run as tasks
+  on the shared pool. reads go count, prefix sum, write: each part
+  counts the lines it ends and the text bytes it keeps, the sums give
+  every part its first line and output offset, then all parts write their
+  lines straight into place. a line crossing a boundary belongs to the
+  part holding its '\n'.
+*/
+class Parts {
+public:
+  static constexpr size_t PART_MIN = 1 << 20;
+  static constexpr size_t PARTS_MAX = 64;
+
+  Parts(const char* data, size_t n) : data_(data), n_(n) {
+    parts_ = static_cast<unsigned>(std::clamp<size_t>(n / PART_MIN, 1, PARTS_MAX));
+    count();
+  }
+  size_t begin(unsigned t) const { return t == parts_ ? n_ : n_ / parts_ * t; }
+  /*first line and first kept byte of part t*/
+  size_t first_line(unsigned t) const { return nl_[t]; }
+  size_t first_byte(unsigned t) const { return kept_[t]; }
+  /*every file has one line more than it has '\n's*/
+  size_t lines() const { return nl_[parts_] + 1; }
+  size_t kept_bytes() const { return kept_[parts_]; }
+  /*a '\r' is dropped before a '\n' and at the very end; it is counted by the part holding it*/
+  bool dropped_cr(size_t i) const { return data_[i] == '\r' && (i + 1 == n_ || data_[i + 1] == '\n'); }
+  /*where the line running into part t starts*/
+  size_t line_start(unsigned t) const {
+    for (unsigned u = t; u-- > 0;) {
+      if (nl_[u + 1] == nl_[u]) continue;
+      size_t i = begin(u + 1);
+      while (data_[i - 1] != '\n') --i;
+      return i;
+    }
+    return 0;
+  }
+  /*fn(t) for every part, spread over the task pool*/
+  template <typename F>
+  void run(F&& fn) const {
+    parallel_for(0, parts_, 1, [&](size_t t) { fn(static_cast<unsigned>(t)); });
+  }
+
+private:
+  void count() {
+    nl_.assign(parts_ + 1, 0);
+    kept_.assign(parts_ + 1, 0);
+    run([&](unsigned t) {
+      size_t s = begin(t), e = begin(t + 1);
+      NewlineCount c = count_newlines(data_ + s, e - s);
+      size_t cr = c.crlf + (dropped_cr(e - 1) ? 1 : 0);
+      nl_[t + 1] = c.newlines;
+      kept_[t + 1] = e - s - c.newlines - cr;
+    });
+    for (unsigned t = 0; t < parts_; ++t) { nl_[t + 1] += nl_[t]; kept_[t + 1] += kept_[t]; }
+  }
+  const char* data_;
+  size_t n_;
+  unsigned parts_ = 1;
+  std::vector<size_t> nl_, kept_;
+};
+
+}  // namespace
 
 bool mmap_readlines(const std::filesystem::path& path,
                    std::vector<std::string>& out_lines,
                    std::string& msg) {
   out_lines.clear();
-  int fd = ::open(path.string().c_str(), O_RDONLY);
-  if (fd < 0) { msg = std::string("can not open file: ") + path.string(); return false; }
-  struct stat st{};
-  if (::fstat(fd, &st) != 0) { ::close(fd); msg = std::string("can not read file stat: ") + path.string(); return false; }
-  size_t n = static_cast<size_t>(st.st_size);
-  if (n == 0) { ::close(fd); out_lines.emplace_back(""); msg = std::string("opened") + path.string(); return true; }
-  void* mem = ::mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (mem == MAP_FAILED) { ::close(fd); msg = std::string("can not mmap file: ") + path.string(); return false; }
-  const char* data = static_cast<const char*>(mem);
-  (void)::madvise(const_cast<char*>(data), n, MADV_SEQUENTIAL);
+  ReadMapping file;
+  if (!file.open(path, msg)) return false;
+  size_t n = file.size();
+  if (n == 0) { out_lines.emplace_back(""); msg = std::string("opened file: ") + path.string(); return true; }
+  const char* data = file.data();
 
-  unsigned hw = std::thread::hardware_concurrency();
-  if (hw == 0) hw = 4;
-  const size_t min_parallel_size = 1 << 20; 
-  if (n < min_parallel_size || hw == 1) {
-    size_t start = 0;
-    for (size_t i = 0; i < n; ++i) {
-      if (data[i] == '\n') {
-        size_t end = i;
-        if (end > start && data[end - 1] == '\r') end--;
-        out_lines.emplace_back(data + start, end - start);
-        start = i + 1;
-      }
-    }
-    if (start <= n) {
-      size_t end = n;
-      if (end > start && data[end - 1] == '\r') end--;
-      if (end >= start) out_lines.emplace_back(data + start, end - start);
-    }
-  } else {
-    unsigned threads = std::min<unsigned>(hw, static_cast<unsigned>(n / min_parallel_size));
-    threads = std::max(threads, 2u);
-    std::vector<std::vector<size_t>> newline_pos(threads);
-    std::vector<std::future<void>> futs;
-    size_t chunk = n / threads;
-    for (unsigned t = 0; t < threads; ++t) {
-      size_t s = t * chunk;
-      size_t e = (t + 1 == threads) ? n : (t + 1) * chunk;
-      futs.emplace_back(std::async(std::launch::async, [&, s, e, t]{
-        auto& vec = newline_pos[t];
-        vec.reserve((e - s) / 64 + 1);
-        for (size_t i = s; i < e; ++i) {
-          if (data[i] == '\n') vec.push_back(i);
-        }
-      }));
-    }
-    for (auto& f : futs) f.get();
-    size_t total_nl = 0; for (const auto& v : newline_pos) total_nl += v.size();
-    std::vector<size_t> nl; nl.reserve(total_nl);
-    for (unsigned t = 0; t < threads; ++t) {
-      nl.insert(nl.end(), newline_pos[t].begin(), newline_pos[t].end());
-    }
-    std::vector<std::pair<size_t,size_t>> ranges; ranges.reserve(nl.size() + 1);
-    size_t start = 0;
-    for (size_t pos : nl) {
-      size_t end = pos;
-      if (end > start && data[end - 1] == '\r') end--;
-      ranges.emplace_back(start, end);
-      start = pos + 1;
-    }
-    if (start <= n) {
-      size_t end = n;
-      if (end > start && data[end - 1] == '\r') end--;
-      if (end >= start) ranges.emplace_back(start, end);
-    }
-    out_lines.resize(ranges.size());
-    unsigned tcopy = std::min<unsigned>(hw, static_cast<unsigned>(ranges.size()));
-    if (tcopy <= 1 || ranges.size() < 1024) {
-      for (size_t i = 0; i < ranges.size(); ++i) {
-        auto [s, e] = ranges[i];
-        out_lines[i] = std::string(data + s, e - s);
-      }
-    } else {
-      size_t per = (ranges.size() + tcopy - 1) / tcopy;
-      std::vector<std::future<void>> f2;
-      for (unsigned t = 0; t < tcopy; ++t) {
-        size_t i0 = t * per;
-        size_t i1 = std::min(ranges.size(), (t + 1) * per);
-        if (i0 >= i1) break;
-        f2.emplace_back(std::async(std::launch::async, [&, i0, i1]{
-          for (size_t i = i0; i < i1; ++i) {
-            auto [s, e] = ranges[i];
-            out_lines[i] = std::string(data + s, e - s);
-          }
-        }));
-      }
-      for (auto& f : f2) f.get();
-    }
-  }
+  Parts parts(data, n);
+  out_lines.resize(parts.lines());
+  parts.run([&](unsigned t) {
+    size_t s = parts.begin(t), e = parts.begin(t + 1), line = parts.first_line(t), start = parts.line_start(t);
+    for_each_newline(data + s, e - s, [&](size_t off) {
+      size_t end = s + off;
+      if (end > start && data[end - 1] == '\r') --end;
+      out_lines[line++].assign(data + start, end - start);
+      start = s + off + 1;
+    });
+    if (e == n) out_lines[line].assign(data + start, n - start - (parts.dropped_cr(n - 1) ? 1 : 0));
+  });
+
+  msg = std::string("opened file: ") + path.string();
+  return true;
+}
+
+bool mmap_readarena(const std::filesystem::path& path,
+                    LineArena& out,
+                    std::string& msg) {
+  ReadMapping file;
+  if (!file.open(path, msg)) return false;
+  size_t n = file.size();
+  if (n == 0) { out.reset(0, 1); out.ends_data()[0] = 0; msg = std::string("opened file: ") + path.string(); return true; }
+  const char* data = file.data();
+
+  Parts parts(data, n);
+  out.reset(parts.kept_bytes(), parts.lines());
+  char* text = out.text_data();
+  size_t* ends = out.ends_data();
+  parts.run([&](unsigned t) {
+    size_t s = parts.begin(t), e = parts.begin(t + 1), line = parts.first_line(t);
+    char* o = text + parts.first_byte(t);
+    const char* p = data + s;
+    for_each_newline(data + s, e - s, [&](size_t off) {
+      const char* q = data + s + off;
+      size_t len = static_cast<size_t>(q - p);
+      if (len > 0 && q[-1] == '\r') --len;
+      std::memcpy(o, p, len);
+      o += len;
+      ends[line++] = static_cast<size_t>(o - text);
+      p = q + 1;
+    });
+    // the tail runs on into the next part, or is the last line
+    size_t len = static_cast<size_t>(data + e - p);
+    if (len > 0 && parts.dropped_cr(e - 1)) --len;
+    std::memcpy(o, p, len);
+  });
+  ends[parts.lines() - 1] = parts.kept_bytes();
 
-  ::munmap(mem, n);
-  ::close(fd);
-  if (out_lines.empty()) out_lines.emplace_back("");
   msg = std::string("opened file: ") + path.string();
   return true;
 }
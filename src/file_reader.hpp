@@ -8,7 +8,18 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include "line_arena.hpp"
 
 bool mmap_readlines(const std::filesystem::path& path,
                    std::vector<std::string>& out_lines,
                    std::string& msg);
+
+/*
+  same lines as mmap_readlines, into one arena instead of a string per
+  line. big files are split and copied in parallel: each chunk counts its
+  newlines, a prefix sum gives it its first line and output offset, then
+  it copies its lines straight into place.
+*/
+bool mmap_readarena(const std::filesystem::path& path,
+                    LineArena& out,
+                    std::string& msg);
@@ -1,4 +1,6 @@
 #include "gap_buffer.hpp"
+#include <algorithm>
+#include <cstring>
 
 void GapBuffer::clear() { buf.clear(); gap_start = gap_end = 0; }
 
@@ -17,19 +19,33 @@ void GapBuffer::init_from_lines(const std::vector<std::string>& lines) {
   gap_start = gap_end = k;
 }
 
+void GapBuffer::init_from_arena(const LineArena& arena) {
+  size_t n = arena.size();
+  buf.resize(n == 0 ? 0 : arena.bytes() + n - 1);
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) {
+    std::string_view s = arena[i];
+    if (!s.empty()) std::memcpy(buf.data() + k, s.data(), s.size());
+    k += s.size();
+    if (i + 1 < n) buf[k++] = '\n';
+  }
+  gap_start = gap_end = k;
+}
+
 void GapBuffer::ensure_gap(size_t need) {
   size_t avail = (gap_end - gap_start);
   if (avail >= need) return;
-  size_t grow = need - avail;
+  // grow geometrically so a run of one-char inserts is amortized O(1)
+  size_t grow = std::max(need - avail, buf.size() / 4 + 16);
   size_t new_size = buf.size() + grow + grow;
   std::vector<char> nb;
   nb.resize(new_size);
   size_t left = gap_start;
-  for (size_t i = 0; i < left; ++i) nb[i] = buf[i];
   size_t right = buf.size() - gap_end;
   size_t ngs = left;
   size_t nge = ngs + avail + grow + grow;
-  for (size_t i = 0; i < right; ++i) nb[nge + i] = buf[gap_end + i];
+  if (left) std::memcpy(nb.data(), buf.data(), left);
+  if (right) std::memcpy(nb.data() + nge, buf.data() + gap_end, right);
   buf.swap(nb);
   gap_start = ngs;
   gap_end = nge;
@@ -39,18 +55,18 @@ void GapBuffer::move_gap_to(size_t pos) {
   if (pos == gap_start) return;
   if (pos < gap_start) {
     size_t delta = gap_start - pos;
-    for (size_t i = 0; i < delta; ++i) buf[gap_end - 1 - i] = buf[gap_start - 1 - i];
+    std::memmove(buf.data() + gap_end - delta, buf.data() + pos, delta);
     gap_start -= delta; gap_end -= delta;
   } else {
     size_t delta = pos - gap_start;
-    for (size_t i = 0; i < delta; ++i) buf[gap_start + i] = buf[gap_end + i];
+    std::memmove(buf.data() + gap_start, buf.data() + gap_end, delta);
     gap_start += delta; gap_end += delta;
   }
 }
 
-void GapBuffer::insert_text(const std::string& text) {
+void GapBuffer::insert_text(std::string_view text) {
   ensure_gap(text.size());
-  for (size_t i = 0; i < text.size(); ++i) buf[gap_start + i] = text[i];
+  if (!text.empty()) std::memcpy(buf.data() + gap_start, text.data(), text.size());
   gap_start += text.size();
 }
 
@@ -67,3 +83,10 @@ std::string GapBuffer::slice(size_t pos, size_t len) const {
   }
   return out;
 }
+
+std::string_view GapBuffer::view(size_t pos, size_t len, std::string& scratch) const {
+  if (pos + len <= gap_start) return std::string_view(buf.data() + pos, len);
+  if (pos >= gap_start) return std::string_view(buf.data() + pos + (gap_end - gap_start), len);
+  scratch = slice(pos, len);
+  return scratch;
+}
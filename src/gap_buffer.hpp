@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include "line_arena.hpp"
 
 class GapBuffer {
 public:
@@ -11,9 +13,12 @@ public:
   void clear();
   size_t length() const;
   void init_from_lines(const std::vector<std::string>& lines);
+  void init_from_arena(const LineArena& arena);
   void move_gap_to(size_t pos);
   void ensure_gap(size_t need);
-  void insert_text(const std::string& text);
+  void insert_text(std::string_view text);
   void erase_range(size_t pos, size_t len);
   std::string slice(size_t pos, size_t len) const;
+  /*view of [pos, pos + len) in place, or copied into scratch when it straddles the gap*/
+  std::string_view view(size_t pos, size_t len, std::string& scratch) const;
 };
@@ -6,86 +6,74 @@ void GapTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
   li.build_from_text(gb.buf, gb.gap_start, gb.gap_end);
 }
 
+void GapTextBufferCore::init_from_arena(const LineArena& arena) {
+  gb.clear();
+  gb.init_from_arena(arena);
+  li.build_from_text(gb.buf, gb.gap_start, gb.gap_end);
+}
+
 int GapTextBufferCore::line_count() const { return static_cast<int>(li.line_count()); }
 
-std::string GapTextBufferCore::get_line(int r) const {
-  if (r < 0) return std::string();
-  size_t start = li.line_start(static_cast<size_t>(r));
+void GapTextBufferCore::line_range(size_t r, size_t& start, size_t& len) const {
+  start = li.line_start(r);
   size_t end;
   size_t total = gb.length();
-  if (static_cast<size_t>(r) + 1 < li.line_count()) end = li.line_start(static_cast<size_t>(r) + 1);
+  if (r + 1 < li.line_count()) end = li.line_start(r + 1);
   else end = total;
-  size_t len = (end > start) ? (end - start) : 0;
-  if (static_cast<size_t>(r) + 1 < li.line_count()) {
+  len = (end > start) ? (end - start) : 0;
+  if (r + 1 < li.line_count()) {
     if (len > 0) len -= 1;
   }
+}
+
+std::string GapTextBufferCore::get_line(int r) const {
+  if (r < 0) return std::string();
+  size_t start, len;
+  line_range(static_cast<size_t>(r), start, len);
   return gb.slice(start, len);
 }
 
+std::string_view GapTextBufferCore::get_line_view(int r, std::string& scratch) const {
+  if (r < 0) return {};
+  size_t start, len;
+  line_range(static_cast<size_t>(r), start, len);
+  return gb.view(start, len, scratch);
+}
+
 static inline void rebuild(GapTextBufferCore& c) {
   c.li.build_from_text(c.gb.buf, c.gb.gap_start, c.gb.gap_end);
 }
 
+/*every edit is "replace [pos, pos + removed) by ins": move the gap there, patch the text and the index*/
+void GapTextBufferCore::splice(size_t pos, size_t removed, std::string_view ins) {
+  gb.erase_range(pos, removed);
+  gb.insert_text(ins);
+  li.on_replace(pos, removed, ins);
+}
+
 void GapTextBufferCore::insert_line(size_t row, const std::string& s) {
-  int L = line_count();
-  size_t rr = std::min(row, static_cast<size_t>(L));
-  if (L == 0) {
-    gb.move_gap_to(0);
-    gb.insert_text(s);
-    rebuild(*this);
-    return;
-  }
-  if (rr < static_cast<size_t>(L)) {
-    size_t pos = li.line_start(rr);
-    gb.move_gap_to(pos);
-    std::string ins = s; ins.push_back('\n');
-    gb.insert_text(ins);
-  } else {
-    size_t pos = gb.length();
-    gb.move_gap_to(pos);
-    std::string ins; ins.push_back('\n'); ins += s;
-    gb.insert_text(ins);
-  }
-  rebuild(*this);
+  insert_line(row, std::string_view(s));
 }
 
 void GapTextBufferCore::insert_line(size_t row, std::string_view s) {
-  insert_line(row, std::string(s));
+  insert_lines(row, std::span<const std::string_view>(&s, 1));
 }
 
 void GapTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
-  if (ss.empty()) return;
-  int L = line_count();
-  size_t rr = std::min(row, static_cast<size_t>(L));
-  std::string joined;
-  for (size_t i = 0; i < ss.size(); ++i) {
-    joined += ss[i]; if (i + 1 < ss.size()) joined.push_back('\n');
-  }
-  if (L == 0) {
-    gb.move_gap_to(0);
-    gb.insert_text(joined);
-    rebuild(*this);
-    return;
-  }
-  if (rr < static_cast<size_t>(L)) {
-    size_t pos = li.line_start(rr);
-    gb.move_gap_to(pos);
-    joined.push_back('\n');
-    gb.insert_text(joined);
-  } else {
-    size_t pos = gb.length();
-    gb.move_gap_to(pos);
-    std::string ins; ins.push_back('\n'); ins += joined;
-    gb.insert_text(ins);
-  }
-  rebuild(*this);
+  insert_lines(row, std::span<const std::string>(ss.begin(), ss.end()));
 }
 
 void GapTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  std::vector<std::string_view> vs(ss.begin(), ss.end());
+  insert_lines(row, std::span<const std::string_view>(vs));
+}
+
+void GapTextBufferCore::insert_lines(size_t row, std::span<const std::string_view> ss) {
   if (ss.empty()) return;
-  int L = line_count();
-  size_t rr = std::min(row, static_cast<size_t>(L));
+  size_t L = li.line_count();
+  size_t rr = std::min(row, L);
   std::string joined;
+  if (L != 0 && rr == L) joined.push_back('\n');
   for (size_t i = 0; i < ss.size(); ++i) {
     joined += ss[i]; if (i + 1 < ss.size()) joined.push_back('\n');
   }
@@ -95,53 +83,77 @@ void GapTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss
     rebuild(*this);
     return;
   }
-  if (rr < static_cast<size_t>(L)) {
-    size_t pos = li.line_start(rr);
-    gb.move_gap_to(pos);
+  if (rr < L) {
     joined.push_back('\n');
-    gb.insert_text(joined);
+    splice(li.line_start(rr), 0, joined);
   } else {
-    size_t pos = gb.length();
-    gb.move_gap_to(pos);
-    std::string ins; ins.push_back('\n'); ins += joined;
-    gb.insert_text(ins);
+    splice(gb.length(), 0, joined);
   }
-  rebuild(*this);
 }
 
 void GapTextBufferCore::erase_line(size_t row) {
-  int L = line_count();
-  if (row >= static_cast<size_t>(L)) return;
-  size_t start = li.line_start(row);
-  size_t end = (static_cast<int>(row) + 1 < L) ? li.line_start(row + 1) : gb.length();
-  gb.erase_range(start, end - start);
-  rebuild(*this);
+  erase_lines(row, row + 1);
 }
 
 void GapTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
-  int L = line_count();
+  size_t L = li.line_count();
   if (end_row < start_row) end_row = start_row;
-  if (start_row >= static_cast<size_t>(L)) return;
-  if (end_row > static_cast<size_t>(L)) end_row = static_cast<size_t>(L);
+  if (start_row >= L) return;
+  if (end_row > L) end_row = L;
+  if (start_row == end_row) return;
   size_t start = li.line_start(start_row);
-  size_t end = (static_cast<int>(end_row) < L) ? li.line_start(end_row) : gb.length();
-  gb.erase_range(start, end - start);
-  rebuild(*this);
+  size_t end = end_row < L ? li.line_start(end_row) : gb.length();
+  // the last line has no '\n' of its own: take the one before it instead
+  if (end_row == L && start_row > 0) start -= 1;
+  splice(start, end - start, {});
 }
 
 void GapTextBufferCore::replace_line(size_t row, const std::string& s) {
-  int L = line_count();
-  if (row >= static_cast<size_t>(L)) return;
-  size_t start = li.line_start(row);
-  size_t end = (static_cast<int>(row) + 1 < L) ? li.line_start(row + 1) : gb.length();
-  size_t len = end - start;
-  size_t content_len = (static_cast<int>(row) + 1 < L && len > 0) ? (len - 1) : len;
-  gb.move_gap_to(start);
-  gb.erase_range(start, content_len);
-  gb.insert_text(s);
-  rebuild(*this);
+  replace_line(row, std::string_view(s));
 }
 
 void GapTextBufferCore::replace_line(size_t row, std::string_view s) {
-  replace_line(row, std::string(s));
+  if (row >= li.line_count()) return;
+  size_t start, len;
+  line_range(row, start, len);
+  splice(start, len, s);
+}
+
+/*the rows become one run of bytes, so a whole batch costs a single gap move and index patch*/
+void GapTextBufferCore::replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+  size_t L = li.line_count();
+  start_row = std::min(start_row, L);
+  end_row = std::clamp(end_row, start_row, L);
+  if (ss.empty()) { erase_lines(start_row, end_row); return; }
+  if (start_row == end_row) { insert_lines(start_row, ss); return; }
+  size_t start = li.line_start(start_row), last_start, last_len;
+  line_range(end_row - 1, last_start, last_len);
+  size_t total = ss.size() - 1;
+  for (const auto& l : ss) total += l.size();
+  std::string joined;
+  joined.reserve(total);
+  for (size_t i = 0; i < ss.size(); ++i) { if (i) joined.push_back('\n'); joined += ss[i]; }
+  splice(start, last_start + last_len - start, joined);
+}
+
+void GapTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= li.line_count() || s.empty()) return;
+  size_t start, len;
+  line_range(row, start, len);
+  splice(start + std::min(col, len), 0, s);
+}
+
+void GapTextBufferCore::erase_text(size_t row, size_t col, size_t n) {
+  if (row >= li.line_count()) return;
+  size_t start, len;
+  line_range(row, start, len);
+  if (col >= len) return;
+  splice(start + col, std::min(n, len - col), {});
+}
+
+void GapTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= li.line_count()) return;
+  size_t start, len;
+  line_range(row, start, len);
+  splice(start + len, 1, {});
 }
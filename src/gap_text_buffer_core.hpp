@@ -9,9 +9,9 @@
 #include "line_index.hpp"
 
 /*
-  this is the gap buffer backend
-  btw, it's not steady version, may cause problem
-  you can choose vector backend if you want a steady version
+  gap buffer backend: the whole text in one GapBuffer, rows found through a
+  LineIndex that is patched around each edit instead of rebuilt, so an
+  edit costs the gap move plus O(log n + block size).
 */
 class GapTextBufferCore : public TextBufferCoreCRTP<GapTextBufferCore> {
 public:
@@ -20,29 +20,49 @@ public:
   static constexpr std::string_view get_name_sv() { return "gap"; }
 
   void init_from_lines(const std::vector<std::string>& lines);
+  void init_from_arena(const LineArena& arena);
   int line_count() const;
   std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
 
   void insert_line(size_t row, const std::string& s);
   void insert_line(size_t row, std::string_view s);
   void insert_lines(size_t row, const std::vector<std::string>& ss);
   void insert_lines(size_t row, std::span<const std::string> ss);
+  void insert_lines(size_t row, std::span<const std::string_view> ss);
   void erase_line(size_t row);
-  void erase_lines(size_t start_row, size_t end_row); 
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
   void replace_line(size_t row, const std::string& s);
   void replace_line(size_t row, std::string_view s);
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss);
+  /*edits inside one line*/
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col) { insert_text(row, col, "\n"); }
+  void join_lines(size_t row);
   /*forward to CRTP impl*/
   void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_init_from_arena(const LineArena& arena) { init_from_arena(arena); }
   int do_line_count() const { return line_count(); }
   std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
   void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
   void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
   void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
-  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, std::vector<std::string>(ss.begin(), ss.end())); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
   void do_erase_line(size_t row) { erase_line(row); }
   void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
   void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
   void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+private:
+  /*byte range of row in the logical text, without its '\n'*/
+  void line_range(size_t r, size_t& start, size_t& len) const;
+  void splice(size_t pos, size_t removed, std::string_view ins);
 };
 
 static_assert(TextBufferCoreCRTPConcept<GapTextBufferCore>, "Gap backend must satisfy CRTP concept");
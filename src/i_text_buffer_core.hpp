@@ -5,16 +5,174 @@
 #include <span>
 #include <concepts>
 #include <utility>
+#include <algorithm>
+#include "utf8.hpp"
+#include "line_arena.hpp"
 
+/*
+  line cursor fallback: walks rows by index through the core's random
+  access. fine for cores where get_line_view is O(1) already; tree cores
+  provide their own cursor that keeps its place in the tree.
+*/
+template <typename Core>
+class IndexLineCursor {
+public:
+  IndexLineCursor(const Core& core, int r) : core_(&core) { seek(r); }
+  bool valid() const { return row_ >= 0 && row_ < core_->line_count(); }
+  int row() const { return row_; }
+  void seek(int r) { row_ = r; }
+  void next() { ++row_; }
+  void prev() { --row_; }
+  std::string_view view(std::string& scratch) const { return core_->get_line_view(row_, scratch); }
+  size_t length() const { return core_->line_length(row_); }
+  std::string slice(size_t col, size_t len) const { return core_->line_slice(row_, col, len); }
 
+private:
+  const Core* core_;
+  int row_ = 0;
+};
+
+/*one edit of a batch: rows [row, row + erase) of the text before the batch give way to lines*/
+struct LineEdit {
+  size_t row = 0;
+  size_t erase = 0;
+  std::vector<std::string> lines;
+};
 
 template <typename Derived>
 class TextBufferCoreCRTP {
 public:
   std::string_view get_name() const { return as_const_derived().get_name_sv(); }
   void init_from_lines(const std::vector<std::string>& lines) { as_derived().do_init_from_lines(lines); }
+  /*
+    optional: init_from_lines that takes the lines over, leaving the vector
+    empty. cores storing std::string lines move them into place; the
+    fallback copies and then frees the source.
+  */
+  void adopt_lines(std::vector<std::string>&& lines) {
+    if constexpr (requires(Derived& d) { d.do_adopt_lines(std::move(lines)); }) as_derived().do_adopt_lines(std::move(lines));
+    else {
+      as_derived().do_init_from_lines(lines);
+      std::vector<std::string>().swap(lines);
+    }
+  }
+  /*
+    optional: load the lines of a LineArena. cores that pack text copy byte
+    ranges out of the arena with no allocation per line; the fallback makes
+    a string per line and adopts them.
+  */
+  void init_from_arena(const LineArena& arena) {
+    if constexpr (requires(Derived& d) { d.do_init_from_arena(arena); }) as_derived().do_init_from_arena(arena);
+    else {
+      std::vector<std::string> lines;
+      lines.reserve(arena.size());
+      for (size_t i = 0; i < arena.size(); ++i) lines.emplace_back(arena[i]);
+      adopt_lines(std::move(lines));
+    }
+  }
   int line_count() const { return as_const_derived().do_line_count(); }
   std::string get_line(int r) const { return as_const_derived().do_get_line(r); }
+  /*
+    borrowed access: the view points into the core when the line is stored
+    contiguously, otherwise into scratch. valid until the next edit of the
+    core or the next use of scratch.
+  */
+  std::string_view get_line_view(int r, std::string& scratch) const { return as_const_derived().do_get_line_view(r, scratch); }
+  /*optional: backends that can measure/slice a line without touching it all provide do_line_length/do_line_slice*/
+  size_t line_length(int r) const {
+    if constexpr (requires(const Derived& d) { d.do_line_length(r); }) return as_const_derived().do_line_length(r);
+    else { std::string scratch; return get_line_view(r, scratch).size(); }
+  }
+  std::string line_slice(int r, size_t col, size_t len) const {
+    if constexpr (requires(const Derived& d) { d.do_line_slice(r, col, len); }) return as_const_derived().do_line_slice(r, col, len);
+    else {
+      std::string scratch;
+      std::string_view v = get_line_view(r, scratch);
+      return col < v.size() ? std::string(v.substr(col, len)) : std::string();
+    }
+  }
+  /*
+    optional: sequential access. a cursor sits on one row, next/prev move it
+    by one line and seek jumps anywhere; it must not outlive an edit.
+  */
+  auto line_cursor(int r) const {
+    if constexpr (requires(const Derived& d) { d.do_line_cursor(r); }) return as_const_derived().do_line_cursor(r);
+    else return IndexLineCursor<Derived>(as_const_derived(), r);
+  }
+  /*
+    optional: whole-document measures. offsets count bytes of the text as
+    saved, i.e. lines joined by '\n' with no trailing newline; char_count is
+    in UTF-8 codepoints and max_line_length in bytes. cores that aggregate
+    these in their nodes answer in O(log n), the fallbacks scan every line.
+  */
+  size_t byte_count() const {
+    if constexpr (requires(const Derived& d) { d.do_byte_count(); }) return as_const_derived().do_byte_count();
+    else {
+      size_t n = 0;
+      for (auto it = line_cursor(0); it.valid(); it.next()) n += it.length() + 1;
+      return n == 0 ? 0 : n - 1;
+    }
+  }
+  size_t char_count() const {
+    if constexpr (requires(const Derived& d) { d.do_char_count(); }) return as_const_derived().do_char_count();
+    else {
+      size_t n = 0;
+      std::string scratch;
+      for (auto it = line_cursor(0); it.valid(); it.next()) n += utf8_length(it.view(scratch)) + 1;
+      return n == 0 ? 0 : n - 1;
+    }
+  }
+  size_t max_line_length() const {
+    if constexpr (requires(const Derived& d) { d.do_max_line_length(); }) return as_const_derived().do_max_line_length();
+    else {
+      size_t m = 0;
+      for (auto it = line_cursor(0); it.valid(); it.next()) m = std::max(m, it.length());
+      return m;
+    }
+  }
+  /*offset of the first byte of row r; r >= line_count() gives byte_count()*/
+  size_t row_to_byte(int r) const {
+    if (r <= 0) return 0;
+    if (r >= line_count()) return byte_count();
+    if constexpr (requires(const Derived& d) { d.do_row_to_byte(r); }) return as_const_derived().do_row_to_byte(r);
+    else {
+      size_t off = 0;
+      for (auto it = line_cursor(0); it.row() < r; it.next()) off += it.length() + 1;
+      return off;
+    }
+  }
+  /*row and column holding byte off; a '\n' belongs to the end of its line, past the end clamps to the last line*/
+  std::pair<int, size_t> byte_to_row(size_t off) const {
+    if (line_count() == 0) return {0, 0};
+    if constexpr (requires(const Derived& d) { d.do_byte_to_row(off); }) return as_const_derived().do_byte_to_row(off);
+    else {
+      auto it = line_cursor(0);
+      for (;;) {
+        size_t len = it.length();
+        if (off <= len || it.row() + 1 >= line_count()) return {it.row(), std::min(off, len)};
+        off -= len + 1;
+        it.next();
+      }
+    }
+  }
+  /*
+    optional: the saved text as a run of byte spans in order, f(span)
+    returning false to stop; false when it was stopped. cores that hold
+    the text as pieces hand them over as they are, the fallback gives
+    each line and the '\n's between them.
+  */
+  template <typename F>
+  bool for_each_span(F&& f) const {
+    if constexpr (requires(const Derived& d) { d.do_for_each_span(f); }) return as_const_derived().do_for_each_span(f);
+    else {
+      std::string scratch;
+      for (auto it = line_cursor(0); it.valid(); it.next()) {
+        if (it.row() > 0 && !f(std::string_view("\n"))) return false;
+        if (!f(it.view(scratch))) return false;
+      }
+      return true;
+    }
+  }
   /*insert*/
   void insert_line(size_t row, const std::string& s) { as_derived().do_insert_line(row, s); }
   void insert_line(size_t row, std::string_view s) { as_derived().do_insert_line(row, s); }
@@ -26,19 +184,77 @@ public:
   /*replace*/
   void replace_line(size_t row, const std::string& s) { as_derived().do_replace_line(row, s); }
   void replace_line(size_t row, std::string_view s) { as_derived().do_replace_line(row, s); }
+  /*
+    in-line edits, cost proportional to the edit rather than the line.
+    col is clamped to the line; split_line(row, col) moves [col, end) to a
+    new row below, join_lines(row) appends row + 1 to row and removes it.
+  */
+  void insert_text(size_t row, size_t col, std::string_view s) { as_derived().do_insert_text(row, col, s); }
+  void erase_text(size_t row, size_t col, size_t len) { as_derived().do_erase_text(row, col, len); }
+  void split_line(size_t row, size_t col) { as_derived().do_split_line(row, col); }
+  void join_lines(size_t row) { as_derived().do_join_lines(row); }
+  /*
+    optional: rows [start_row, end_row) become ss in one structural edit.
+    the fallback keeps start_row in place so no core ever sees itself empty.
+  */
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+    if constexpr (requires(Derived& d) { d.do_replace_lines(start_row, end_row, ss); }) as_derived().do_replace_lines(start_row, end_row, ss);
+    else if (ss.empty()) erase_lines(start_row, end_row);
+    else if (start_row == end_row) insert_lines(start_row, ss);
+    else {
+      replace_line(start_row, std::string_view(ss[0]));
+      erase_lines(start_row + 1, end_row);
+      insert_lines(start_row + 1, ss.subspan(1));
+    }
+  }
+  /*
+    a batch of edits, sorted by row and not overlapping, applied in one
+    pass. sparse batches of one-for-one replacements go line by line, the
+    rest are folded into a single replace_lines over the rows they span.
+  */
+  void apply_edits(std::span<const LineEdit> edits) {
+    if (edits.empty()) return;
+    size_t lo = edits.front().row, hi = lo;
+    bool replaces_only = true;
+    for (const LineEdit& e : edits) {
+      hi = std::max(hi, e.row + e.erase);
+      replaces_only = replaces_only && e.erase == e.lines.size();
+    }
+    if (replaces_only && edits.size() * 4 < hi - lo) {
+      for (const LineEdit& e : edits)
+        for (size_t i = 0; i < e.lines.size(); ++i) replace_line(e.row + i, std::string_view(e.lines[i]));
+      return;
+    }
+    std::vector<std::string> mid;
+    mid.reserve(hi - lo);
+    std::string scratch;
+    auto it = line_cursor(static_cast<int>(lo));
+    for (const LineEdit& e : edits) {
+      for (; static_cast<size_t>(it.row()) < e.row; it.next()) mid.emplace_back(it.view(scratch));
+      mid.insert(mid.end(), e.lines.begin(), e.lines.end());
+      for (size_t k = 0; k < e.erase; ++k) it.next();
+    }
+    replace_lines(lo, hi, mid);
+  }
 
 private:
   Derived& as_derived() { return static_cast<Derived&>(*this); }
   const Derived& as_const_derived() const { return static_cast<const Derived&>(*this); }
 };
 
+/*core aggregates byte_count/max_line_length itself instead of scanning*/
+template <typename D>
+inline constexpr bool has_fast_measures = requires(const D& d) { d.do_byte_count(); d.do_max_line_length(); };
+
 template <typename D>
 concept TextBufferCoreCRTPConcept = requires(
   D d, const D cd,
   const std::vector<std::string>& lines,
   std::span<const std::string> span_lines,
   size_t row, size_t start_row, size_t end_row,
+  size_t col, size_t len,
   int r,
+  std::string& scratch,
   const std::string& s,
   std::string_view sv
 ) {
@@ -46,6 +262,7 @@ concept TextBufferCoreCRTPConcept = requires(
   { d.do_init_from_lines(lines) } -> std::same_as<void>;
   { cd.do_line_count() } -> std::convertible_to<int>;
   { cd.do_get_line(r) } -> std::convertible_to<std::string>;
+  { cd.do_get_line_view(r, scratch) } -> std::same_as<std::string_view>;
   { d.do_insert_line(row, s) } -> std::same_as<void>;
   { d.do_insert_line(row, sv) } -> std::same_as<void>;
   { d.do_insert_lines(row, lines) } -> std::same_as<void>;
@@ -54,4 +271,8 @@ concept TextBufferCoreCRTPConcept = requires(
   { d.do_erase_lines(start_row, end_row) } -> std::same_as<void>;
   { d.do_replace_line(row, s) } -> std::same_as<void>;
   { d.do_replace_line(row, sv) } -> std::same_as<void>;
+  { d.do_insert_text(row, col, sv) } -> std::same_as<void>;
+  { d.do_erase_text(row, col, len) } -> std::same_as<void>;
+  { d.do_split_line(row, col) } -> std::same_as<void>;
+  { d.do_join_lines(row) } -> std::same_as<void>;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+/*
+  a whole file's lines in one arena: the text of every line back to back,
+  separators dropped, and the end offset of each line. two allocations
+  however many lines; line i is text[end(i - 1), end(i)).
+*/
+class LineArena {
+public:
+  size_t size() const { return lines_; }
+  /*text bytes, without separators*/
+  size_t bytes() const { return bytes_; }
+  size_t start(size_t i) const { return i == 0 ? 0 : ends_[i - 1]; }
+  size_t end(size_t i) const { return ends_[i]; }
+  std::string_view operator[](size_t i) const { return {text_.get() + start(i), end(i) - start(i)}; }
+  /*lines [b, e) back to back*/
+  std::string_view text(size_t b, size_t e) const { return {text_.get() + start(b), start(e) - start(b)}; }
+
+  /*room for bytes of text and lines ends, left uninitialized for the reader to fill*/
+  void reset(size_t bytes, size_t lines) {
+    text_ = std::make_unique_for_overwrite<char[]>(bytes);
+    ends_ = std::make_unique_for_overwrite<size_t[]>(lines);
+    bytes_ = bytes;
+    lines_ = lines;
+  }
+  char* text_data() { return text_.get(); }
+  size_t* ends_data() { return ends_.get(); }
+
+private:
+  std::unique_ptr<char[]> text_;
+  std::unique_ptr<size_t[]> ends_;
+  size_t bytes_ = 0;
+  size_t lines_ = 0;
+};
@@ -1,8 +1,14 @@
 #include "line_index.hpp"
+#include <algorithm>
+#include <cstring>
 
-static inline char at_logical(const std::vector<char>& buf, size_t gap_start, size_t gap_end, size_t i) {
-  if (i < gap_start) return buf[i];
-  return buf[i + (gap_end - gap_start)];
+static void collect_newlines(const char* p, size_t n, size_t base, std::vector<size_t>& starts) {
+  // an empty buffer has no data pointer, and memchr must not see a null one
+  if (n == 0) return;
+  const char* end = p + n;
+  for (const char* q = p; (q = static_cast<const char*>(std::memchr(q, '\n', static_cast<size_t>(end - q)))) != nullptr; ++q) {
+    starts.push_back(base + static_cast<size_t>(q - p) + 1);
+  }
 }
 
 void LineIndex::build_from_text(const std::vector<char>& buf, size_t gap_start, size_t gap_end) {
@@ -10,32 +16,114 @@ void LineIndex::build_from_text(const std::vector<char>& buf, size_t gap_start,
   size_t len = buf.size() - (gap_end - gap_start);
   std::vector<size_t> starts;
   starts.push_back(0);
-  for (size_t i = 0; i < len; ++i) {
-    char c = at_logical(buf, gap_start, gap_end, i);
-    if (c == '\n') starts.push_back(i + 1);
+  collect_newlines(buf.data(), gap_start, 0, starts);
+  collect_newlines(buf.data() + gap_end, buf.size() - gap_end, gap_start, starts);
+  set_blocks(0, 0, starts, len);
+  lines_ = starts.size();
+  bytes_ = len;
+  rebuild_fenwick();
+}
+
+void LineIndex::fw_add(std::vector<size_t>& fw, size_t i, size_t delta) {
+  // unsigned wraparound makes "adding" a negative delta work too
+  for (++i; i < fw.size(); i += i & (~i + 1)) fw[i] += delta;
+}
+
+size_t LineIndex::fw_prefix(const std::vector<size_t>& fw, size_t n) {
+  size_t s = 0;
+  for (; n > 0; n -= n & (~n + 1)) s += fw[n];
+  return s;
+}
+
+size_t LineIndex::fw_find(const std::vector<size_t>& fw, size_t target) const {
+  size_t k = 0;
+  size_t step = 1;
+  while (step * 2 < fw.size()) step *= 2;
+  for (; step > 0; step /= 2) {
+    if (k + step < fw.size() && fw[k + step] <= target) { k += step; target -= fw[k]; }
   }
-  size_t n = starts.size();
-  for (size_t i = 0; i < n; i += block_size) {
-    size_t end = std::min(n, i + block_size);
-    LineBlock b;
-    b.base_offset = starts[i];
-    b.rel.reserve(end - i);
-    for (size_t k = i; k < end; ++k) b.rel.push_back(starts[k] - b.base_offset);
-    blocks.push_back(std::move(b));
+  return std::min(k, blocks.size() - 1);
+}
+
+void LineIndex::rebuild_fenwick() {
+  fw_lines_.assign(blocks.size() + 1, 0);
+  fw_bytes_.assign(blocks.size() + 1, 0);
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    fw_lines_[i + 1] += blocks[i].rel.size();
+    fw_bytes_[i + 1] += blocks[i].bytes;
+    size_t up = (i + 1) + ((i + 1) & (~(i + 1) + 1));
+    if (up < fw_lines_.size()) { fw_lines_[up] += fw_lines_[i + 1]; fw_bytes_[up] += fw_bytes_[i + 1]; }
   }
 }
 
-size_t LineIndex::line_count() const { if (blocks.empty()) return 0; size_t c = 0; for (const auto& b : blocks) c += b.rel.size(); return c; }
+/*replace blocks [b0, b1) by starts (absolute, sorted) cut into evenly sized blocks*/
+void LineIndex::set_blocks(size_t b0, size_t b1, const std::vector<size_t>& starts, size_t region_end) {
+  size_t n = starts.size();
+  size_t g = std::max<size_t>(1, (n + block_size - 1) / block_size);
+  std::vector<LineBlock> fresh(g);
+  for (size_t i = 0; i < g; ++i) {
+    size_t lo = i * n / g, hi = (i + 1) * n / g;
+    size_t base = starts[lo];
+    fresh[i].rel.reserve(hi - lo);
+    for (size_t k = lo; k < hi; ++k) fresh[i].rel.push_back(starts[k] - base);
+    fresh[i].bytes = (hi < n ? starts[hi] : region_end) - base;
+  }
+  if (b1 - b0 == g) {
+    // same number of blocks: point updates keep the Fenwick trees valid
+    for (size_t i = 0; i < g; ++i) {
+      LineBlock& old = blocks[b0 + i];
+      if (!fw_lines_.empty()) {
+        fw_add(fw_lines_, b0 + i, fresh[i].rel.size() - old.rel.size());
+        fw_add(fw_bytes_, b0 + i, fresh[i].bytes - old.bytes);
+      }
+      old = std::move(fresh[i]);
+    }
+    return;
+  }
+  blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(b0), blocks.begin() + static_cast<std::ptrdiff_t>(b1));
+  blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(b0), std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+  fw_lines_.clear();
+  fw_bytes_.clear();
+}
 
 size_t LineIndex::line_start(size_t row) const {
   if (blocks.empty()) return 0;
-  size_t acc = 0;
-  for (const auto& b : blocks) {
-    if (row < acc + b.rel.size()) {
-      size_t idx = row - acc;
-      return b.base_offset + b.rel[idx];
+  if (row >= lines_) row = lines_ - 1;
+  size_t b = fw_find(fw_lines_, row);
+  size_t idx = row - fw_prefix(fw_lines_, b);
+  return fw_prefix(fw_bytes_, b) + blocks[b].rel[idx];
+}
+
+void LineIndex::on_replace(size_t pos, size_t removed, std::string_view inserted) {
+  if (blocks.empty()) return;
+  size_t end = pos + removed;
+  size_t b0 = fw_find(fw_bytes_, pos);
+  size_t b1 = fw_find(fw_bytes_, end) + 1;
+  // a small region borrows a neighbour so blocks don't fragment
+  size_t region_lines = fw_prefix(fw_lines_, b1) - fw_prefix(fw_lines_, b0);
+  if (region_lines < block_size / 2) {
+    if (b1 < blocks.size()) ++b1;
+    else if (b0 > 0) --b0;
+  }
+  size_t base = fw_prefix(fw_bytes_, b0);
+  size_t region_end = fw_prefix(fw_bytes_, b1);
+  // a start s sits right after a '\n' at s - 1, so it goes away when s is in (pos, end]
+  std::vector<size_t> starts;
+  starts.reserve(region_lines + block_size);
+  bool added = false;
+  size_t at = base;
+  for (size_t b = b0; b < b1; ++b) {
+    for (size_t r : blocks[b].rel) {
+      size_t s = at + r;
+      if (s > end && !added) { collect_newlines(inserted.data(), inserted.size(), pos, starts); added = true; }
+      if (s <= pos) starts.push_back(s);
+      else if (s > end) starts.push_back(s - removed + inserted.size());
     }
-    acc += b.rel.size();
+    at += blocks[b].bytes;
   }
-  return blocks.back().base_offset + blocks.back().rel.back();
+  if (!added) collect_newlines(inserted.data(), inserted.size(), pos, starts);
+  lines_ = lines_ - (fw_prefix(fw_lines_, b1) - fw_prefix(fw_lines_, b0)) + starts.size();
+  bytes_ = bytes_ - removed + inserted.size();
+  set_blocks(b0, b1, starts, region_end - removed + inserted.size());
+  if (fw_lines_.empty()) rebuild_fenwick();
 }
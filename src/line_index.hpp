@@ -1,18 +1,41 @@
 #pragma once
 #include <vector>
 #include <cstddef>
+#include <string_view>
 
+/*line starts of one block, relative to its first line; bytes = span up to the next block*/
 struct LineBlock {
-  size_t base_offset;
   std::vector<size_t> rel;
+  size_t bytes = 0;
 };
 
+/*
+  line starts of a gap buffer's text, in blocks of up to block_size lines.
+  two Fenwick trees over the blocks (line counts, byte spans) find a row's
+  or an offset's block in O(log n); an edit only re-collects the blocks it
+  touches, later blocks keep their relative offsets as they are.
+*/
 class LineIndex {
 public:
   std::vector<LineBlock> blocks;
   size_t block_size = 1024;
 
   void build_from_text(const std::vector<char>& buf, size_t gap_start, size_t gap_end);
-  size_t line_count() const;
+  size_t line_count() const { return lines_; }
   size_t line_start(size_t row) const;
+  /*text [pos, pos + removed) was replaced by inserted: drop, add and shift the affected line starts*/
+  void on_replace(size_t pos, size_t removed, std::string_view inserted);
+
+private:
+  size_t lines_ = 0;
+  size_t bytes_ = 0;
+  std::vector<size_t> fw_lines_; /* Fenwick trees, 1-based over blocks */
+  std::vector<size_t> fw_bytes_;
+
+  void rebuild_fenwick();
+  static void fw_add(std::vector<size_t>& fw, size_t i, size_t delta);
+  static size_t fw_prefix(const std::vector<size_t>& fw, size_t n);
+  /*largest k with prefix(k) <= target, clamped to a valid block index*/
+  size_t fw_find(const std::vector<size_t>& fw, size_t target) const;
+  void set_blocks(size_t b0, size_t b1, const std::vector<size_t>& starts, size_t region_end);
 };
@@ -1,14 +1,25 @@
 #include "terminal.hpp"
 #include "editor.hpp"
+#include <cstdio>
 #include <optional>
 #include <filesystem>
+#include <string>
 
  
 int main(int argc, char** argv) {
   std::optional<std::filesystem::path> path;
-  if (argc >= 2) path = std::filesystem::path(argv[1]);
+  // -R opens the file as a read-only view; options may come before or after it, "--" ends them
+  bool read_only = false, options = true;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (options && arg == "--") options = false;
+    else if (options && arg == "-R") read_only = true;
+    else if (options && arg.size() > 1 && arg[0] == '-') { std::fprintf(stderr, "mvim: unknown option %s\nusage: mvim [-R] [file]\n", argv[i]); return 2; }
+    else if (!path) path = std::filesystem::path(arg);
+    else { std::fprintf(stderr, "usage: mvim [-R] [file]\n"); return 2; }
+  }
   Terminal term;
-  Editor ed(path);
+  Editor ed(path, read_only);
   ed.run();
   return 0;
 }
@@ -0,0 +1,42 @@
+#pragma once
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <string_view>
+#include "posix_fd.hpp"
+
+/*
+  read-only private mapping of a whole file, unmapped on destruction.
+  the mapping pins the inode, so saving through write-tmp-then-rename
+  leaves it intact; truncating the file in place from outside does not.
+*/
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { if (data_) ::munmap(const_cast<char*>(data_), size_); }
+
+  /*false when the file cannot be opened or mapped; an empty file maps to an empty view*/
+  bool open(const char* path) {
+    UniqueFd fd(::open(path, O_RDONLY));
+    if (!fd.valid()) return false;
+    struct stat st{};
+    if (::fstat(fd.get(), &st) != 0) return false;
+    size_t n = static_cast<size_t>(st.st_size);
+    if (n == 0) return true;
+    void* mem = ::mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (mem == MAP_FAILED) return false;
+    data_ = static_cast<const char*>(mem);
+    size_ = n;
+    return true;
+  }
+  void advise(int advice) const { if (data_) (void)::madvise(const_cast<char*>(data_), size_, advice); }
+  std::string_view view() const { return {data_, size_}; }
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,91 @@
+#include "mapped_view_text_buffer_core.hpp"
+#include "newline_scan.hpp"
+#include <algorithm>
+#include <cstring>
+
+MappedViewTextBufferCore::MappedViewTextBufferCore(size_t checkpoint_lines) : k_(std::max<size_t>(checkpoint_lines, 1)), cps_{0} {}
+
+void MappedViewTextBufferCore::adopt_mapping(std::shared_ptr<const MappedFile> file) {
+  file_ = std::move(file);
+  text_ = file_->view();
+  cps_.assign(1, 0);
+  newlines_ = 0;
+  scanned_ = 0;
+  complete_ = false;
+}
+
+void MappedViewTextBufferCore::append_mapped(std::string_view bytes, bool last) {
+  size_t base = scanned_;
+  for_each_newline(bytes.data(), bytes.size(), [&](size_t off) {
+    if (++newlines_ % k_ == 0) cps_.push_back(base + off + 1);
+  });
+  scanned_ += bytes.size();
+  complete_ = last;
+}
+
+int MappedViewTextBufferCore::line_count() const {
+  size_t n = complete_ ? newlines_ + 1 : newlines_;
+  return static_cast<int>(std::min<size_t>(n, INT_MAX));
+}
+
+size_t MappedViewTextBufferCore::line_start(size_t r) const {
+  size_t pos = cps_[r / k_];
+  for (size_t j = r % k_; j > 0; --j) pos = next_start(pos);
+  return pos;
+}
+
+size_t MappedViewTextBufferCore::find_newline(size_t from) const {
+  if (from >= scanned_) return scanned_;
+  const void* q = std::memchr(text_.data() + from, '\n', scanned_ - from);
+  return q ? static_cast<size_t>(static_cast<const char*>(q) - text_.data()) : scanned_;
+}
+
+size_t MappedViewTextBufferCore::next_start(size_t start) const {
+  size_t nl = find_newline(start);
+  return nl < scanned_ ? nl + 1 : scanned_;
+}
+
+size_t MappedViewTextBufferCore::prev_start(size_t start) const {
+  if (start < 2) return 0;
+  // past the '\n' at start - 1, which ends the previous line itself
+  size_t q = text_.rfind('\n', start - 2);
+  return q == std::string_view::npos ? 0 : q + 1;
+}
+
+size_t MappedViewTextBufferCore::line_end(size_t start) const {
+  size_t end = find_newline(start);
+  if (end > start && text_[end - 1] == '\r') --end;
+  return end;
+}
+
+std::string_view MappedViewTextBufferCore::get_line_view(int r, std::string&) const {
+  if (r < 0 || r >= line_count()) return {};
+  size_t start = line_start(static_cast<size_t>(r));
+  return text_.substr(start, line_end(start) - start);
+}
+
+size_t MappedViewTextBufferCore::row_to_byte(int r) const {
+  if (r <= 0) return 0;
+  if (r >= line_count()) return byte_count();
+  return line_start(static_cast<size_t>(r));
+}
+
+std::string MappedViewTextBufferCore::line_slice(int r, size_t col, size_t len) const {
+  std::string scratch;
+  std::string_view v = get_line_view(r, scratch);
+  return col < v.size() ? std::string(v.substr(col, len)) : std::string();
+}
+
+std::pair<int, size_t> MappedViewTextBufferCore::byte_to_row(size_t off) const {
+  size_t i = static_cast<size_t>(std::upper_bound(cps_.begin(), cps_.end(), off) - cps_.begin()) - 1;
+  size_t row = i * k_, pos = cps_[i];
+  size_t last = static_cast<size_t>(line_count()) - 1;
+  for (;;) {
+    size_t end = line_end(pos);
+    if (off <= end || row >= last) return {static_cast<int>(row), std::min(off - pos, end - pos)};
+    size_t next = next_start(pos);
+    if (off < next) return {static_cast<int>(row), end - pos};
+    pos = next;
+    ++row;
+  }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "i_text_buffer_core.hpp"
+#include "config.hpp"
+#include "mapped_file.hpp"
+
+/*
+  read-only view of a mapped file, for files too big to hold as lines or
+  pieces. only the start of every K-th line is kept; a line is found by
+  scanning forward from the checkpoint before it, and every read returns
+  a view into the mapping. memory is O(file size / K). a line leaves out a
+  '\r' before its '\n' or at the end of the file, but offsets (byte_count,
+  row_to_byte, byte_to_row) are positions in the file.
+  the index grows a batch at a time while the file streams in, see
+  ProgressiveLoad. set_backend never moves a document here, and the
+  editing calls of the core interface leave the text as it is: the
+  editor refuses edits to view documents before they get this far.
+*/
+class MappedViewTextBufferCore : public TextBufferCoreCRTP<MappedViewTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "view"; }
+  static constexpr bool read_only = true;
+
+  explicit MappedViewTextBufferCore(size_t checkpoint_lines = TB_VIEW_CHECKPOINT_LINES);
+
+  /*start over on file, with nothing of it indexed yet*/
+  void adopt_mapping(std::shared_ptr<const MappedFile> file);
+  /*index bytes, the next part of the mapping: whole lines, or with last the rest of the file*/
+  void append_mapped(std::string_view bytes, bool last);
+  bool maps(const MappedFile* file) const { return file && file_.get() == file; }
+  size_t checkpoints() const { return cps_.size(); }
+
+  int line_count() const;
+  std::string get_line(int r) const { std::string scratch; return std::string(get_line_view(r, scratch)); }
+  std::string_view get_line_view(int r, std::string& scratch) const;
+  size_t line_length(int r) const { std::string scratch; return get_line_view(r, scratch).size(); }
+  std::string line_slice(int r, size_t col, size_t len) const;
+  /*file bytes indexed so far, '\r's included*/
+  size_t byte_count() const { return complete_ ? text_.size() : scanned_; }
+  /*rows outside [0, line_count()) clamp to the start / the indexed end*/
+  size_t row_to_byte(int r) const;
+  std::pair<int, size_t> byte_to_row(size_t off) const;
+
+  /*walks the mapping line by line from wherever it was put*/
+  class LineCursor {
+  public:
+    LineCursor(const MappedViewTextBufferCore& core, int r) : core_(&core) { seek(r); }
+    bool valid() const { return row_ >= 0 && row_ < core_->line_count(); }
+    int row() const { return row_; }
+    void seek(int r) { row_ = r; start_ = valid() ? core_->line_start(static_cast<size_t>(r)) : 0; }
+    void next() { if (valid()) start_ = core_->next_start(start_); ++row_; }
+    void prev() { --row_; if (valid()) start_ = core_->prev_start(start_); }
+    std::string_view view(std::string&) const { return core_->text_.substr(start_, core_->line_end(start_) - start_); }
+    size_t length() const { return core_->line_end(start_) - start_; }
+    std::string slice(size_t col, size_t len) const {
+      std::string scratch;
+      std::string_view v = view(scratch);
+      return col < v.size() ? std::string(v.substr(col, len)) : std::string();
+    }
+
+  private:
+    const MappedViewTextBufferCore* core_;
+    int row_ = 0;
+    size_t start_ = 0;
+  };
+  LineCursor line_cursor(int r) const { return LineCursor(*this, r); }
+
+  /*forward to CRTP impl; the edits are no-ops, see above*/
+  void do_init_from_lines(const std::vector<std::string>&) {}
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  size_t do_line_length(int r) const { return line_length(r); }
+  std::string do_line_slice(int r, size_t col, size_t len) const { return line_slice(r, col, len); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
+  void do_insert_line(size_t, const std::string&) {}
+  void do_insert_line(size_t, std::string_view) {}
+  void do_insert_lines(size_t, const std::vector<std::string>&) {}
+  void do_insert_lines(size_t, std::span<const std::string>) {}
+  void do_erase_line(size_t) {}
+  void do_erase_lines(size_t, size_t) {}
+  void do_replace_line(size_t, const std::string&) {}
+  void do_replace_line(size_t, std::string_view) {}
+  void do_insert_text(size_t, size_t, std::string_view) {}
+  void do_erase_text(size_t, size_t, size_t) {}
+  void do_split_line(size_t, size_t) {}
+  void do_join_lines(size_t) {}
+  size_t do_byte_count() const { return byte_count(); }
+  size_t do_row_to_byte(int r) const { return row_to_byte(r); }
+  std::pair<int, size_t> do_byte_to_row(size_t off) const { return byte_to_row(off); }
+
+private:
+  /*r < line_count(): past that cps_ and the scanned bytes do not reach*/
+  size_t line_start(size_t r) const;
+  /*the first '\n' at or after from, or the end of what is indexed*/
+  size_t find_newline(size_t from) const;
+  /*end of the line starting at start, less a '\r' before its '\n' or the end of the file*/
+  size_t line_end(size_t start) const;
+  /*start of the line after / before the one starting at start*/
+  size_t next_start(size_t start) const;
+  size_t prev_start(size_t start) const;
+
+  std::shared_ptr<const MappedFile> file_;
+  std::string_view text_;
+  size_t k_;
+  std::vector<uint64_t> cps_; /* start of line i * k_ */
+  size_t newlines_ = 0;
+  size_t scanned_ = 0;
+  bool complete_ = true;
+};
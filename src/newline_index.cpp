@@ -0,0 +1,225 @@
+#include "newline_index.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "mapped_file.hpp"
+#include "newline_scan.hpp"
+#include "posix_fd.hpp"
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'V', 'I', 'M', 'N', 'L', 'X', '1'};
+/*bytes before the indexed end hashed into the header, to tell growth from a rewrite*/
+constexpr size_t TAIL = 4096;
+
+struct Header {
+  char magic[8];
+  uint64_t dev, ino, size, mtime_ns;
+  uint64_t newlines, crlf;
+  uint64_t tail_hash;
+  uint64_t path_bytes, checkpoints, delta_bytes;
+};
+
+uint64_t fnv1a(std::string_view s) {
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+  return h;
+}
+
+uint64_t tail_hash(std::string_view text, size_t end) {
+  size_t from = end > TAIL ? end - TAIL : 0;
+  return fnv1a(text.substr(from, end - from));
+}
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+std::string key_path(const std::filesystem::path& path) {
+  std::error_code ec;
+  auto abs = std::filesystem::absolute(path, ec);
+  return (ec ? path : abs).lexically_normal().string();
+}
+
+bool stat_key(const std::filesystem::path& path, struct stat& st) {
+  return ::stat(path.string().c_str(), &st) == 0;
+}
+
+uint64_t mtime_ns(const struct stat& st) {
+#if defined(__APPLE__)
+  const struct timespec& t = st.st_mtimespec;
+#else
+  const struct timespec& t = st.st_mtim;
+#endif
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ull + static_cast<uint64_t>(t.tv_nsec);
+}
+
+bool write_all(int fd, const void* p, size_t n) {
+  const char* c = static_cast<const char*>(p);
+  while (n > 0) {
+    ssize_t w = ::write(fd, c, n);
+    if (w < 0) return false;
+    c += w;
+    n -= static_cast<size_t>(w);
+  }
+  return true;
+}
+
+}  // namespace
+
+void NewlineIndex::push(uint64_t at) {
+  if (count_ % CHECKPOINT == 0) {
+    cps_.push_back({at, deltas_.size()});
+  } else {
+    for (uint64_t d = at - last_; ; d >>= 7) {
+      if (d < 0x80) { deltas_ += static_cast<char>(d); break; }
+      deltas_ += static_cast<char>((d & 0x7f) | 0x80);
+    }
+  }
+  last_ = at;
+  ++count_;
+}
+
+void NewlineIndex::extend(std::string_view text) {
+  if (text.size() <= bytes_) return;
+  const char* p = text.data();
+  size_t base = bytes_;
+  for_each_newline(p + base, text.size() - base, [&](size_t off) {
+    size_t at = base + off;
+    if (at > 0 && p[at - 1] == '\r') ++crlf_;
+    push(at);
+  });
+  bytes_ = text.size();
+}
+
+uint64_t NewlineIndex::newline(size_t k) const {
+  const Checkpoint& cp = cps_[k / CHECKPOINT];
+  uint64_t at = cp.offset;
+  size_t pos = cp.pos;
+  for (size_t j = k % CHECKPOINT; j > 0; --j) at += get_varint(pos);
+  return at;
+}
+
+bool NewlineIndex::validate(uint64_t size) {
+  if (crlf_ > count_) return false;
+  size_t pos = 0;
+  uint64_t at = 0;
+  for (size_t k = 0; k < count_; ++k) {
+    uint64_t next;
+    if (k % CHECKPOINT == 0) {
+      const Checkpoint& cp = cps_[k / CHECKPOINT];
+      if (cp.pos != pos || (k > 0 && cp.offset <= at) || cp.offset >= size) return false;
+      next = cp.offset;
+    } else {
+      uint64_t d;
+      if (!read_varint(pos, d) || d == 0 || d >= size - at) return false;
+      next = at + d;
+    }
+    at = next;
+  }
+  if (pos != deltas_.size()) return false;
+  last_ = at;
+  return true;
+}
+
+std::filesystem::path NewlineIndex::cache_path(const std::filesystem::path& path) {
+  std::filesystem::path dir;
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) dir = xdg;
+  else if (const char* home = std::getenv("HOME"); home && *home) dir = std::filesystem::path(home) / ".cache";
+  else return {};
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.nlx", static_cast<unsigned long long>(fnv1a(key_path(path))));
+  return dir / "mvim" / name;
+}
+
+bool NewlineIndex::load_cached(const std::filesystem::path& path, std::string_view text, bool& grew) {
+  grew = false;
+  auto cache = cache_path(path);
+  struct stat st{};
+  if (cache.empty() || !stat_key(path, st) || static_cast<size_t>(st.st_size) != text.size()) return false;
+  MappedFile file;
+  if (!file.open(cache.string().c_str())) return false;
+  std::string_view in = file.view();
+  Header h;
+  if (in.size() < sizeof(h)) return false;
+  std::memcpy(&h, in.data(), sizeof(h));
+  if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+  if (h.dev != static_cast<uint64_t>(st.st_dev) || h.ino != static_cast<uint64_t>(st.st_ino)) return false;
+  // same size: trust the mtime; bigger: an append keeps the bytes up to the old end
+  if (h.size > text.size()) return false;
+  if (h.size == text.size() ? h.mtime_ns != mtime_ns(st) : h.tail_hash != tail_hash(text, h.size)) return false;
+  std::string key = key_path(path);
+  size_t off = sizeof(h);
+  if (h.path_bytes != key.size() || in.size() - off < align8(key.size()) || in.substr(off, key.size()) != key) return false;
+  off += align8(key.size());
+  if (h.checkpoints != (h.newlines + CHECKPOINT - 1) / CHECKPOINT) return false;
+  if ((in.size() - off) / sizeof(Checkpoint) < h.checkpoints) return false;
+  size_t cps_bytes = h.checkpoints * sizeof(Checkpoint);
+  if (in.size() - off - cps_bytes < h.delta_bytes) return false;
+
+  cps_.resize(h.checkpoints);
+  std::memcpy(cps_.data(), in.data() + off, cps_bytes);
+  deltas_.assign(in.data() + off + cps_bytes, h.delta_bytes);
+  count_ = h.newlines;
+  crlf_ = h.crlf;
+  bytes_ = h.size;
+  if (!validate(h.size)) {
+    *this = NewlineIndex();
+    return false;
+  }
+  if (bytes_ < text.size()) {
+    // the tail hash only covers the last page: an edit further back moves the checkpoints' '\n's
+    for (const Checkpoint& cp : cps_) {
+      if (text[cp.offset] != '\n') {
+        *this = NewlineIndex();
+        return false;
+      }
+    }
+    extend(text);
+    grew = true;
+  }
+  return true;
+}
+
+bool NewlineIndex::store_cached(const std::filesystem::path& path, std::string_view text) const {
+  auto cache = cache_path(path);
+  struct stat st{};
+  if (cache.empty() || bytes_ != text.size() || !stat_key(path, st) || static_cast<size_t>(st.st_size) != bytes_) return false;
+  std::error_code ec;
+  std::filesystem::create_directories(cache.parent_path(), ec);
+  if (ec) return false;
+  std::string key = key_path(path);
+  Header h{};
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.dev = static_cast<uint64_t>(st.st_dev);
+  h.ino = static_cast<uint64_t>(st.st_ino);
+  h.size = bytes_;
+  h.mtime_ns = mtime_ns(st);
+  h.newlines = count_;
+  h.crlf = crlf_;
+  h.tail_hash = tail_hash(text, bytes_);
+  h.path_bytes = key.size();
+  h.checkpoints = cps_.size();
+  h.delta_bytes = deltas_.size();
+  key.resize(align8(key.size()), '\0');
+
+  // write then rename, so a reader never maps a half-written cache
+  std::filesystem::path tmp = cache;
+  tmp += ".tmp" + std::to_string(::getpid());
+  {
+    UniqueFd fd(::open(tmp.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (!fd.valid()) return false;
+    if (!write_all(fd.get(), &h, sizeof(h)) || !write_all(fd.get(), key.data(), key.size()) ||
+        !write_all(fd.get(), cps_.data(), cps_.size() * sizeof(Checkpoint)) ||
+        !write_all(fd.get(), deltas_.data(), deltas_.size())) {
+      fd.reset();
+      std::filesystem::remove(tmp, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp, cache, ec);
+  if (ec) { std::filesystem::remove(tmp, ec); return false; }
+  return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+  where a file's '\n's are: offsets stored as varint deltas, with the
+  absolute offset of every CHECKPOINT-th one, so finding any newline
+  decodes at most CHECKPOINT - 1 deltas. short-line logs take about a
+  byte per line.
+
+  the index can live in a sidecar cache under $XDG_CACHE_HOME/mvim
+  (~/.cache/mvim without it), one file per source path, named by a hash
+  of the absolute path. its header keys it by path, device, inode, size
+  and mtime, and stores a hash of the last bytes indexed. on reopen an
+  unchanged file skips the newline scan, and a file that only grew, with
+  its old tail intact and a '\n' still at every checkpoint, has only the
+  new bytes scanned. the cache file is the header, the path, the
+  checkpoints and the deltas, each 8-aligned. loading copies the
+  checkpoints and deltas out and decodes them all once: a cache whose
+  offsets are not increasing and inside the file is dropped.
+*/
+class NewlineIndex {
+public:
+  static constexpr size_t CHECKPOINT = 1024;
+
+  /*index text's bytes past the ones already indexed: the whole of it at first, the new tail after growth*/
+  void extend(std::string_view text);
+  size_t newlines() const { return count_; }
+  /*'\n's preceded by a '\r'*/
+  size_t crlf() const { return crlf_; }
+  size_t indexed_bytes() const { return bytes_; }
+  /*offset of the k-th '\n'*/
+  uint64_t newline(size_t k) const;
+  /*f(offset) for every '\n', in order*/
+  template <typename F>
+  void for_each(F&& f) const {
+    uint64_t at = 0;
+    size_t pos = 0;
+    for (size_t k = 0; k < count_; ++k) {
+      at = k % CHECKPOINT == 0 ? cps_[k / CHECKPOINT].offset : at + get_varint(pos);
+      f(at);
+    }
+  }
+
+  /*the sidecar for path; empty when there is no cache directory*/
+  static std::filesystem::path cache_path(const std::filesystem::path& path);
+  /*
+    load path's cached index, text being the file as mapped now. false
+    when there is none or it is stale; grew is set when the cache was of
+    a shorter version and has been extended, so it is worth storing again.
+  */
+  bool load_cached(const std::filesystem::path& path, std::string_view text, bool& grew);
+  /*write this index of text (all of it indexed) as path's sidecar; false when it cannot*/
+  bool store_cached(const std::filesystem::path& path, std::string_view text) const;
+
+private:
+  struct Checkpoint {
+    uint64_t offset; /* of newline k * CHECKPOINT */
+    uint64_t pos;    /* in deltas_ of the delta to the newline after it */
+  };
+  void push(uint64_t at);
+  /*decode every delta: each in bounds, offsets increasing and below size, checkpoints where they say*/
+  bool validate(uint64_t size);
+  uint64_t get_varint(size_t& pos) const {
+    uint64_t v = 0;
+    for (int shift = 0;; shift += 7) {
+      uint8_t b = static_cast<uint8_t>(deltas_[pos++]);
+      v |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+  }
+  /*get_varint for untrusted deltas: false when it runs off the end or past 64 bits*/
+  bool read_varint(size_t& pos, uint64_t& v) const {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < deltas_.size(); shift += 7) {
+      uint8_t b = static_cast<uint8_t>(deltas_[pos++]);
+      v |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  std::vector<Checkpoint> cps_;
+  std::string deltas_;
+  size_t count_ = 0;
+  size_t crlf_ = 0;
+  size_t bytes_ = 0;
+  uint64_t last_ = 0;
+};
@@ -0,0 +1,153 @@
+#include "newline_scan.hpp"
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define NEWLINE_SCAN_SIMD 1
+#endif
+
+namespace {
+
+/*positions [i, n); position 0 counts no crlf since its '\r' would be outside the range*/
+void count_tail(const char* p, size_t i, size_t n, NewlineCount& c) {
+  for (; i < n; ++i) {
+    if (p[i] != '\n') continue;
+    ++c.newlines;
+    if (i > 0 && p[i - 1] == '\r') ++c.crlf;
+  }
+}
+
+NewlineCount count_scalar(const char* p, size_t n) {
+  NewlineCount c;
+  count_tail(p, 0, n, c);
+  return c;
+}
+
+size_t find_scalar(const char* p, size_t n, size_t base, size_t* out) {
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) if (p[i] == '\n') out[k++] = base + i;
+  return k;
+}
+
+#ifdef NEWLINE_SCAN_SIMD
+/*
+  counting subtracts the 0xff compare masks into byte counters, summed with
+  psadbw before they can wrap. the '\r' compare runs on the same bytes
+  loaded one earlier, so a crlf is a lane where both masks are set.
+*/
+size_t sum_bytes(__m128i acc) {
+  __m128i s = _mm_sad_epu8(acc, _mm_setzero_si128());
+  return static_cast<size_t>(_mm_cvtsi128_si32(s)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+NewlineCount count_sse2(const char* p, size_t n) {
+  NewlineCount c;
+  if (n == 0) return c;
+  const __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+  count_tail(p, 0, 1, c);
+  size_t i = 1;
+  while (i + 16 <= n) {
+    __m128i an = _mm_setzero_si128(), ac = _mm_setzero_si128();
+    for (int r = 0; r < 255 && i + 16 <= n; ++r, i += 16) {
+      __m128i is_nl = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), nl);
+      __m128i after_cr = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i - 1)), cr);
+      an = _mm_sub_epi8(an, is_nl);
+      ac = _mm_sub_epi8(ac, _mm_and_si128(is_nl, after_cr));
+    }
+    c.newlines += sum_bytes(an);
+    c.crlf += sum_bytes(ac);
+  }
+  count_tail(p, i, n, c);
+  return c;
+}
+
+size_t find_sse2(const char* p, size_t n, size_t base, size_t* out) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t k = 0, i = 0;
+  for (; i + 16 <= n; i += 16) {
+    unsigned m = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), nl)));
+    for (; m; m &= m - 1) out[k++] = base + i + static_cast<size_t>(__builtin_ctz(m));
+  }
+  return k + find_scalar(p + i, n - i, base + i, out + k);
+}
+
+__attribute__((target("avx2"))) size_t sum_bytes_avx2(__m256i acc) {
+  __m256i s = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+  __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+  return static_cast<size_t>(_mm_cvtsi128_si32(h)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(h, 8)));
+}
+
+__attribute__((target("avx2"))) NewlineCount count_avx2(const char* p, size_t n) {
+  NewlineCount c;
+  if (n == 0) return c;
+  const __m256i nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+  count_tail(p, 0, 1, c);
+  size_t i = 1;
+  while (i + 32 <= n) {
+    __m256i an = _mm256_setzero_si256(), ac = _mm256_setzero_si256();
+    for (int r = 0; r < 255 && i + 32 <= n; ++r, i += 32) {
+      __m256i is_nl = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), nl);
+      __m256i after_cr = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i - 1)), cr);
+      an = _mm256_sub_epi8(an, is_nl);
+      ac = _mm256_sub_epi8(ac, _mm256_and_si256(is_nl, after_cr));
+    }
+    c.newlines += sum_bytes_avx2(an);
+    c.crlf += sum_bytes_avx2(ac);
+  }
+  count_tail(p, i, n, c);
+  return c;
+}
+
+__attribute__((target("avx2"))) size_t find_avx2(const char* p, size_t n, size_t base, size_t* out) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t k = 0, i = 0;
+  for (; i + 32 <= n; i += 32) {
+    uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), nl)));
+    for (; m; m &= m - 1) out[k++] = base + i + static_cast<size_t>(__builtin_ctz(m));
+  }
+  return k + find_sse2(p + i, n - i, base + i, out + k);
+}
+#endif
+
+struct Kernel {
+  const char* name;
+  NewlineCount (*count)(const char*, size_t);
+  size_t (*find)(const char*, size_t, size_t, size_t*);
+};
+
+constexpr Kernel SCALAR{"scalar", count_scalar, find_scalar};
+#ifdef NEWLINE_SCAN_SIMD
+constexpr Kernel SSE2{"sse2", count_sse2, find_sse2};
+constexpr Kernel AVX2{"avx2", count_avx2, find_avx2};
+#endif
+
+const Kernel* best_kernel() {
+#ifdef NEWLINE_SCAN_SIMD
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? &AVX2 : &SSE2;
+#else
+  return &SCALAR;
+#endif
+}
+
+const Kernel*& active() {
+  static const Kernel* k = best_kernel();
+  return k;
+}
+
+}  // namespace
+
+NewlineCount count_newlines(const char* p, size_t n) { return active()->count(p, n); }
+
+size_t find_newlines(const char* p, size_t n, size_t base, size_t* out) { return active()->find(p, n, base, out); }
+
+const char* newline_scan_kernel() { return active()->name; }
+
+bool use_newline_scan_kernel(std::string_view name) {
+  if (name == SCALAR.name) { active() = &SCALAR; return true; }
+#ifdef NEWLINE_SCAN_SIMD
+  if (name == SSE2.name) { active() = &SSE2; return true; }
+  if (name == AVX2.name && __builtin_cpu_supports("avx2")) { active() = &AVX2; return true; }
+#endif
+  return false;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+/*
+  newline scanning for the file readers. on x86 the kernels use SSE2, or
+  AVX2 when the cpu has it (picked once at first use); other targets get
+  a scalar loop. the vector kernels test 16 or 32 bytes per compare, so
+  short lines cost no call per line the way a memchr loop does.
+*/
+struct NewlineCount {
+  size_t newlines = 0;
+  /*'\n's preceded by a '\r' inside the same range*/
+  size_t crlf = 0;
+};
+
+NewlineCount count_newlines(const char* p, size_t n);
+/*base + offset of every '\n' in [p, p + n), in order, into out; returns how many*/
+size_t find_newlines(const char* p, size_t n, size_t base, size_t* out);
+/*"avx2", "sse2" or "scalar"*/
+const char* newline_scan_kernel();
+/*tests and benches: switch kernels by name; false when this cpu lacks it*/
+bool use_newline_scan_kernel(std::string_view name);
+
+/*f(offset) for each '\n' in [p, p + n), found a window at a time*/
+template <typename F>
+void for_each_newline(const char* p, size_t n, F&& f) {
+  constexpr size_t WINDOW = 4096;
+  size_t pos[WINDOW];
+  for (size_t s = 0; s < n; s += WINDOW) {
+    size_t len = n - s < WINDOW ? n - s : WINDOW;
+    size_t k = find_newlines(p + s, len, s, pos);
+    for (size_t i = 0; i < k; ++i) f(pos[i]);
+  }
+}
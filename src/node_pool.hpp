@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+  slab allocator for tree nodes. nodes are carved out of fixed-size slabs and
+  recycled through a free list instead of going back to malloc; released nodes
+  stay constructed, so the owner decides what state to reset. destroying or
+  clearing the pool frees whole slabs at once, no tree walk needed.
+  not thread-safe: one pool per buffer core.
+*/
+template <typename T, size_t SlabNodes = 256>
+class NodePool {
+public:
+  NodePool() = default;
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+  NodePool(NodePool&& o) noexcept { swap(o); }
+  NodePool& operator=(NodePool&& o) noexcept { if (this != &o) { clear(); swap(o); } return *this; }
+
+  T* acquire() {
+    if (!free_.empty()) { T* p = free_.back(); free_.pop_back(); return p; }
+    if (slabs_.empty() || used_ == SlabNodes) {
+      slabs_.push_back(std::make_unique<T[]>(SlabNodes));
+      used_ = 0;
+    }
+    return &slabs_.back()[used_++];
+  }
+  void release(T* p) { free_.push_back(p); }
+  void clear() { slabs_.clear(); free_.clear(); used_ = 0; }
+
+  size_t slab_count() const { return slabs_.size(); }
+  size_t live_count() const {
+    if (slabs_.empty()) return 0;
+    return (slabs_.size() - 1) * SlabNodes + used_ - free_.size();
+  }
+
+private:
+  void swap(NodePool& o) noexcept {
+    slabs_.swap(o.slabs_);
+    free_.swap(o.free_);
+    std::swap(used_, o.used_);
+  }
+
+  std::vector<std::unique_ptr<T[]>> slabs_;
+  std::vector<T*> free_;
+  size_t used_ = 0;
+};
@@ -0,0 +1,92 @@
+#include "packed_lines.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "utf8.hpp"
+
+void PackedLines::check_room(size_t add) const {
+  if (add > std::numeric_limits<uint32_t>::max() - text_.size()) throw std::length_error("PackedLines: block exceeds 4GB");
+}
+
+void PackedLines::shift_ends(size_t from, size_t delta, bool grow) {
+  if (delta == 0) return;
+  uint32_t d = static_cast<uint32_t>(delta);
+  for (size_t j = from; j < ends_.size(); ++j) ends_[j] = grow ? ends_[j] + d : ends_[j] - d;
+}
+
+void PackedLines::assign(std::span<const std::string> lines) {
+  size_t total = 0;
+  for (const auto& s : lines) total += s.size();
+  clear();
+  check_room(total);
+  reserve(lines.size(), total);
+  for (const auto& s : lines) {
+    text_.append(s);
+    ends_.push_back(static_cast<uint32_t>(text_.size()));
+  }
+}
+
+void PackedLines::assign(const LineArena& arena, size_t b, size_t e) {
+  std::string_view text = arena.text(b, e);
+  clear();
+  check_room(text.size());
+  reserve(e - b, text.size());
+  text_.assign(text);
+  size_t base = arena.start(b);
+  for (size_t i = b; i < e; ++i) ends_.push_back(static_cast<uint32_t>(arena.end(i) - base));
+}
+
+void PackedLines::push_back(std::string_view s) {
+  check_room(s.size());
+  text_.append(s);
+  ends_.push_back(static_cast<uint32_t>(text_.size()));
+}
+
+void PackedLines::insert(size_t pos, std::string_view s) {
+  if (pos == size()) { push_back(s); return; }
+  check_room(s.size());
+  size_t at = start(pos);
+  text_.insert(at, s);
+  shift_ends(pos, s.size(), true);
+  ends_.insert(ends_.begin() + static_cast<std::ptrdiff_t>(pos), static_cast<uint32_t>(at + s.size()));
+}
+
+void PackedLines::insert(size_t pos, const PackedLines& o, size_t b, size_t e) {
+  if (b >= e) return;
+  size_t ob = o.start(b);
+  size_t len = o.ends_[e - 1] - ob;
+  check_room(len);
+  size_t at = start(pos);
+  text_.insert(at, o.text_, ob, len);
+  shift_ends(pos, len, true);
+  ends_.insert(ends_.begin() + static_cast<std::ptrdiff_t>(pos), o.ends_.begin() + static_cast<std::ptrdiff_t>(b),
+               o.ends_.begin() + static_cast<std::ptrdiff_t>(e));
+  // rebase the copied offsets from o's block onto ours
+  for (size_t j = pos; j < pos + (e - b); ++j) ends_[j] = static_cast<uint32_t>(ends_[j] - ob + at);
+}
+
+void PackedLines::erase(size_t b, size_t e) {
+  if (b >= e) return;
+  size_t bb = start(b);
+  size_t len = ends_[e - 1] - bb;
+  text_.erase(bb, len);
+  ends_.erase(ends_.begin() + static_cast<std::ptrdiff_t>(b), ends_.begin() + static_cast<std::ptrdiff_t>(e));
+  shift_ends(b, len, false);
+}
+
+void PackedLines::replace(size_t i, std::string_view s) {
+  size_t b = start(i);
+  size_t old = ends_[i] - b;
+  if (s.size() > old) check_room(s.size() - old);
+  text_.replace(b, old, s);
+  if (s.size() >= old) shift_ends(i, s.size() - old, true);
+  else shift_ends(i, old - s.size(), false);
+}
+
+size_t PackedLines::codepoints() const { return utf8_length(text_); }
+
+size_t PackedLines::max_line() const {
+  size_t m = 0;
+  for (size_t i = 0; i < ends_.size(); ++i) m = std::max(m, ends_[i] - start(i));
+  return m;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include "line_arena.hpp"
+
+/*
+  a run of lines packed into one char block plus their end offsets: two
+  allocations however many lines, and reading lines in order streams
+  through memory. line i is text[end(i - 1), end(i)).
+  offsets are 32-bit, so one block holds at most 4GB of text.
+*/
+class PackedLines {
+public:
+  size_t size() const { return ends_.size(); }
+  bool empty() const { return ends_.empty(); }
+  size_t bytes() const { return text_.size(); }
+  /*heap bytes held, including spare capacity*/
+  size_t capacity_bytes() const { return text_.capacity() + ends_.capacity() * sizeof(uint32_t); }
+  /*offset of line i inside the block*/
+  size_t offset(size_t i) const { return start(i); }
+  /*UTF-8 codepoints in the block and the longest line in bytes, both O(bytes)*/
+  size_t codepoints() const;
+  size_t max_line() const;
+  std::string_view operator[](size_t i) const {
+    size_t b = start(i);
+    return std::string_view(text_.data() + b, ends_[i] - b);
+  }
+
+  void clear() { text_.clear(); ends_.clear(); }
+  void reserve(size_t lines, size_t bytes) { ends_.reserve(lines); text_.reserve(bytes); }
+  void assign(std::span<const std::string> lines);
+  /*lines [b, e) of block: one copy of their text, the ends rebased*/
+  void assign(const LineArena& arena, size_t b, size_t e);
+  void push_back(std::string_view s);
+  void insert(size_t pos, std::string_view s);
+  /*insert lines [b, e) of o before pos; o must not be *this*/
+  void insert(size_t pos, const PackedLines& o, size_t b, size_t e);
+  void append(const PackedLines& o, size_t b, size_t e) { insert(size(), o, b, e); }
+  void append(const PackedLines& o) { insert(size(), o, 0, o.size()); }
+  void erase(size_t b, size_t e);
+  void erase(size_t i) { erase(i, i + 1); }
+  void replace(size_t i, std::string_view s);
+  void swap(PackedLines& o) noexcept { text_.swap(o.text_); ends_.swap(o.ends_); }
+
+private:
+  size_t start(size_t i) const { return i == 0 ? 0 : ends_[i - 1]; }
+  void check_room(size_t add) const;
+  void shift_ends(size_t from, size_t delta, bool grow);
+
+  std::string text_;
+  std::vector<uint32_t> ends_;
+};
@@ -0,0 +1,365 @@
+#include "persistent_rope_text_buffer_core.hpp"
+#include <algorithm>
+#include <iterator>
+
+PersistentRopeTextBufferCore::Node* PersistentRopeTextBufferCore::mut(NodePtr& n) {
+  if (n.use_count() != 1) n = std::make_shared<Node>(*n);
+  return n.get();
+}
+
+std::pair<PersistentRopeTextBufferCore::NodePtr, PersistentRopeTextBufferCore::NodePtr>
+PersistentRopeTextBufferCore::take_children(NodePtr n) {
+  if (n.use_count() == 1) return {std::move(n->left), std::move(n->right)};
+  return {n->left, n->right};
+}
+
+void PersistentRopeTextBufferCore::recalc(Node* n) {
+  n->lines_count = count_lines(n->left) + count_lines(n->right) + n->lines.size();
+  n->height = 1 + std::max(node_height(n->left), node_height(n->right));
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::rotate_left(NodePtr x) {
+  Node* xm = mut(x);
+  NodePtr y = std::move(xm->right);
+  Node* ym = mut(y);
+  xm->right = std::move(ym->left);
+  recalc(xm);
+  ym->left = std::move(x);
+  recalc(ym);
+  return y;
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::rotate_right(NodePtr y) {
+  Node* ym = mut(y);
+  NodePtr x = std::move(ym->left);
+  Node* xm = mut(x);
+  ym->left = std::move(xm->right);
+  recalc(ym);
+  xm->right = std::move(y);
+  recalc(xm);
+  return x;
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::balance(NodePtr n) {
+  Node* m = mut(n);
+  recalc(m);
+  int bf = balance_factor(m);
+  if (bf > 1) {
+    if (balance_factor(m->left.get()) < 0) m->left = rotate_left(std::move(m->left));
+    return rotate_right(std::move(n));
+  } else if (bf < -1) {
+    if (balance_factor(m->right.get()) > 0) m->right = rotate_right(std::move(m->right));
+    return rotate_left(std::move(n));
+  }
+  return n;
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::make_leaf(std::vector<std::string>&& lines) {
+  auto n = std::make_shared<Node>();
+  n->lines = std::move(lines);
+  recalc(n.get());
+  return n;
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::make_internal(NodePtr a, NodePtr b) {
+  auto p = std::make_shared<Node>();
+  p->left = std::move(a);
+  p->right = std::move(b);
+  recalc(p.get());
+  return p;
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::join(NodePtr a, NodePtr b) {
+  if (!a) return b;
+  if (!b) return a;
+  int ha = node_height(a);
+  int hb = node_height(b);
+  if (ha > hb + 1) {
+    Node* am = mut(a);
+    am->right = join(std::move(am->right), std::move(b));
+    return balance(std::move(a));
+  }
+  if (hb > ha + 1) {
+    Node* bm = mut(b);
+    bm->left = join(std::move(a), std::move(bm->left));
+    return balance(std::move(b));
+  }
+  return make_internal(std::move(a), std::move(b));
+}
+
+PersistentRopeTextBufferCore::Node* PersistentRopeTextBufferCore::mut_rightmost_leaf(NodePtr& n) {
+  Node* m = mut(n);
+  while (!is_leaf(m)) m = mut(m->right);
+  return m;
+}
+
+PersistentRopeTextBufferCore::Node* PersistentRopeTextBufferCore::mut_leftmost_leaf(NodePtr& n) {
+  Node* m = mut(n);
+  while (!is_leaf(m)) m = mut(m->left);
+  return m;
+}
+
+void PersistentRopeTextBufferCore::fix_left_spine(Node* n) {
+  if (!is_leaf(n)) fix_left_spine(n->left.get());
+  recalc(n);
+}
+
+void PersistentRopeTextBufferCore::fix_right_spine(Node* n) {
+  if (!is_leaf(n)) fix_right_spine(n->right.get());
+  recalc(n);
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::pop_leftmost(NodePtr n, std::vector<std::string>& out) {
+  if (is_leaf(n.get())) {
+    if (n.use_count() == 1) out = std::move(n->lines); else out = n->lines;
+    return nullptr;
+  }
+  Node* m = mut(n);
+  m->left = pop_leftmost(std::move(m->left), out);
+  if (!m->left) return std::move(m->right);
+  return balance(std::move(n));
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::concat(NodePtr a, NodePtr b) {
+  if (!a) return b;
+  if (!b) return a;
+  const Node* ra = a.get(); while (!is_leaf(ra)) ra = ra->right.get();
+  const Node* rb = b.get(); while (!is_leaf(rb)) rb = rb->left.get();
+  size_t sa = ra->lines.size();
+  size_t sb = rb->lines.size();
+  if (sa >= LEAF_MIN_LINES && sb >= LEAF_MIN_LINES) return join(std::move(a), std::move(b));
+  if (sa + sb <= LEAF_MAX_LINES) {
+    std::vector<std::string> moved;
+    b = pop_leftmost(std::move(b), moved);
+    Node* la = mut_rightmost_leaf(a);
+    la->lines.insert(la->lines.end(), std::make_move_iterator(moved.begin()), std::make_move_iterator(moved.end()));
+    fix_right_spine(a.get());
+    return join(std::move(a), std::move(b));
+  }
+  Node* la = mut_rightmost_leaf(a);
+  Node* lb = mut_leftmost_leaf(b);
+  size_t keep = (sa + sb) / 2;
+  if (sa > keep) {
+    lb->lines.insert(lb->lines.begin(), std::make_move_iterator(la->lines.begin() + static_cast<std::ptrdiff_t>(keep)),
+                     std::make_move_iterator(la->lines.end()));
+    la->lines.resize(keep);
+  } else {
+    size_t take = keep - sa;
+    la->lines.insert(la->lines.end(), std::make_move_iterator(lb->lines.begin()),
+                     std::make_move_iterator(lb->lines.begin() + static_cast<std::ptrdiff_t>(take)));
+    lb->lines.erase(lb->lines.begin(), lb->lines.begin() + static_cast<std::ptrdiff_t>(take));
+  }
+  fix_right_spine(a.get());
+  fix_left_spine(b.get());
+  return join(std::move(a), std::move(b));
+}
+
+std::pair<PersistentRopeTextBufferCore::NodePtr, PersistentRopeTextBufferCore::NodePtr>
+PersistentRopeTextBufferCore::split(NodePtr n, size_t k) {
+  if (!n) return {nullptr, nullptr};
+  if (k == 0) return {nullptr, std::move(n)};
+  if (k >= n->lines_count) return {std::move(n), nullptr};
+  if (is_leaf(n.get())) {
+    Node* m = mut(n);
+    std::vector<std::string> right_lines(std::make_move_iterator(m->lines.begin() + static_cast<std::ptrdiff_t>(k)),
+                                         std::make_move_iterator(m->lines.end()));
+    m->lines.resize(k);
+    recalc(m);
+    return {std::move(n), make_leaf(std::move(right_lines))};
+  }
+  size_t left_count = count_lines(n->left);
+  auto [l, r] = take_children(std::move(n));
+  if (k < left_count) {
+    auto [a, b] = split(std::move(l), k);
+    return {std::move(a), join(std::move(b), std::move(r))};
+  }
+  if (k == left_count) return {std::move(l), std::move(r)};
+  auto [a, b] = split(std::move(r), k - left_count);
+  return {join(std::move(l), std::move(a)), std::move(b)};
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::insert_at(NodePtr n, size_t row, std::string&& s) {
+  Node* m = mut(n);
+  if (is_leaf(m)) {
+    m->lines.insert(m->lines.begin() + static_cast<std::ptrdiff_t>(row), std::move(s));
+    if (m->lines.size() <= LEAF_MAX_LINES) { recalc(m); return n; }
+    size_t mid = m->lines.size() / 2;
+    std::vector<std::string> right_lines(std::make_move_iterator(m->lines.begin() + static_cast<std::ptrdiff_t>(mid)),
+                                         std::make_move_iterator(m->lines.end()));
+    m->lines.resize(mid);
+    recalc(m);
+    return make_internal(std::move(n), make_leaf(std::move(right_lines)));
+  }
+  size_t lc = count_lines(m->left);
+  if (row < lc) m->left = insert_at(std::move(m->left), row, std::move(s));
+  else m->right = insert_at(std::move(m->right), row - lc, std::move(s));
+  return balance(std::move(n));
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::erase_at(NodePtr n, size_t row) {
+  Node* m = mut(n);
+  if (is_leaf(m)) {
+    m->lines.erase(m->lines.begin() + static_cast<std::ptrdiff_t>(row));
+    if (m->lines.empty()) return nullptr;
+    recalc(m);
+    return n;
+  }
+  size_t lc = count_lines(m->left);
+  if (row < lc) {
+    m->left = erase_at(std::move(m->left), row);
+    if (!m->left) return std::move(m->right);
+  } else {
+    m->right = erase_at(std::move(m->right), row - lc);
+    if (!m->right) return std::move(m->left);
+  }
+  bool left_small = is_leaf(m->left.get()) && m->left->lines.size() < LEAF_MIN_LINES;
+  bool right_small = is_leaf(m->right.get()) && m->right->lines.size() < LEAF_MIN_LINES;
+  if (left_small || right_small) return concat(std::move(m->left), std::move(m->right));
+  return balance(std::move(n));
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::build_balanced(std::span<const std::string> lines) {
+  if (lines.empty()) return nullptr;
+  if (lines.size() <= LEAF_MAX_LINES) return make_leaf(std::vector<std::string>(lines.begin(), lines.end()));
+  size_t mid = lines.size() / 2;
+  return join(build_balanced(lines.first(mid)), build_balanced(lines.subspan(mid)));
+}
+
+PersistentRopeTextBufferCore::NodePtr PersistentRopeTextBufferCore::build_balanced_moved(std::span<std::string> lines) {
+  if (lines.empty()) return nullptr;
+  if (lines.size() <= LEAF_MAX_LINES) return make_leaf(std::vector<std::string>(std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end())));
+  size_t mid = lines.size() / 2;
+  return join(build_balanced_moved(lines.first(mid)), build_balanced_moved(lines.subspan(mid)));
+}
+
+void PersistentRopeTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
+  root_ = build_balanced(lines);
+}
+
+void PersistentRopeTextBufferCore::adopt_lines(std::vector<std::string>&& lines) {
+  root_ = build_balanced_moved(lines);
+  std::vector<std::string>().swap(lines);
+}
+
+int PersistentRopeTextBufferCore::line_count() const { return static_cast<int>(count_lines(root_)); }
+
+std::string PersistentRopeTextBufferCore::get_line(int r) const {
+  std::string scratch;
+  return std::string(get_line_view(r, scratch));
+}
+
+std::string_view PersistentRopeTextBufferCore::get_line_view(int r, std::string&) const {
+  if (r < 0 || static_cast<size_t>(r) >= count_lines(root_)) return {};
+  const Node* cur = root_.get();
+  size_t idx = static_cast<size_t>(r);
+  while (!is_leaf(cur)) {
+    size_t lc = count_lines(cur->left);
+    if (idx < lc) cur = cur->left.get();
+    else { idx -= lc; cur = cur->right.get(); }
+  }
+  return cur->lines[idx];
+}
+
+void PersistentRopeTextBufferCore::insert_line(size_t row, const std::string& s) { insert_line(row, std::string_view(s)); }
+
+void PersistentRopeTextBufferCore::insert_line(size_t row, std::string_view s) {
+  if (!root_) { root_ = make_leaf(std::vector<std::string>{std::string(s)}); return; }
+  size_t L = count_lines(root_); if (row > L) row = L;
+  root_ = insert_at(std::move(root_), row, std::string(s));
+}
+
+void PersistentRopeTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
+  insert_lines(row, std::span<const std::string>(ss.begin(), ss.end()));
+}
+
+void PersistentRopeTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  if (ss.empty()) return;
+  size_t L = count_lines(root_); if (row > L) row = L;
+  auto [A, B] = split(std::move(root_), row);
+  root_ = concat(concat(std::move(A), build_balanced(ss)), std::move(B));
+}
+
+void PersistentRopeTextBufferCore::erase_line(size_t row) {
+  if (row >= count_lines(root_)) return;
+  root_ = erase_at(std::move(root_), row);
+}
+
+void PersistentRopeTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
+  size_t L = count_lines(root_);
+  if (end_row < start_row) end_row = start_row;
+  if (start_row >= L) return;
+  if (end_row > L) end_row = L;
+  auto [A, B] = split(std::move(root_), start_row);
+  auto [M, C] = split(std::move(B), end_row - start_row);
+  root_ = concat(std::move(A), std::move(C));
+}
+
+void PersistentRopeTextBufferCore::replace_line(size_t row, const std::string& s) { replace_line(row, std::string_view(s)); }
+
+std::string& PersistentRopeTextBufferCore::line_ref(size_t row) {
+  Node* cur = mut(root_);
+  size_t idx = row;
+  while (!is_leaf(cur)) {
+    size_t lc = count_lines(cur->left);
+    if (idx < lc) cur = mut(cur->left);
+    else { idx -= lc; cur = mut(cur->right); }
+  }
+  return cur->lines[idx];
+}
+
+void PersistentRopeTextBufferCore::replace_line(size_t row, std::string_view s) {
+  if (row >= count_lines(root_)) return;
+  line_ref(row).assign(s.data(), s.size());
+}
+
+/*the line is edited in its leaf, only the touched bytes of it move*/
+void PersistentRopeTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= count_lines(root_) || s.empty()) return;
+  std::string& l = line_ref(row);
+  l.insert(std::min(col, l.size()), s);
+}
+
+void PersistentRopeTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= count_lines(root_)) return;
+  std::string& l = line_ref(row);
+  if (col < l.size()) l.erase(col, len);
+}
+
+void PersistentRopeTextBufferCore::split_line(size_t row, size_t col) {
+  if (row >= count_lines(root_)) return;
+  std::string& l = line_ref(row);
+  col = std::min(col, l.size());
+  std::string tail(l, col);
+  l.erase(col);
+  insert_line(row + 1, std::string_view(tail));
+}
+
+void PersistentRopeTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= count_lines(root_)) return;
+  std::string next = get_line(static_cast<int>(row + 1));
+  line_ref(row) += next;
+  erase_line(row + 1);
+}
+
+bool PersistentRopeTextBufferCore::check_invariants(std::string* why) const {
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  bool ok = true;
+  auto walk = [&](auto&& self, const Node* n) -> void {
+    if (!ok) return;
+    if (is_leaf(n)) {
+      if (n->lines.empty() || n->lines.size() > LEAF_MAX_LINES) ok = fail("leaf size out of bounds");
+      else if (n->lines_count != n->lines.size() || n->height != 1) ok = fail("bad leaf aggregates");
+      return;
+    }
+    if (!n->left || !n->right) { ok = fail("internal node with one child"); return; }
+    if (!n->lines.empty()) { ok = fail("internal node holds lines"); return; }
+    self(self, n->left.get());
+    self(self, n->right.get());
+    if (!ok) return;
+    if (n->lines_count != n->left->lines_count + n->right->lines_count) ok = fail("bad lines_count");
+    else if (n->height != 1 + std::max(n->left->height, n->right->height)) ok = fail("bad height");
+    else if (std::abs(balance_factor(n)) > 1) ok = fail("AVL balance violated");
+  };
+  if (root_) walk(walk, root_.get());
+  return ok;
+}
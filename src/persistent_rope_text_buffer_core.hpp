@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <span>
+#include "i_text_buffer_core.hpp"
+#include "avl_line_cursor.hpp"
+
+/*
+  persistent rope backend: same AVL-of-leaves layout as the rope, but nodes
+  are reference counted and shared. copying the core is O(1) (one refcount
+  bump), and an edit copies only the shared nodes on its root-to-leaf path,
+  so old copies keep seeing their version while this one keeps changing.
+  nodes owned by a single version are still edited in place.
+*/
+class PersistentRopeTextBufferCore : public TextBufferCoreCRTP<PersistentRopeTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "prope"; }
+  static constexpr size_t LEAF_MAX_LINES = 128;
+  static constexpr size_t LEAF_MIN_LINES = LEAF_MAX_LINES / 4;
+
+  void init_from_lines(const std::vector<std::string>& lines);
+  void adopt_lines(std::vector<std::string>&& lines);
+  int line_count() const;
+  std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
+
+  void insert_line(size_t row, const std::string& s);
+  void insert_line(size_t row, std::string_view s);
+  void insert_lines(size_t row, const std::vector<std::string>& ss);
+  void insert_lines(size_t row, std::span<const std::string> ss);
+  void erase_line(size_t row);
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
+  void replace_line(size_t row, const std::string& s);
+  void replace_line(size_t row, std::string_view s);
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col);
+  void join_lines(size_t row);
+
+  /*O(1): the returned core shares every node with this one*/
+  PersistentRopeTextBufferCore snapshot() const { return *this; }
+
+  /*debug: verify AVL balance, aggregates and leaf sizes*/
+  bool check_invariants(std::string* why = nullptr) const;
+
+  /*forward to CRTP impl*/
+  void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_adopt_lines(std::vector<std::string>&& lines) { adopt_lines(std::move(lines)); }
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
+  void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
+  void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
+  void do_erase_line(size_t row) { erase_line(row); }
+  void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
+  void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
+  void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+
+private:
+  struct Node;
+  using NodePtr = std::shared_ptr<Node>;
+  struct Node {
+    NodePtr left;
+    NodePtr right;
+    std::vector<std::string> lines; /* non-empty only for leaves */
+    size_t lines_count = 0;
+    int height = 1;
+  };
+  NodePtr root_;
+
+  static bool is_leaf(const Node* n) { return !n->left && !n->right; }
+  static size_t count_lines(const NodePtr& n) { return n ? n->lines_count : 0; }
+  static int node_height(const NodePtr& n) { return n ? n->height : 0; }
+  static int balance_factor(const Node* n) { return node_height(n->left) - node_height(n->right); }
+  /*copy-on-write: clone the node if another version still references it*/
+  static Node* mut(NodePtr& n);
+  /*path-copies down to row and hands out its line for in-place edits*/
+  std::string& line_ref(size_t row);
+  /*hand the children over; if nobody else sees n they stay uniquely owned*/
+  static std::pair<NodePtr, NodePtr> take_children(NodePtr n);
+  static void recalc(Node* n);
+  static NodePtr rotate_left(NodePtr x);
+  static NodePtr rotate_right(NodePtr y);
+  static NodePtr balance(NodePtr n);
+
+  static NodePtr make_leaf(std::vector<std::string>&& lines);
+  static NodePtr make_internal(NodePtr a, NodePtr b);
+  static NodePtr join(NodePtr a, NodePtr b);
+  static NodePtr concat(NodePtr a, NodePtr b);
+  static std::pair<NodePtr, NodePtr> split(NodePtr n, size_t k);
+  static NodePtr pop_leftmost(NodePtr n, std::vector<std::string>& out);
+  static Node* mut_rightmost_leaf(NodePtr& n);
+  static Node* mut_leftmost_leaf(NodePtr& n);
+  static void fix_left_spine(Node* n);
+  static void fix_right_spine(Node* n);
+  static NodePtr insert_at(NodePtr n, size_t row, std::string&& s);
+  static NodePtr erase_at(NodePtr n, size_t row);
+  static NodePtr build_balanced(std::span<const std::string> lines);
+  /*same, moving the strings into the leaves*/
+  static NodePtr build_balanced_moved(std::span<std::string> lines);
+
+public:
+  using LineCursor = AvlLineCursor<Node>;
+  LineCursor line_cursor(int r) const { return LineCursor(root_.get(), r); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
+};
+
+static_assert(TextBufferCoreCRTPConcept<PersistentRopeTextBufferCore>, "Persistent rope backend must satisfy CRTP concept");
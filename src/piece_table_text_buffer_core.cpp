@@ -0,0 +1,618 @@
+#include "piece_table_text_buffer_core.hpp"
+#include "newline_scan.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+std::string_view PieceTableTextBufferCore::AddBuffer::append(std::string_view s) {
+  if (!room(s.size())) {
+    size_t spilled = spill_.bytes();
+    char* p = budget_ > 0 ? spill_.allocate(ADD_BLOCK) : nullptr;
+    if (p) {
+      blocks_.push_back({p, nullptr});
+      if (spill_.bytes() > spilled) spill_.page_out(budget_);
+    } else {
+      // no budget, or no room on disk: the heap it is
+      auto heap = std::make_unique<char[]>(ADD_BLOCK);
+      p = heap.get();
+      blocks_.push_back({p, std::move(heap)});
+    }
+    used_ = 0;
+  }
+  char* at = blocks_.back().data + used_;
+  std::memcpy(at, s.data(), s.size());
+  used_ += s.size();
+  return {at, s.size()};
+}
+
+std::vector<PieceTableTextBufferCore::AddBuffer::Move> PieceTableTextBufferCore::AddBuffer::set_budget(size_t budget) {
+  budget_ = budget;
+  std::vector<Move> moves;
+  if (budget_ == 0) return moves;
+  for (Block& b : blocks_) {
+    if (!b.heap) continue;
+    char* to = spill_.allocate(ADD_BLOCK);
+    if (!to) break;
+    std::memcpy(to, b.data, ADD_BLOCK);
+    moves.push_back({b.data, to, std::move(b.heap)});
+    b.data = to;
+  }
+  spill_.page_out(budget_);
+  return moves;
+}
+
+void PieceTableTextBufferCore::set_memory_budget(size_t budget) {
+  auto moves = add_.set_budget(budget);
+  std::sort(moves.begin(), moves.end(), [](const auto& a, const auto& b) { return std::less<const char*>()(a.from, b.from); });
+  if (!moves.empty()) repoint(root_.get(), moves);
+}
+
+void PieceTableTextBufferCore::repoint(Node* n, const std::vector<AddBuffer::Move>& moves) {
+  if (!n) return;
+  if (!is_leaf(n)) {
+    repoint(n->left.get(), moves);
+    repoint(n->right.get(), moves);
+    return;
+  }
+  // moves are sorted by from; a piece in a moved block lies in the last block starting at or before it
+  std::less<const char*> less;
+  const char* p = n->piece.data();
+  auto it = std::upper_bound(moves.begin(), moves.end(), p, [&](const char* q, const auto& m) { return less(q, m.from); });
+  if (it == moves.begin()) return;
+  const auto& m = *(it - 1);
+  if (less(p, m.from + ADD_BLOCK)) n->piece = std::string_view(m.to + (p - m.from), n->piece.size());
+}
+
+void PieceTableTextBufferCore::recalc(Node* n) {
+  if (!n) return;
+  if (is_leaf(n)) {
+    n->bytes = n->piece.size();
+    n->newlines = ::count_newlines(n->piece.data(), n->piece.size()).newlines;
+    n->height = 1;
+    return;
+  }
+  n->bytes = count_bytes(n->left.get()) + count_bytes(n->right.get());
+  n->newlines = count_newlines(n->left.get()) + count_newlines(n->right.get());
+  n->height = 1 + std::max(node_height(n->left.get()), node_height(n->right.get()));
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::rotate_left(std::unique_ptr<Node> x) {
+  auto y = std::move(x->right);
+  x->right = std::move(y->left);
+  recalc(x.get());
+  y->left = std::move(x);
+  recalc(y.get());
+  return y;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::rotate_right(std::unique_ptr<Node> y) {
+  auto x = std::move(y->left);
+  y->left = std::move(x->right);
+  recalc(y.get());
+  x->right = std::move(y);
+  recalc(x.get());
+  return x;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::balance(std::unique_ptr<Node> n) {
+  if (!n) return n;
+  recalc(n.get());
+  int bf = balance_factor(n.get());
+  if (bf > 1) {
+    if (balance_factor(n->left.get()) < 0) n->left = rotate_left(std::move(n->left));
+    return rotate_right(std::move(n));
+  } else if (bf < -1) {
+    if (balance_factor(n->right.get()) > 0) n->right = rotate_right(std::move(n->right));
+    return rotate_left(std::move(n));
+  }
+  return n;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::make_leaf(std::string_view piece) {
+  auto n = std::make_unique<Node>();
+  n->piece = piece;
+  recalc(n.get());
+  return n;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::make_leaf(std::string_view piece, size_t newlines) {
+  auto n = std::make_unique<Node>();
+  n->piece = piece;
+  n->bytes = piece.size();
+  n->newlines = newlines;
+  return n;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::make_internal(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+  auto p = std::make_unique<Node>();
+  p->left = std::move(a);
+  p->right = std::move(b);
+  recalc(p.get());
+  return p;
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::join(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+  if (!a) return b;
+  if (!b) return a;
+  int ha = node_height(a.get());
+  int hb = node_height(b.get());
+  if (ha > hb + 1) {
+    a->right = join(std::move(a->right), std::move(b));
+    return balance(std::move(a));
+  }
+  if (hb > ha + 1) {
+    b->left = join(std::move(a), std::move(b->left));
+    return balance(std::move(b));
+  }
+  return make_internal(std::move(a), std::move(b));
+}
+
+// splitting a piece only recounts the newlines of that one piece
+std::pair<std::unique_ptr<PieceTableTextBufferCore::Node>, std::unique_ptr<PieceTableTextBufferCore::Node>>
+PieceTableTextBufferCore::split(std::unique_ptr<Node> n, size_t k) {
+  if (!n) return {nullptr, nullptr};
+  if (k == 0) return {nullptr, std::move(n)};
+  if (k >= n->bytes) return {std::move(n), nullptr};
+  if (is_leaf(n.get())) {
+    std::string_view right = n->piece.substr(k);
+    n->piece = n->piece.substr(0, k);
+    recalc(n.get());
+    return {std::move(n), make_leaf(right)};
+  }
+  size_t left_bytes = count_bytes(n->left.get());
+  if (k < left_bytes) {
+    auto [a, b] = split(std::move(n->left), k);
+    return {std::move(a), join(std::move(b), std::move(n->right))};
+  }
+  if (k == left_bytes) return {std::move(n->left), std::move(n->right)};
+  auto [a, b] = split(std::move(n->right), k - left_bytes);
+  return {join(std::move(n->left), std::move(a)), std::move(b)};
+}
+
+std::unique_ptr<PieceTableTextBufferCore::Node> PieceTableTextBufferCore::build(std::vector<std::unique_ptr<Node>>& leaves, size_t l, size_t r) {
+  if (l >= r) return nullptr;
+  if (r - l == 1) return std::move(leaves[l]);
+  size_t mid = l + (r - l) / 2;
+  auto left = build(leaves, l, mid);
+  auto right = build(leaves, mid, r);
+  return join(std::move(left), std::move(right));
+}
+
+void PieceTableTextBufferCore::read_at(const Node* n, size_t pos, size_t len, std::string& out) {
+  if (!n || len == 0) return;
+  if (is_leaf(n)) { out.append(n->piece.substr(pos, len)); return; }
+  size_t lb = count_bytes(n->left.get());
+  if (pos < lb) {
+    size_t take = std::min(len, lb - pos);
+    read_at(n->left.get(), pos, take, out);
+    read_at(n->right.get(), 0, len - take, out);
+  } else {
+    read_at(n->right.get(), pos - lb, len, out);
+  }
+}
+
+bool PieceTableTextBufferCore::extend_at(Node* n, size_t pos, std::string_view data) {
+  if (is_leaf(n)) {
+    if (pos != n->piece.size() || n->piece.data() + n->piece.size() != add_.tail()) return false;
+    if (n->piece.size() + data.size() > PIECE_MAX || !add_.room(data.size())) return false;
+    add_.append(data);
+    n->piece = std::string_view(n->piece.data(), n->piece.size() + data.size());
+    n->bytes = n->piece.size();
+    n->newlines += ::count_newlines(data.data(), data.size()).newlines;
+    return true;
+  }
+  size_t lb = count_bytes(n->left.get());
+  bool ok = pos <= lb ? extend_at(n->left.get(), pos, data) : extend_at(n->right.get(), pos - lb, data);
+  if (ok) recalc(n);
+  return ok;
+}
+
+size_t PieceTableTextBufferCore::newline_pos(size_t k) const {
+  const Node* cur = root_.get();
+  size_t base = 0;
+  while (!is_leaf(cur)) {
+    size_t ln = count_newlines(cur->left.get());
+    if (k <= ln) { cur = cur->left.get(); continue; }
+    k -= ln;
+    base += count_bytes(cur->left.get());
+    cur = cur->right.get();
+  }
+  const char* data = cur->piece.data();
+  const char* end = data + cur->piece.size();
+  const char* p = data;
+  for (;;) {
+    const char* q = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    // the piece holds fewer '\n's than its count says: stop at its end rather than run off it
+    if (!q) return base + cur->piece.size();
+    if (--k == 0) return base + static_cast<size_t>(q - data);
+    p = q + 1;
+  }
+}
+
+size_t PieceTableTextBufferCore::line_start(size_t row) const {
+  return row == 0 ? 0 : newline_pos(row) + 1;
+}
+
+size_t PieceTableTextBufferCore::newlines_before(size_t pos) const {
+  const Node* cur = root_.get();
+  size_t k = 0;
+  while (!is_leaf(cur)) {
+    size_t lb = count_bytes(cur->left.get());
+    if (pos < lb) { cur = cur->left.get(); continue; }
+    pos -= lb;
+    k += count_newlines(cur->left.get());
+    cur = cur->right.get();
+  }
+  return k + ::count_newlines(cur->piece.data(), pos).newlines;
+}
+
+std::pair<int, size_t> PieceTableTextBufferCore::byte_to_row(size_t off) const {
+  if (!root_) return {0, 0};
+  off = std::min(off, byte_count());
+  size_t row = newlines_before(off);
+  return {static_cast<int>(row), off - line_start(row)};
+}
+
+void PieceTableTextBufferCore::insert_bytes(size_t pos, std::string_view data) {
+  if (data.empty()) return;
+  if (root_ && pos > 0 && data.size() <= PIECE_MAX && extend_at(root_.get(), pos, data)) return;
+  std::vector<std::unique_ptr<Node>> leaves;
+  leaves.reserve(data.size() / PIECE_MAX + 1);
+  while (!data.empty()) {
+    size_t take = std::min(data.size(), PIECE_MAX);
+    leaves.push_back(make_leaf(add_.append(data.substr(0, take))));
+    data.remove_prefix(take);
+  }
+  auto M = build(leaves, 0, leaves.size());
+  auto [A, B] = split(std::move(root_), pos);
+  root_ = join(join(std::move(A), std::move(M)), std::move(B));
+}
+
+void PieceTableTextBufferCore::erase_bytes(size_t pos, size_t len) {
+  if (len == 0) return;
+  auto [A, B] = split(std::move(root_), pos);
+  auto [M, C] = split(std::move(B), len);
+  root_ = join(std::move(A), std::move(C));
+}
+
+bool PieceTableTextBufferCore::open_file(const std::filesystem::path& path, std::string& msg) {
+  root_.reset();
+  add_.clear();
+  file_.reset();
+  auto file = std::make_shared<MappedFile>();
+  if (!file->open(path.string().c_str())) { msg = std::string("can not mmap file: ") + path.string(); return false; }
+  std::string_view text = file->view();
+  NewlineIndex index;
+  bool cache = text.size() >= TB_NEWLINE_CACHE_BYTES, grew = false;
+  bool hit = cache && index.load_cached(path, text, grew);
+  if (!hit) {
+    file->advise(MADV_SEQUENTIAL);
+    index.extend(text);
+    file->advise(MADV_NORMAL);
+  }
+  // a CRLF file is cached too: next time it is turned away without a scan
+  if (cache && (!hit || grew)) index.store_cached(path, text);
+  if (index.crlf() > 0) { msg = std::string("CRLF line ends, not mapped: ") + path.string(); return false; }
+  open_mapped(std::move(file), index);
+  msg = std::string("opened file: ") + path.string();
+  return true;
+}
+
+void PieceTableTextBufferCore::open_mapped(std::shared_ptr<const MappedFile> file, const NewlineIndex& index) {
+  root_.reset();
+  add_.clear();
+  std::string_view text = file->view();
+  // cut the mapping into pieces, counting their newlines from the index without touching the pages
+  size_t pieces = (text.size() + PIECE_MAX - 1) / PIECE_MAX;
+  std::vector<size_t> nl(pieces, 0);
+  index.for_each([&](uint64_t at) { ++nl[at / PIECE_MAX]; });
+  std::vector<std::unique_ptr<Node>> leaves;
+  leaves.reserve(pieces + 1);
+  for (size_t i = 0; i < pieces; ++i) leaves.push_back(make_leaf(text.substr(i * PIECE_MAX, PIECE_MAX), nl[i]));
+  // the last line's '\n' is not in the file
+  leaves.push_back(make_leaf(add_.append("\n"), 1));
+  root_ = build(leaves, 0, leaves.size());
+  file_ = std::move(file);
+}
+
+void PieceTableTextBufferCore::adopt_mapping(std::shared_ptr<const MappedFile> file) {
+  root_.reset();
+  add_.clear();
+  file_ = std::move(file);
+}
+
+void PieceTableTextBufferCore::append_mapped(std::string_view bytes, bool last) {
+  std::vector<std::unique_ptr<Node>> leaves;
+  leaves.reserve(bytes.size() / PIECE_MAX + 2);
+  for (size_t off = 0; off < bytes.size(); off += PIECE_MAX) leaves.push_back(make_leaf(bytes.substr(off, PIECE_MAX)));
+  if (last) leaves.push_back(make_leaf(add_.append("\n"), 1));
+  root_ = join(std::move(root_), build(leaves, 0, leaves.size()));
+}
+
+template <typename Lines>
+void PieceTableTextBufferCore::init_from(const Lines& lines, size_t n) {
+  root_.reset();
+  add_.clear();
+  file_.reset();
+  // lines are packed into full pieces, one copy into the add buffer
+  std::vector<std::unique_ptr<Node>> leaves;
+  std::string cur;
+  cur.reserve(PIECE_MAX);
+  auto flush = [&] { leaves.push_back(make_leaf(add_.append(cur))); cur.clear(); };
+  auto put = [&](std::string_view s) {
+    while (!s.empty()) {
+      size_t take = std::min(s.size(), PIECE_MAX - cur.size());
+      cur.append(s.substr(0, take));
+      s.remove_prefix(take);
+      if (cur.size() == PIECE_MAX) flush();
+    }
+  };
+  for (size_t i = 0; i < n; ++i) { put(lines[i]); put("\n"); }
+  if (!cur.empty()) flush();
+  root_ = build(leaves, 0, leaves.size());
+}
+
+void PieceTableTextBufferCore::init_from_lines(const std::vector<std::string>& lines) { init_from(lines, lines.size()); }
+
+void PieceTableTextBufferCore::init_from_arena(const LineArena& arena) { init_from(arena, arena.size()); }
+
+std::string PieceTableTextBufferCore::get_line(int r) const {
+  if (r < 0 || r >= line_count()) return std::string();
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  std::string out;
+  out.reserve(end - start);
+  read_at(root_.get(), start, end - start, out);
+  return out;
+}
+
+std::string_view PieceTableTextBufferCore::get_line_view(int r, std::string& scratch) const {
+  if (r < 0 || r >= line_count()) return {};
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  // a line inside one piece is returned in place, straight from the mapping or the add buffer
+  const Node* cur = root_.get();
+  size_t base = 0;
+  while (!is_leaf(cur)) {
+    size_t lb = count_bytes(cur->left.get());
+    if (start < base + lb) cur = cur->left.get();
+    else { base += lb; cur = cur->right.get(); }
+  }
+  if (end <= base + cur->piece.size()) return cur->piece.substr(start - base, end - start);
+  scratch.clear();
+  scratch.reserve(end - start);
+  read_at(root_.get(), start, end - start, scratch);
+  return scratch;
+}
+
+size_t PieceTableTextBufferCore::line_length(int r) const {
+  if (r < 0 || r >= line_count()) return 0;
+  return newline_pos(static_cast<size_t>(r) + 1) - line_start(static_cast<size_t>(r));
+}
+
+std::string PieceTableTextBufferCore::line_slice(int r, size_t col, size_t len) const {
+  if (r < 0 || r >= line_count()) return std::string();
+  size_t start = line_start(static_cast<size_t>(r));
+  size_t end = newline_pos(static_cast<size_t>(r) + 1);
+  if (col >= end - start) return std::string();
+  len = std::min(len, end - start - col);
+  std::string out;
+  out.reserve(len);
+  read_at(root_.get(), start + col, len, out);
+  return out;
+}
+
+void PieceTableTextBufferCore::insert_line(size_t row, const std::string& s) { insert_line(row, std::string_view(s)); }
+
+void PieceTableTextBufferCore::insert_line(size_t row, std::string_view s) {
+  size_t L = static_cast<size_t>(line_count()); if (row > L) row = L;
+  std::string data;
+  data.reserve(s.size() + 1);
+  data.append(s);
+  data.push_back('\n');
+  insert_bytes(line_start(row), data);
+}
+
+void PieceTableTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
+  insert_lines(row, std::span<const std::string>(ss.begin(), ss.end()));
+}
+
+void PieceTableTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  if (ss.empty()) return;
+  size_t L = static_cast<size_t>(line_count()); if (row > L) row = L;
+  size_t total = 0;
+  for (const auto& s : ss) total += s.size() + 1;
+  std::string data;
+  data.reserve(total);
+  for (const auto& s : ss) { data += s; data.push_back('\n'); }
+  insert_bytes(line_start(row), data);
+}
+
+void PieceTableTextBufferCore::erase_line(size_t row) { erase_lines(row, row + 1); }
+
+void PieceTableTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
+  size_t L = static_cast<size_t>(line_count());
+  if (end_row < start_row) end_row = start_row;
+  if (start_row >= L) return;
+  if (end_row > L) end_row = L;
+  size_t a = line_start(start_row);
+  erase_bytes(a, line_start(end_row) - a);
+}
+
+void PieceTableTextBufferCore::replace_line(size_t row, const std::string& s) { replace_line(row, std::string_view(s)); }
+
+void PieceTableTextBufferCore::replace_line(size_t row, std::string_view s) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t end = newline_pos(row + 1);
+  erase_bytes(start, end - start);
+  insert_bytes(start, s);
+}
+
+void PieceTableTextBufferCore::replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+  size_t L = static_cast<size_t>(line_count());
+  start_row = std::min(start_row, L);
+  end_row = std::clamp(end_row, start_row, L);
+  size_t total = 0;
+  for (const auto& s : ss) total += s.size() + 1;
+  std::string data;
+  data.reserve(total);
+  for (const auto& s : ss) { data += s; data.push_back('\n'); }
+  size_t a = line_start(start_row);
+  erase_bytes(a, line_start(end_row) - a);
+  insert_bytes(a, data);
+}
+
+void PieceTableTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t len = newline_pos(row + 1) - start;
+  insert_bytes(start + std::min(col, len), s);
+}
+
+void PieceTableTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= static_cast<size_t>(line_count())) return;
+  size_t start = line_start(row);
+  size_t line_len = newline_pos(row + 1) - start;
+  if (col >= line_len) return;
+  erase_bytes(start + col, std::min(len, line_len - col));
+}
+
+void PieceTableTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= static_cast<size_t>(line_count())) return;
+  erase_bytes(newline_pos(row + 1), 1);
+}
+
+void PieceTableTextBufferCore::LineCursor::locate(size_t pos) {
+  path_.clear();
+  const Node* n = core_->root_.get();
+  base_ = 0;
+  while (!is_leaf(n)) {
+    path_.push_back(n);
+    size_t lb = count_bytes(n->left.get());
+    if (pos < base_ + lb) n = n->left.get();
+    else { base_ += lb; n = n->right.get(); }
+  }
+  leaf_ = n;
+}
+
+void PieceTableTextBufferCore::LineCursor::next_leaf() {
+  const Node* child = leaf_;
+  size_t nb = base_ + leaf_->piece.size();
+  while (!path_.empty()) {
+    const Node* p = path_.back();
+    if (p->left.get() == child) {
+      const Node* n = p->right.get();
+      while (!is_leaf(n)) { path_.push_back(n); n = n->left.get(); }
+      leaf_ = n;
+      base_ = nb;
+      return;
+    }
+    child = p;
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void PieceTableTextBufferCore::LineCursor::prev_leaf() {
+  const Node* child = leaf_;
+  while (!path_.empty()) {
+    const Node* p = path_.back();
+    if (p->right.get() == child) {
+      const Node* n = p->left.get();
+      while (!is_leaf(n)) { path_.push_back(n); n = n->right.get(); }
+      leaf_ = n;
+      base_ -= n->piece.size();
+      return;
+    }
+    child = p;
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void PieceTableTextBufferCore::LineCursor::seek(int r) {
+  path_.clear();
+  leaf_ = nullptr;
+  row_ = r;
+  if (r < 0 || r >= core_->line_count()) return;
+  start_ = core_->line_start(static_cast<size_t>(r));
+  end_ = core_->newline_pos(static_cast<size_t>(r) + 1);
+  locate(end_);
+}
+
+void PieceTableTextBufferCore::LineCursor::next() {
+  if (!leaf_) { seek(row_ + 1); return; }
+  if (++row_ >= core_->line_count()) { leaf_ = nullptr; path_.clear(); return; }
+  start_ = end_ + 1;
+  size_t pos = start_;
+  for (;;) {
+    // the text ends with '\n', so a next piece exists while pos is inside it
+    while (pos >= base_ + leaf_->piece.size()) next_leaf();
+    const char* d = leaf_->piece.data();
+    size_t off = pos - base_;
+    const void* q = std::memchr(d + off, '\n', leaf_->piece.size() - off);
+    if (q) { end_ = base_ + static_cast<size_t>(static_cast<const char*>(q) - d); return; }
+    pos = base_ + leaf_->piece.size();
+  }
+}
+
+void PieceTableTextBufferCore::LineCursor::prev() {
+  if (!leaf_) { seek(row_ - 1); return; }
+  if (--row_ < 0) { leaf_ = nullptr; path_.clear(); return; }
+  end_ = start_ - 1;
+  while (end_ < base_) prev_leaf();
+  const char* d = leaf_->piece.data();
+  for (size_t i = end_ - base_; i-- > 0;) {
+    if (d[i] == '\n') { start_ = base_ + i + 1; return; }
+  }
+  // the row starts in an earlier piece (or at 0)
+  start_ = base_ == 0 ? 0 : core_->line_start(static_cast<size_t>(row_));
+}
+
+std::string_view PieceTableTextBufferCore::LineCursor::view(std::string& scratch) const {
+  if (start_ >= base_) return leaf_->piece.substr(start_ - base_, end_ - start_);
+  scratch.clear();
+  scratch.reserve(end_ - start_);
+  read_at(core_->root_.get(), start_, end_ - start_, scratch);
+  return scratch;
+}
+
+std::string PieceTableTextBufferCore::LineCursor::slice(size_t col, size_t len) const {
+  if (col >= length()) return std::string();
+  len = std::min(len, length() - col);
+  std::string out;
+  out.reserve(len);
+  read_at(core_->root_.get(), start_ + col, len, out);
+  return out;
+}
+
+bool PieceTableTextBufferCore::check_invariants(std::string* why) const {
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  bool ok = true;
+  auto walk = [&](auto&& self, const Node* n) -> void {
+    if (!ok) return;
+    if (is_leaf(n)) {
+      if (n->piece.empty() || n->piece.size() > PIECE_MAX) ok = fail("piece size out of bounds");
+      else if (n->bytes != n->piece.size() || n->height != 1 ||
+               n->newlines != static_cast<size_t>(std::count(n->piece.begin(), n->piece.end(), '\n'))) ok = fail("bad leaf aggregates");
+      return;
+    }
+    if (!n->left || !n->right) { ok = fail("internal node with one child"); return; }
+    if (!n->piece.empty()) { ok = fail("internal node holds a piece"); return; }
+    self(self, n->left.get());
+    self(self, n->right.get());
+    if (!ok) return;
+    if (n->bytes != n->left->bytes + n->right->bytes || n->newlines != n->left->newlines + n->right->newlines) ok = fail("bad aggregates");
+    else if (n->height != 1 + std::max(n->left->height, n->right->height)) ok = fail("bad height");
+    else if (std::abs(balance_factor(n)) > 1) ok = fail("AVL balance violated");
+  };
+  if (!root_) return true;
+  walk(walk, root_.get());
+  if (!ok) return false;
+  const Node* last = root_.get();
+  while (!is_leaf(last)) last = last->right.get();
+  if (last->piece.back() != '\n') return fail("text does not end with a newline");
+  return true;
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <span>
+#include <filesystem>
+#include "i_text_buffer_core.hpp"
+#include "mapped_file.hpp"
+#include "newline_index.hpp"
+#include "spill_file.hpp"
+
+/*
+  piece table backend: the original file stays mapped read-only and edits
+  go to an append-only add buffer; the text is an AVL tree of pieces, each
+  a view into one of the two, aggregating bytes and newlines like the byte
+  rope. opening a file is one newline scan with no copy, and the heap only
+  grows by what the edits add. every line is stored with its trailing '\n'.
+*/
+class PieceTableTextBufferCore : public TextBufferCoreCRTP<PieceTableTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "piece"; }
+  /*longest piece: bounds the rescan when a piece is split*/
+  static constexpr size_t PIECE_MAX = 16 * 1024;
+  static constexpr size_t ADD_BLOCK = 64 * 1024;
+
+  /*
+    map path and take it as the text without copying it. false, with the
+    core left empty, when the file cannot be mapped or uses CRLF line ends
+    (those have to be normalized by a copying read). files of
+    TB_NEWLINE_CACHE_BYTES or more take their newlines from the sidecar
+    cache when it is current, and leave it current.
+  */
+  bool open_file(const std::filesystem::path& path, std::string& msg);
+  /*take file as the text, its newlines found in index; file must have no CRLF*/
+  void open_mapped(std::shared_ptr<const MappedFile> file, const NewlineIndex& index);
+  /*
+    progressive open: start empty over file, then append_mapped adds bytes
+    of it at the end: whole '\n'-ended lines with no '\r' before a '\n',
+    and with last the unended final line and its stored '\n'.
+  */
+  void adopt_mapping(std::shared_ptr<const MappedFile> file);
+  void append_mapped(std::string_view bytes, bool last);
+  bool maps(const MappedFile* file) const { return file && file_.get() == file; }
+  void init_from_lines(const std::vector<std::string>& lines);
+  void init_from_arena(const LineArena& arena);
+  int line_count() const { return static_cast<int>(count_newlines(root_.get())); }
+  std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
+  size_t line_length(int r) const;
+  std::string line_slice(int r, size_t col, size_t len) const;
+
+  void insert_line(size_t row, const std::string& s);
+  void insert_line(size_t row, std::string_view s);
+  void insert_lines(size_t row, const std::vector<std::string>& ss);
+  void insert_lines(size_t row, std::span<const std::string> ss);
+  void erase_line(size_t row);
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
+  void replace_line(size_t row, const std::string& s);
+  void replace_line(size_t row, std::string_view s);
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss);
+
+  /*edits inside one line; typing at the end of the last insert extends its piece*/
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col) { insert_text(row, col, "\n"); }
+  void join_lines(size_t row);
+  size_t byte_size() const { return count_bytes(root_.get()); }
+  /*saved-text offsets: the stored text is the saved one plus a final '\n'*/
+  size_t byte_count() const { return byte_size() == 0 ? 0 : byte_size() - 1; }
+  size_t row_to_byte(int r) const { return line_start(static_cast<size_t>(r)); }
+  std::pair<int, size_t> byte_to_row(size_t off) const;
+  /*bytes held for inserted text, on the heap or in the spill file*/
+  size_t added_bytes() const { return add_.capacity(); }
+  size_t spilled_bytes() const { return add_.spilled(); }
+  /*
+    cap the memory inserted text may take: from now on it goes to a spill
+    file, and all but the newest budget bytes of it are paged out as more
+    comes in. text already on the heap moves there too. 0 lifts the cap
+    for new text; what was spilled stays in the file.
+  */
+  void set_memory_budget(size_t budget);
+  /*f(bytes) for each piece of the saved text, in order; stops at the first false*/
+  template <typename F>
+  bool for_each_span(F&& f) const {
+    size_t left = byte_count();
+    return for_each_piece(root_.get(), [&](std::string_view p) {
+      if (left == 0) return true;
+      p = p.substr(0, std::min(p.size(), left));
+      left -= p.size();
+      return f(p);
+    });
+  }
+
+  /*debug: verify AVL balance, aggregates and piece sizes*/
+  bool check_invariants(std::string* why = nullptr) const;
+
+  /*forward to CRTP impl*/
+  void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_init_from_arena(const LineArena& arena) { init_from_arena(arena); }
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  size_t do_line_length(int r) const { return line_length(r); }
+  std::string do_line_slice(int r, size_t col, size_t len) const { return line_slice(r, col, len); }
+  void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
+  void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
+  void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
+  void do_erase_line(size_t row) { erase_line(row); }
+  void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
+  void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
+  void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+  size_t do_byte_count() const { return byte_count(); }
+  size_t do_row_to_byte(int r) const { return row_to_byte(r); }
+  std::pair<int, size_t> do_byte_to_row(size_t off) const { return byte_to_row(off); }
+  void do_set_memory_budget(size_t budget) { set_memory_budget(budget); }
+  template <typename F> bool do_for_each_span(F&& f) const { return for_each_span(f); }
+
+private:
+  /*
+    append-only storage for inserted text. blocks never move once
+    allocated, so pieces point straight into them. they come from the
+    heap, or under a memory budget from a spill file (see SpillFile).
+  */
+  class AddBuffer {
+  public:
+    /*a heap block moved to the spill file; old stays valid until the pieces in it are repointed*/
+    struct Move {
+      const char* from;
+      char* to;
+      std::unique_ptr<char[]> old;
+    };
+    /*copy s (at most ADD_BLOCK bytes) in and return where it now lives*/
+    std::string_view append(std::string_view s);
+    /*one past the last byte appended, where an extending append would land*/
+    const char* tail() const { return blocks_.empty() ? nullptr : blocks_.back().data + used_; }
+    bool room(size_t n) const { return !blocks_.empty() && used_ + n <= ADD_BLOCK; }
+    size_t capacity() const { return blocks_.size() * ADD_BLOCK; }
+    size_t spilled() const { return spill_.bytes(); }
+    /*drop the text, keeping the budget*/
+    void clear() { blocks_.clear(); spill_.clear(); used_ = 0; }
+    /*see set_memory_budget; returns the heap blocks moved to the spill file*/
+    std::vector<Move> set_budget(size_t budget);
+
+  private:
+    struct Block {
+      char* data;
+      std::unique_ptr<char[]> heap; /* owns data unless it is in the spill file */
+    };
+    std::vector<Block> blocks_;
+    SpillFile spill_;
+    size_t budget_ = 0;
+    size_t used_ = 0;
+  };
+
+  /*
+    leaves: no children, a non-empty piece of at most PIECE_MAX bytes.
+    internal nodes: always two children, no piece.
+  */
+  struct Node {
+    std::unique_ptr<Node> left;
+    std::unique_ptr<Node> right;
+    std::string_view piece; /* leaves only: bytes in the mapping or the add buffer */
+    size_t bytes = 0;       /* aggregated byte count */
+    size_t newlines = 0;    /* aggregated '\n' count */
+    int height = 1;         /* AVL height */
+  };
+  std::shared_ptr<const MappedFile> file_;
+  AddBuffer add_;
+  std::unique_ptr<Node> root_;
+
+  static bool is_leaf(const Node* n) { return !n->left && !n->right; }
+  static size_t count_bytes(const Node* n) { return n ? n->bytes : 0; }
+  static size_t count_newlines(const Node* n) { return n ? n->newlines : 0; }
+  static int node_height(const Node* n) { return n ? n->height : 0; }
+  static int balance_factor(const Node* n) { return n ? (node_height(n->left.get()) - node_height(n->right.get())) : 0; }
+  static void recalc(Node* n);
+  static std::unique_ptr<Node> rotate_left(std::unique_ptr<Node> x);
+  static std::unique_ptr<Node> rotate_right(std::unique_ptr<Node> y);
+  static std::unique_ptr<Node> balance(std::unique_ptr<Node> n);
+
+  static std::unique_ptr<Node> make_leaf(std::string_view piece);
+  static std::unique_ptr<Node> make_leaf(std::string_view piece, size_t newlines);
+  static std::unique_ptr<Node> make_internal(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
+  static std::unique_ptr<Node> join(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
+  static std::pair<std::unique_ptr<Node>, std::unique_ptr<Node>> split(std::unique_ptr<Node> n, size_t k);
+  static std::unique_ptr<Node> build(std::vector<std::unique_ptr<Node>>& leaves, size_t l, size_t r);
+  static void read_at(const Node* n, size_t pos, size_t len, std::string& out);
+  template <typename F>
+  static bool for_each_piece(const Node* n, F&& f) {
+    if (!n) return true;
+    if (is_leaf(n)) return f(n->piece);
+    return for_each_piece(n->left.get(), f) && for_each_piece(n->right.get(), f);
+  }
+  static void repoint(Node* n, const std::vector<AddBuffer::Move>& moves);
+  /*grow the piece ending at pos in place when it is the add buffer's tail*/
+  bool extend_at(Node* n, size_t pos, std::string_view data);
+
+  /*byte offset of the k-th '\n' (1-based), k <= line_count()*/
+  size_t newline_pos(size_t k) const;
+  /*first byte of row; row == line_count() gives byte_size()*/
+  size_t line_start(size_t row) const;
+  /*number of '\n' in bytes [0, pos)*/
+  size_t newlines_before(size_t pos) const;
+  void insert_bytes(size_t pos, std::string_view data);
+  void erase_bytes(size_t pos, size_t len);
+  /*the first n lines of lines, each ended by a '\n'; lines[i] is a string or a view*/
+  template <typename Lines>
+  void init_from(const Lines& lines, size_t n);
+
+public:
+  /*the byte rope's cursor, walking pieces instead of chunks*/
+  class LineCursor {
+  public:
+    LineCursor(const PieceTableTextBufferCore& core, int r) : core_(&core) { seek(r); }
+    bool valid() const { return leaf_ != nullptr; }
+    int row() const { return row_; }
+    void seek(int r);
+    void next();
+    void prev();
+    std::string_view view(std::string& scratch) const;
+    size_t length() const { return end_ - start_; }
+    std::string slice(size_t col, size_t len) const;
+
+  private:
+    void locate(size_t pos);
+    void next_leaf();
+    void prev_leaf();
+    const PieceTableTextBufferCore* core_;
+    std::vector<const Node*> path_; /* internal nodes above leaf_ */
+    const Node* leaf_ = nullptr;
+    size_t base_ = 0;  /* byte offset of leaf_ */
+    size_t start_ = 0; /* first byte of the row */
+    size_t end_ = 0;   /* the row's '\n' */
+    int row_ = 0;
+  };
+  LineCursor line_cursor(int r) const { return LineCursor(*this, r); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
+};
+
+static_assert(TextBufferCoreCRTPConcept<PieceTableTextBufferCore>, "Piece table backend must satisfy CRTP concept");
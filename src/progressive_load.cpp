@@ -0,0 +1,194 @@
+#include "progressive_load.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "newline_scan.hpp"
+
+/*longest line in s, in bytes without its '\n'*/
+static size_t longest_line(std::string_view s) {
+  size_t longest = 0;
+  for (size_t at = 0; at < s.size();) {
+    const void* q = std::memchr(s.data() + at, '\n', s.size() - at);
+    size_t end = q ? static_cast<size_t>(static_cast<const char*>(q) - s.data()) : s.size();
+    longest = std::max(longest, end - at);
+    at = end + 1;
+  }
+  return longest;
+}
+
+std::unique_ptr<ProgressiveLoad> ProgressiveLoad::start(const std::filesystem::path& path, TextBuffer& buf, std::string& msg) {
+  return start(path, buf, msg, Options{});
+}
+
+std::unique_ptr<ProgressiveLoad> ProgressiveLoad::start(const std::filesystem::path& path, TextBuffer& buf, std::string& msg, const Options& opt) {
+  std::unique_ptr<ProgressiveLoad> load(new ProgressiveLoad());
+  auto file = std::make_shared<MappedFile>();
+  if (!file->open(path.string().c_str())) { msg = std::string("can not mmap file: ") + path.string(); return nullptr; }
+  file->advise(MADV_SEQUENTIAL);
+  load->path_ = path;
+  load->file_ = file;
+  load->text_ = file->view();
+  load->batch_bytes_ = std::max<size_t>(opt.batch_bytes, 1);
+
+  Batch first = load->cut(0, std::max<size_t>(opt.first_bytes, 1));
+  first.has_cr |= count_newlines(first.bytes.data(), first.bytes.size()).crlf > 0;
+  std::string backend = opt.backend;
+  if (backend.empty()) {
+    // only lines that start early are seen: the rest is not scanned before the first screen
+    size_t probe = std::max(first.bytes.size(), std::min<size_t>(load->text_.size(), 2 * size_t{TB_AUTO_BYTEROPE_LINE_BYTES}));
+    backend = TextBuffer::auto_backend(load->text_.size(), 0, longest_line(load->text_.substr(0, probe)));
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+    // what from_file would map; a CRLF file found later falls back to copied lines per batch
+    if ((TB_BACKEND == TB_BACKEND_PIECE || load->text_.size() >= TB_AUTO_PIECE_BYTES) && !first.has_cr) backend = "piece";
+#endif
+  }
+  buf = TextBuffer();
+  bool view = false;
+#if TB_BACKEND == TB_BACKEND_AUTO
+  // set_backend cannot move a document onto the read-only view; it is only ever loaded into
+  if (backend == MappedViewTextBufferCore::get_name_sv()) { buf.core.emplace<MappedViewTextBufferCore>(); view = true; }
+#endif
+  if (!view && !buf.set_backend(backend)) buf.set_backend(TextBuffer::auto_backend(load->text_.size(), 0));
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+  if (auto* piece = std::get_if<PieceTableTextBufferCore>(&buf.core); piece && load->text_.size() >= TB_NEWLINE_CACHE_BYTES) {
+    NewlineIndex index;
+    bool grew = false;
+    if (!index.load_cached(path, load->text_, grew)) {
+      load->index_ = std::make_unique<NewlineIndex>();
+    } else if (index.crlf() == 0) {
+      if (grew) index.store_cached(path, load->text_);
+      piece->open_mapped(file, index);
+      file->advise(MADV_NORMAL);
+      load->appended_ = load->text_.size();
+      load->done_ = true;
+      msg = std::string("opened file: ") + path.string();
+      return load;
+    }
+  }
+#endif
+  load->append(buf, first, true);
+  if (!first.last) {
+    size_t from = first.bytes.size();
+    load->scanner_ = std::jthread([l = load.get(), from](std::stop_token stop) { l->scan(stop, from); });
+  }
+  msg = std::string("loading file: ") + path.string();
+  return load;
+}
+
+ProgressiveLoad::Batch ProgressiveLoad::cut(size_t from, size_t want) const {
+  size_t n = text_.size();
+  size_t end = n - from <= want ? n : from + want;
+  if (end < n) {
+    // back to the last '\n' in the window, or on to the first one after it for a line longer than want
+    const char* p = text_.data();
+    size_t i = end;
+    while (i > from && p[i - 1] != '\n') --i;
+    if (i > from) end = i;
+    else {
+      const void* q = std::memchr(p + end, '\n', n - end);
+      end = q ? static_cast<size_t>(static_cast<const char*>(q) - p) + 1 : n;
+    }
+  }
+  Batch b;
+  b.bytes = text_.substr(from, end - from);
+  b.last = end == n;
+  b.has_cr = b.last && !b.bytes.empty() && b.bytes.back() == '\r';
+  return b;
+}
+
+void ProgressiveLoad::scan(std::stop_token stop, size_t from) {
+  while (!stop.stop_requested()) {
+    Batch b = cut(from, batch_bytes_);
+    // batches start after a '\n', so every crlf lies inside one
+    if (index_) {
+      size_t crlf = index_->crlf();
+      index_->extend(text_.substr(0, from + b.bytes.size()));
+      b.has_cr |= index_->crlf() > crlf;
+    } else {
+      b.has_cr |= count_newlines(b.bytes.data(), b.bytes.size()).crlf > 0;
+    }
+    from += b.bytes.size();
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      if (!cv_.wait(lk, stop, [&] { return ready_.size() < READ_AHEAD; })) return;
+      ready_.push_back(b);
+    }
+    cv_.notify_all();
+    if (b.last) {
+      if (index_) index_->store_cached(path_, text_);
+      return;
+    }
+  }
+}
+
+bool ProgressiveLoad::take(Batch& b, bool wait) {
+  std::unique_lock<std::mutex> lk(mu_);
+  if (wait) cv_.wait(lk, [&] { return !ready_.empty(); });
+  if (ready_.empty()) return false;
+  b = ready_.front();
+  ready_.pop_front();
+  lk.unlock();
+  cv_.notify_all();
+  return true;
+}
+
+void ProgressiveLoad::append(TextBuffer& buf, const Batch& b, bool first) {
+  appended_ += b.bytes.size();
+  if (b.last) {
+    done_ = true;
+    file_->advise(MADV_NORMAL);
+  }
+#if TB_BACKEND == TB_BACKEND_AUTO
+  if (auto* view = std::get_if<MappedViewTextBufferCore>(&buf.core)) {
+    if (first) view->adopt_mapping(file_);
+    view->append_mapped(b.bytes, b.last);
+    return;
+  }
+#endif
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+  // a piece table still over this mapping takes clean batches as views; edits in between are fine
+  if (auto* piece = std::get_if<PieceTableTextBufferCore>(&buf.core); piece && !b.has_cr && (first || piece->maps(file_.get()))) {
+    if (first) piece->adopt_mapping(file_);
+    piece->append_mapped(b.bytes, b.last);
+    return;
+  }
+#endif
+  std::vector<std::string> lines;
+  const char* p = b.bytes.data();
+  size_t start = 0;
+  for_each_newline(p, b.bytes.size(), [&](size_t off) {
+    size_t end = off;
+    if (end > start && p[end - 1] == '\r') --end;
+    lines.emplace_back(p + start, end - start);
+    start = off + 1;
+  });
+  if (b.last) {
+    size_t end = b.bytes.size();
+    if (end > start && p[end - 1] == '\r') --end;
+    lines.emplace_back(p + start, end - start);
+  }
+  if (first) buf.init_from_lines(std::move(lines));
+  else if (!lines.empty()) buf.insert_lines(buf.line_count(), lines);
+}
+
+bool ProgressiveLoad::pump(TextBuffer& buf, std::chrono::microseconds budget) {
+  auto deadline = std::chrono::steady_clock::now() + budget;
+  Batch b;
+  while (!done_ && take(b, false)) {
+    append(buf, b, false);
+    if (std::chrono::steady_clock::now() >= deadline) break;
+  }
+  return done_;
+}
+
+void ProgressiveLoad::wait_rows(TextBuffer& buf, int rows) {
+  Batch b;
+  while (!done_ && buf.line_count() < rows && take(b, true)) append(buf, b, false);
+}
+
+int ProgressiveLoad::percent() const {
+  if (text_.empty()) return 100;
+  return static_cast<int>(appended_ * 100 / text_.size());
+}
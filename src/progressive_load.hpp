@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "config.hpp"
+#include "mapped_file.hpp"
+#include "newline_index.hpp"
+#include "text_buffer.hpp"
+
+/*
+  progressive open of a big file. start() maps it and loads the first
+  screens before returning; a scanner thread then cuts the rest into
+  batches of whole lines and counts their newlines, which faults the pages
+  in, while the owner appends ready batches at the end of the buffer with
+  pump(), a time slice at a time. only the owner's thread touches the
+  buffer, so it can be viewed and edited during the load. on the piece
+  table clean batches go in as views of the mapping; every other core,
+  and batches with CRLF line ends, get copied lines; the read-only view
+  only indexes them. the scanner stays at most READ_AHEAD batches ahead,
+  so the pages it faults in are still there when they are appended. a
+  piece table load of
+  TB_NEWLINE_CACHE_BYTES or more is instant when the sidecar newline index
+  is current, and otherwise the scanner leaves one behind.
+*/
+class ProgressiveLoad {
+public:
+  static constexpr size_t READ_AHEAD = 4;
+
+  struct Options {
+    size_t first_bytes = TB_PROGRESSIVE_FIRST_BYTES;
+    size_t batch_bytes = TB_PROGRESSIVE_BATCH_BYTES;
+    /*core to load into, "view" included; empty picks the one TextBuffer::from_file would*/
+    std::string backend;
+  };
+  /*nullptr with msg set when the file cannot be mapped*/
+  static std::unique_ptr<ProgressiveLoad> start(const std::filesystem::path& path, TextBuffer& buf, std::string& msg);
+  static std::unique_ptr<ProgressiveLoad> start(const std::filesystem::path& path, TextBuffer& buf, std::string& msg, const Options& opt);
+  ProgressiveLoad(const ProgressiveLoad&) = delete;
+  ProgressiveLoad& operator=(const ProgressiveLoad&) = delete;
+  ~ProgressiveLoad() = default;
+
+  /*append the batches scanned so far until budget runs out; true once the whole file is in*/
+  bool pump(TextBuffer& buf, std::chrono::microseconds budget);
+  /*append batches, waiting on the scanner, until buf has rows lines or the whole file is in*/
+  void wait_rows(TextBuffer& buf, int rows);
+  void finish(TextBuffer& buf) { wait_rows(buf, INT_MAX); }
+  bool done() const { return done_; }
+  /*share of the file's bytes appended so far*/
+  int percent() const;
+
+private:
+  struct Batch {
+    std::string_view bytes; /* whole lines, or the rest of the file when last */
+    bool last = false;
+    bool has_cr = false;    /* a '\r' to drop before a '\n' or at the very end */
+  };
+  ProgressiveLoad() = default;
+  /*from the start of a line: at most about want bytes, ended after a '\n'*/
+  Batch cut(size_t from, size_t want) const;
+  void scan(std::stop_token stop, size_t from);
+  /*the next scanned batch; false when none is ready and wait is not set*/
+  bool take(Batch& b, bool wait);
+  void append(TextBuffer& buf, const Batch& b, bool first);
+
+  std::filesystem::path path_;
+  std::shared_ptr<MappedFile> file_;
+  std::string_view text_;
+  /*built by the scanner alone, stored when it reaches the end*/
+  std::unique_ptr<NewlineIndex> index_;
+  size_t batch_bytes_ = 0;
+  size_t appended_ = 0;
+  bool done_ = false;
+  std::mutex mu_;
+  std::condition_variable_any cv_;
+  std::deque<Batch> ready_;
+  std::jthread scanner_; /* last, so it is stopped and joined before the rest goes */
+};
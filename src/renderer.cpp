@@ -112,21 +112,26 @@ void Renderer::render(ITerminal& term,
     if (text_cols > 0) {
       if (cur.col < vp.left_col) vp.left_col = cur.col;
       else if (cur.col >= vp.left_col + text_cols) vp.left_col = cur.col - text_cols + 1;
+      // never scroll further right than the longest line needs
+      if (buf.fast_measures()) {
+        int widest = buf.max_line_length();
+        vp.left_col = std::min(vp.left_col, std::max(0, widest + 1 - text_cols));
+      }
       if (vp.left_col < 0) vp.left_col = 0;
     }
-    int insert_override_row = pane.override_row;
-    const std::string& insert_override_line = pane.override_line;
-    bool show_welcome = (!pane.file_path && buf.line_count() == 1 && buf.line(0).empty());
+    bool show_welcome = (!pane.file_path && buf.line_count() == 1 && buf.line_length(0) == 0);
     if (show_welcome) {
       render_welcome_mvim(term, inner_rows, inner_cols, indent, inner_row_off, inner_col_off);
     } else {
-      for (int i = 0; i < max_text_rows; ++i) {
+      auto line_it = buf.line_cursor(vp.top_line);
+      for (int i = 0; i < max_text_rows; ++i, line_it.next()) {
         int line_idx = vp.top_line + i;
-        if (line_idx >= buf.line_count()) break;
-        const auto& s = (line_idx == insert_override_row) ? insert_override_line : buf.line(line_idx);
-        int s_len = static_cast<int>(s.size());
+        if (!line_it.valid()) break;
+        // only the visible column window is fetched, long lines are never copied whole
+        int s_len = static_cast<int>(line_it.length());
         int start_col = std::min(std::max(0, vp.left_col), s_len);
         int end_col = std::min(s_len, start_col + std::max(0, text_cols));
+        std::string vis_line = line_it.slice(start_col, end_col - start_col);
         if (show_line_numbers) {
           int display_num = line_idx + 1;
           if (relative_line_numbers) {
@@ -143,17 +148,17 @@ void Renderer::render(ITerminal& term,
           int r1 = std::max(visual_anchor.row, cur.row);
           if (mode == Mode::VisualLine) {
             if (line_idx >= r0 && line_idx <= r1) {
-              std::string vis = s.substr(start_col, end_col - start_col);
+              const std::string& vis = vis_line;
               term.draw_highlighted(inner_row_off + i, inner_col_off + indent, vis, 0, static_cast<int>(vis.size()));
               term.clear_to_eol(inner_row_off + i, inner_col_off + indent + static_cast<int>(vis.size()));
             } else {
-              std::string vis = s.substr(start_col, end_col - start_col);
+              const std::string& vis = vis_line;
               term.draw_text(inner_row_off + i, inner_col_off + indent, vis);
               term.clear_to_eol(inner_row_off + i, inner_col_off + indent + static_cast<int>(vis.size()));
             }
           } else if (mode == Mode::Visual) {
             auto is_ascii_line = [](const std::string& t){ for (unsigned char c : t) { if (c >= 128) return false; } return true; };
-            std::string vis = s.substr(start_col, end_col - start_col);
+            const std::string& vis = vis_line;
             if (!is_ascii_line(vis)) {
               if (line_idx >= r0 && line_idx <= r1) term.draw_highlighted(inner_row_off + i, inner_col_off + indent, vis, 0, (int)vis.size()); else term.draw_text(inner_row_off + i, inner_col_off + indent, vis);
               term.clear_to_eol(inner_row_off + i, inner_col_off + indent + (int)vis.size());
@@ -161,21 +166,21 @@ void Renderer::render(ITerminal& term,
               if (line_idx == r0 && line_idx == r1) {
                 int c0 = std::min(visual_anchor.col, cur.col);
                 int c1 = std::max(visual_anchor.col, cur.col);
-                c0 = std::max(0, std::min(c0, static_cast<int>(s.size())));
-                c1 = std::max(0, std::min(c1, static_cast<int>(s.size())));
+                c0 = std::max(0, std::min(c0, s_len));
+                c1 = std::max(0, std::min(c1, s_len));
                 int hs = std::max(0, c0 - start_col);
                 int he = std::max(0, std::min(c1, end_col) - start_col);
                 int hlen = std::max(0, he - hs);
                 term.draw_highlighted(inner_row_off + i, inner_col_off + indent, vis, hs, hlen);
               } else if (line_idx == r0) {
                 int c0 = std::min(visual_anchor.col, cur.col);
-                c0 = std::max(0, std::min(c0, static_cast<int>(s.size())));
+                c0 = std::max(0, std::min(c0, s_len));
                 int hs = std::max(0, c0 - start_col);
                 int hlen = std::max(0, end_col - std::max(start_col, c0));
                 term.draw_highlighted(inner_row_off + i, inner_col_off + indent, vis, hs, hlen);
               } else if (line_idx == r1) {
                 int c1 = std::max(visual_anchor.col, cur.col);
-                c1 = std::max(0, std::min(c1, static_cast<int>(s.size())));
+                c1 = std::max(0, std::min(c1, s_len));
                 int hlen = std::max(0, std::min(c1, end_col) - start_col);
                 term.draw_highlighted(inner_row_off + i, inner_col_off + indent, vis, 0, hlen);
               } else if (line_idx > r0 && line_idx < r1) {
@@ -186,16 +191,14 @@ void Renderer::render(ITerminal& term,
               term.clear_to_eol(inner_row_off + i, inner_col_off + indent + (int)vis.size());
             }
           } else {
-            term.draw_text(inner_row_off + i, inner_col_off + indent, s.substr(start_col, end_col - start_col));
+            term.draw_text(inner_row_off + i, inner_col_off + indent, vis_line);
           }
         }
         auto is_ascii_line = [](const std::string& t){
           for (unsigned char c : t) { if (c >= 128) return false; }
           return true;
         };
-        std::string vis_line = s.substr(start_col, end_col - start_col);
-        auto draw_with_search_highlight = [&](const std::string& full_line, int row_screen, int start_col_full, int end_col_full){
-          (void)full_line;
+        auto draw_with_search_highlight = [&](int row_screen, int start_col_full, int end_col_full){
           std::vector<SearchHit> hits;
           for (const auto& h : search_hits) if (h.row == line_idx) hits.push_back(h);
           std::vector<SearchHit> vis_hits;
@@ -234,7 +237,7 @@ void Renderer::render(ITerminal& term,
         };
 
         if (!pane_visual && pane.is_active && !search_hits.empty()) {
-          draw_with_search_highlight(s, inner_row_off + i, start_col, end_col);
+          draw_with_search_highlight(inner_row_off + i, start_col, end_col);
         } else if (!pane_visual && enable_color && is_ascii_line(vis_line)) {
           auto isWord = [](unsigned char c){ return std::isalnum(c) != 0 || c == '_'; };
           int col = inner_col_off + indent;
@@ -269,8 +272,14 @@ void Renderer::render(ITerminal& term,
     std::ostringstream oss;
     oss << mode_str << "  "
         << (pane.file_path ? pane.file_path->string() : "[no file]")
-        << (pane.modified ? " [+]" : "")
-        << "  row:" << (cur.row + 1) << " col:" << (cur.col + 1);
+        << (pane.modified ? " [+]" : "") << (pane.read_only ? " [view]" : "");
+    if (pane.load_percent >= 0) oss << "  [loading " << pane.load_percent << "%]";
+    oss << "  row:" << (cur.row + 1) << " col:" << (cur.col + 1);
+    size_t total_bytes = buf.fast_measures() ? buf.byte_count() : 0;
+    if (total_bytes > 0) {
+      size_t at = std::min(total_bytes, buf.row_to_byte(cur.row) + static_cast<size_t>(std::max(0, cur.col)));
+      oss << "  " << (at * 100 / total_bytes) << "% " << total_bytes << "B";
+    }
     if (pane.is_active && !message.empty() && mode != Mode::Command) oss << "  | " << message;
     std::string command_str = ":";
     if(mode == Mode::Command && pane.is_active && (cmdline.size()>0 && (cmdline[0]=='/'||cmdline[0]=='?'))){
@@ -287,7 +296,7 @@ void Renderer::render(ITerminal& term,
     int screen_row = cur.row - vp.top_line;
     if (pane.is_active && screen_row >= 0 && screen_row < max_text_rows) {
       int want_col = cur.col;
-      int line_len = (cur.row == insert_override_row) ? (int)insert_override_line.size() : (int)buf.line(cur.row).size();
+      int line_len = buf.line_length(cur.row);
       if (want_col > line_len) want_col = line_len;
       int screen_col = indent + std::max(0, want_col - std::max(0, vp.left_col));
       screen_col = std::min(screen_col, inner_cols - 1);
@@ -20,10 +20,11 @@ struct PaneRenderInfo {
   Viewport* vp = nullptr;
   std::optional<std::filesystem::path> file_path;
   bool modified = false;
+  bool read_only = false;
+  /*percent of the file loaded while it streams in, else -1*/
+  int load_percent = -1;
   bool is_active = false;
   Rect area{};
-  int override_row = -1;
-  std::string override_line;
 };
 
 class Renderer {
@@ -1,210 +1,427 @@
 #include "rope_text_buffer_core.hpp"
 #include <algorithm>
+#include <iterator>
 #include <numeric>
+#include <utility>
+#include "utf8.hpp"
+#include "task_pool.hpp"
 
-static constexpr size_t LEAF_MAX_LINES = 128;
+RopeTextBufferCore::RopeTextBufferCore(RopeTextBufferCore&& o) noexcept
+  : pool_(std::move(o.pool_)), root_(std::exchange(o.root_, nullptr)), spare_lines_(std::move(o.spare_lines_)),
+    hot_(std::move(o.hot_)), hot_row_(std::exchange(o.hot_row_, -1)), hot_base_bytes_(o.hot_base_bytes_),
+    hot_base_chars_(o.hot_base_chars_), hot_chars_(o.hot_chars_) {}
+
+RopeTextBufferCore& RopeTextBufferCore::operator=(RopeTextBufferCore&& o) noexcept {
+  if (this != &o) {
+    pool_ = std::move(o.pool_);
+    root_ = std::exchange(o.root_, nullptr);
+    spare_lines_ = std::move(o.spare_lines_);
+    hot_ = std::move(o.hot_);
+    hot_row_ = std::exchange(o.hot_row_, -1);
+    hot_base_bytes_ = o.hot_base_bytes_;
+    hot_base_chars_ = o.hot_base_chars_;
+    hot_chars_ = o.hot_chars_;
+  }
+  return *this;
+}
 
 void RopeTextBufferCore::recalc(Node* n) {
   if (!n) return;
-  size_t l = count_lines(n->left.get());
-  size_t r = count_lines(n->right.get());
-  size_t self = n->lines.size();
-  n->lines_count = l + r + self;
-  n->height = 1 + std::max(node_height(n->left.get()), node_height(n->right.get()));
-}
-
-std::unique_ptr<RopeTextBufferCore::Node> RopeTextBufferCore::rotate_left(std::unique_ptr<Node> x) {
-  auto y = std::move(x->right);
-  auto T2 = std::move(y->left);
-  y->left = std::move(x);
-  y->left->right = std::move(T2);
-  recalc(y->left.get());
-  recalc(y.get());
+  if (is_leaf(n)) {
+    // a leaf's stats cost O(leaf bytes), same order as the edit that changed it
+    n->lines_count = n->lines.size();
+    n->bytes = n->lines.bytes();
+    n->chars = n->lines.codepoints();
+    n->max_line = n->lines.max_line();
+    n->height = 1;
+    return;
+  }
+  n->lines_count = count_lines(n->left) + count_lines(n->right);
+  n->bytes = count_bytes(n->left) + count_bytes(n->right);
+  n->chars = count_chars(n->left) + count_chars(n->right);
+  n->max_line = std::max(n->left ? n->left->max_line : 0, n->right ? n->right->max_line : 0);
+  n->height = 1 + std::max(node_height(n->left), node_height(n->right));
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::rotate_left(Node* x) {
+  Node* y = x->right;
+  x->right = y->left;
+  y->left = x;
+  recalc(x);
+  recalc(y);
   return y;
 }
 
-std::unique_ptr<RopeTextBufferCore::Node> RopeTextBufferCore::rotate_right(std::unique_ptr<Node> y) {
-  auto x = std::move(y->left);
-  auto T2 = std::move(x->right);
-  x->right = std::move(y);
-  x->right->left = std::move(T2);
-  recalc(x->right.get());
-  recalc(x.get());
+RopeTextBufferCore::Node* RopeTextBufferCore::rotate_right(Node* y) {
+  Node* x = y->left;
+  y->left = x->right;
+  x->right = y;
+  recalc(y);
+  recalc(x);
   return x;
 }
 
-std::unique_ptr<RopeTextBufferCore::Node> RopeTextBufferCore::balance(std::unique_ptr<Node> n) {
+RopeTextBufferCore::Node* RopeTextBufferCore::balance(Node* n) {
   if (!n) return n;
-  recalc(n.get());
-  int bf = balance_factor(n.get());
+  recalc(n);
+  int bf = balance_factor(n);
   if (bf > 1) { // left heavy
-    if (balance_factor(n->left.get()) < 0) {
-      n->left = rotate_left(std::move(n->left));
+    if (balance_factor(n->left) < 0) {
+      n->left = rotate_left(n->left);
     }
-    return rotate_right(std::move(n));
+    return rotate_right(n);
   } else if (bf < -1) { // right heavy
-    if (balance_factor(n->right.get()) > 0) {
-      n->right = rotate_right(std::move(n->right));
+    if (balance_factor(n->right) > 0) {
+      n->right = rotate_right(n->right);
     }
-    return rotate_left(std::move(n));
+    return rotate_left(n);
   }
   return n;
 }
 
-std::unique_ptr<RopeTextBufferCore::Node> RopeTextBufferCore::make_leaf(std::vector<std::string>&& lines) {
-  auto n = std::make_unique<Node>();
-  n->lines = std::move(lines);
-  recalc(n.get());
+RopeTextBufferCore::Node* RopeTextBufferCore::new_leaf() {
+  Node* n = pool_.acquire();
+  if (!spare_lines_.empty()) {
+    n->lines.swap(spare_lines_.back());
+    spare_lines_.pop_back();
+  }
+  return n;
+}
+
+void RopeTextBufferCore::free_node(Node* n) {
+  n->left = n->right = nullptr;
+  n->lines_count = n->bytes = n->chars = n->max_line = 0;
+  n->height = 1;
+  if (n->lines.capacity_bytes() != 0) {
+    n->lines.clear();
+    if (spare_lines_.size() < SPARE_LEAVES) { spare_lines_.emplace_back(); spare_lines_.back().swap(n->lines); }
+    else n->lines = PackedLines();
+  }
+  pool_.release(n);
+}
+
+void RopeTextBufferCore::free_tree(Node* n) {
+  if (!n) return;
+  free_tree(n->left);
+  free_tree(n->right);
+  free_node(n);
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::make_leaf(PackedLines&& lines) {
+  Node* n = pool_.acquire();
+  n->lines.swap(lines);
+  recalc(n);
   return n;
 }
 
-std::unique_ptr<RopeTextBufferCore::Node> RopeTextBufferCore::concat(std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+RopeTextBufferCore::Node* RopeTextBufferCore::make_internal(Node* a, Node* b) {
+  Node* p = pool_.acquire();
+  p->left = a;
+  p->right = b;
+  recalc(p);
+  return p;
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::join(Node* a, Node* b) {
+  if (!a) return b;
+  if (!b) return a;
+  int ha = node_height(a);
+  int hb = node_height(b);
+  if (ha > hb + 1) { // walk down the right spine of a until heights match
+    a->right = join(a->right, b);
+    return balance(a);
+  }
+  if (hb > ha + 1) {
+    b->left = join(a, b->left);
+    return balance(b);
+  }
+  return make_internal(a, b);
+}
+
+void RopeTextBufferCore::fix_left_spine(Node* n) {
+  if (!n || is_leaf(n)) { recalc(n); return; }
+  fix_left_spine(n->left);
+  recalc(n);
+}
+
+void RopeTextBufferCore::fix_right_spine(Node* n) {
+  if (!n || is_leaf(n)) { recalc(n); return; }
+  fix_right_spine(n->right);
+  recalc(n);
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::pop_leftmost(Node* n, PackedLines& out) {
+  if (is_leaf(n)) { out.swap(n->lines); free_node(n); return nullptr; }
+  n->left = pop_leftmost(n->left, out);
+  if (!n->left) { Node* r = n->right; free_node(n); return r; }
+  return balance(n);
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::concat(Node* a, Node* b) {
   if (!a) return b;
   if (!b) return a;
-  auto p = std::make_unique<Node>();
-  p->left = std::move(a);
-  p->right = std::move(b);
-  recalc(p.get());
-  return balance(std::move(p));
+  Node* la = a; while (!is_leaf(la)) la = la->right;
+  Node* lb = b; while (!is_leaf(lb)) lb = lb->left;
+  size_t sa = la->lines.size();
+  size_t sb = lb->lines.size();
+  if (sa >= LEAF_MIN_LINES && sb >= LEAF_MIN_LINES) return join(a, b);
+  if (sa + sb <= LEAF_MAX_LINES) {
+    // fold b's first leaf into a's last leaf
+    PackedLines moved;
+    b = pop_leftmost(b, moved);
+    la->lines.append(moved);
+    if (spare_lines_.size() < SPARE_LEAVES) { moved.clear(); spare_lines_.push_back(std::move(moved)); }
+    fix_right_spine(a);
+    return join(a, b);
+  }
+  // too many lines for one leaf: even them out
+  size_t keep = (sa + sb) / 2;
+  if (sa > keep) {
+    lb->lines.insert(0, la->lines, keep, sa);
+    la->lines.erase(keep, sa);
+  } else {
+    size_t take = keep - sa;
+    la->lines.append(lb->lines, 0, take);
+    lb->lines.erase(0, take);
+  }
+  fix_right_spine(a);
+  fix_left_spine(b);
+  return join(a, b);
 }
 
-std::pair<std::unique_ptr<RopeTextBufferCore::Node>, std::unique_ptr<RopeTextBufferCore::Node>>
-RopeTextBufferCore::split(std::unique_ptr<Node> n, size_t k) {
+std::pair<RopeTextBufferCore::Node*, RopeTextBufferCore::Node*> RopeTextBufferCore::split(Node* n, size_t k) {
   if (!n) return {nullptr, nullptr};
-  size_t left_count = count_lines(n->left.get());
+  if (k == 0) return {nullptr, n};
+  if (k >= n->lines_count) return {n, nullptr};
+  if (is_leaf(n)) {
+    Node* r = new_leaf();
+    r->lines.append(n->lines, k, n->lines.size());
+    n->lines.erase(k, n->lines.size());
+    recalc(n);
+    recalc(r);
+    return {n, r};
+  }
+  // the internal node itself is dissolved; its children are re-joined
+  Node* left = n->left;
+  Node* right = n->right;
+  size_t left_count = count_lines(left);
+  free_node(n);
   if (k < left_count) {
-    auto [a, b] = split(std::move(n->left), k);
-    n->left = std::move(b);
-    recalc(n.get());
-    return {std::move(a), balance(std::move(n))};
-  }
-  k -= left_count;
-  size_t self_count = n->lines.size();
-  if (k < self_count) {
-    std::vector<std::string> left_lines;
-    std::vector<std::string> right_lines;
-    left_lines.reserve(k);
-    right_lines.reserve(self_count - k);
-    for (size_t i = 0; i < self_count; ++i) {
-      if (i < k) left_lines.push_back(n->lines[i]); else right_lines.push_back(n->lines[i]);
-    }
-    auto a = make_leaf(std::move(left_lines));
-    auto rest = std::make_unique<Node>();
-    rest->right = std::move(n->right);
-    rest->left = make_leaf(std::move(right_lines));
-    recalc(rest.get());
-    return {std::move(a), balance(std::move(rest))};
-  }
-  k -= self_count;
-  auto [a, b] = split(std::move(n->right), k);
-  n->right = std::move(a);
-  recalc(n.get());
-  return {balance(std::move(n)), std::move(b)};
-}
-
-std::unique_ptr<RopeTextBufferCore::Node>
-RopeTextBufferCore::build_balanced(const std::vector<std::string>& lines, size_t l, size_t r) {
-  size_t len = r - l;
-  if (len == 0) return nullptr;
-  if (len <= 128) {
-    std::vector<std::string> leaf;
-    leaf.reserve(len);
-    for (size_t i = l; i < r; ++i) leaf.push_back(lines[i]);
-    return make_leaf(std::move(leaf));
-  }
-  size_t mid = l + len / 2;
-  auto left = build_balanced(lines, l, mid);
-  auto right = build_balanced(lines, mid, r);
-  return concat(std::move(left), std::move(right));
-}
-
-std::unique_ptr<RopeTextBufferCore::Node>
-RopeTextBufferCore::build_balanced_parallel(const std::vector<std::string>& lines, size_t l, size_t r) {
-  size_t len = r - l;
-  if (len <= 4096) return build_balanced(lines, l, r);
-  size_t mid = l + len / 2;
-  auto fut_left = std::async(std::launch::async, [&]{ return build_balanced(lines, l, mid); });
-  auto right = build_balanced(lines, mid, r);
-  auto left = fut_left.get();
-  return concat(std::move(left), std::move(right));
-}
-
-std::string RopeTextBufferCore::get_line_at(const Node* n, size_t r) {
+    auto [a, b] = split(left, k);
+    return {a, join(b, right)};
+  }
+  if (k == left_count) return {left, right};
+  auto [a, b] = split(right, k - left_count);
+  return {join(left, a), b};
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::insert_at(Node* n, size_t row, std::string_view s) {
+  if (is_leaf(n)) {
+    n->lines.insert(row, s);
+    if (n->lines.size() <= LEAF_MAX_LINES) { recalc(n); return n; }
+    size_t mid = n->lines.size() / 2;
+    Node* r = new_leaf();
+    r->lines.append(n->lines, mid, n->lines.size());
+    n->lines.erase(mid, n->lines.size());
+    recalc(n);
+    recalc(r);
+    return make_internal(n, r);
+  }
+  size_t lc = count_lines(n->left);
+  if (row < lc) n->left = insert_at(n->left, row, s);
+  else n->right = insert_at(n->right, row - lc, s);
+  return balance(n);
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::erase_at(Node* n, size_t row) {
+  if (is_leaf(n)) {
+    n->lines.erase(row);
+    if (n->lines.empty()) { free_node(n); return nullptr; }
+    recalc(n);
+    return n;
+  }
+  size_t lc = count_lines(n->left);
+  if (row < lc) {
+    n->left = erase_at(n->left, row);
+    if (!n->left) { Node* r = n->right; free_node(n); return r; }
+  } else {
+    n->right = erase_at(n->right, row - lc);
+    if (!n->right) { Node* l = n->left; free_node(n); return l; }
+  }
+  bool left_small = is_leaf(n->left) && n->left->lines.size() < LEAF_MIN_LINES;
+  bool right_small = is_leaf(n->right) && n->right->lines.size() < LEAF_MIN_LINES;
+  if (left_small || right_small) {
+    Node* l = n->left;
+    Node* r = n->right;
+    free_node(n);
+    return concat(l, r);
+  }
+  return balance(n);
+}
+
+/*
+  n lines into leaves of LEAF_MAX_LINES/2..LEAF_MAX_LINES lines: leaf i gets
+  lines [i*n/g, (i+1)*n/g), packed by fill(leaf, b, e), in parallel when big
+*/
+template <typename Fill>
+static std::vector<PackedLines> cut_even(size_t n, Fill&& fill) {
+  size_t g = (n + RopeTextBufferCore::LEAF_MAX_LINES - 1) / RopeTextBufferCore::LEAF_MAX_LINES;
+  std::vector<PackedLines> leaves(g);
+  // 64 leaves a task: 8192 lines, below which forking costs more than it saves
+  parallel_for(0, g, 64, [&](size_t i) { fill(leaves[i], i * n / g, (i + 1) * n / g); });
+  return leaves;
+}
+
+std::vector<PackedLines> RopeTextBufferCore::cut_leaves(std::span<const std::string> lines, std::span<std::string> consume) {
+  return cut_even(lines.size(), [&](PackedLines& leaf, size_t b, size_t e) {
+    leaf.assign(lines.subspan(b, e - b));
+    if (!consume.empty()) for (size_t j = b; j < e; ++j) std::string().swap(consume[j]);
+  });
+}
+
+RopeTextBufferCore::Node* RopeTextBufferCore::build_balanced(std::vector<PackedLines>& leaves, size_t l, size_t r) {
+  if (l >= r) return nullptr;
+  if (r - l == 1) return make_leaf(std::move(leaves[l]));
+  size_t mid = l + (r - l) / 2;
+  Node* left = build_balanced(leaves, l, mid);
+  Node* right = build_balanced(leaves, mid, r);
+  return join(left, right);
+}
+
+std::string_view RopeTextBufferCore::line_at(const Node* n, size_t r) {
   const Node* cur = n;
   size_t idx = r;
   while (cur) {
-    size_t lc = count_lines(cur->left.get());
-    if (idx < lc) { cur = cur->left.get(); continue; }
+    size_t lc = count_lines(cur->left);
+    if (idx < lc) { cur = cur->left; continue; }
     idx -= lc;
     size_t self = cur->lines.size();
     if (idx < self) { return cur->lines[idx]; }
     idx -= self;
-    cur = cur->right.get();
+    cur = cur->right;
   }
-  return std::string();
+  return {};
 }
 
+void RopeTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
+  // the old tree goes away with its slabs, no node-by-node frees
+  root_ = nullptr;
+  hot_row_ = -1;
+  pool_.clear();
+  spare_lines_.clear();
+  if (lines.empty()) return;
+  auto leaves = cut_leaves(lines);
+  root_ = build_balanced(leaves, 0, leaves.size());
+}
 
-std::unique_ptr<RopeTextBufferCore::Node>
-RopeTextBufferCore::normalize_node(std::unique_ptr<Node> n) {
-  if (!n) return nullptr;
-  if (n->left.get() == nullptr && n->right.get() == nullptr) {
-    size_t sz = n->lines.size();
-    if (sz <= LEAF_MAX_LINES) { recalc(n.get()); return n; }
-    size_t mid = sz / 2;
-    std::vector<std::string> left_lines; left_lines.reserve(mid);
-    std::vector<std::string> right_lines; right_lines.reserve(sz - mid);
-    for (size_t i = 0; i < sz; ++i) {
-      if (i < mid) left_lines.push_back(n->lines[i]); else right_lines.push_back(n->lines[i]);
-    }
-    auto L = make_leaf(std::move(left_lines));
-    auto R = make_leaf(std::move(right_lines));
-    return balance(concat(std::move(L), std::move(R)));
-  }
-
-  n->left = normalize_node(std::move(n->left));
-  n->right = normalize_node(std::move(n->right));
-
-  if (n->left && n->right && n->left->left.get() == nullptr && n->left->right.get() == nullptr && n->right->left.get() == nullptr && n->right->right.get() == nullptr) {
-    size_t lsz = n->left->lines.size();
-    size_t rsz = n->right->lines.size();
-    if (lsz + rsz <= LEAF_MAX_LINES) {
-      std::vector<std::string> merged; merged.reserve(lsz + rsz);
-      for (auto& s : n->left->lines) merged.push_back(std::move(s));
-      for (auto& s : n->right->lines) merged.push_back(std::move(s));
-      auto leaf = make_leaf(std::move(merged));
-      return leaf;
-    }
-  }
-
-  recalc(n.get());
-  return balance(std::move(n));
+void RopeTextBufferCore::init_from_arena(const LineArena& arena) {
+  root_ = nullptr;
+  hot_row_ = -1;
+  pool_.clear();
+  spare_lines_.clear();
+  if (arena.size() == 0) return;
+  auto leaves = cut_even(arena.size(), [&](PackedLines& leaf, size_t b, size_t e) { leaf.assign(arena, b, e); });
+  root_ = build_balanced(leaves, 0, leaves.size());
 }
 
-void RopeTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
-  if (lines.empty()) { root_.reset(); return; }
-  root_ = build_balanced_parallel(lines, 0, lines.size());
-  root_ = normalize_node(std::move(root_));
+void RopeTextBufferCore::adopt_lines(std::vector<std::string>&& lines) {
+  root_ = nullptr;
+  hot_row_ = -1;
+  pool_.clear();
+  spare_lines_.clear();
+  if (!lines.empty()) {
+    auto leaves = cut_leaves(lines, lines);
+    root_ = build_balanced(leaves, 0, leaves.size());
+  }
+  std::vector<std::string>().swap(lines);
 }
 
-int RopeTextBufferCore::line_count() const { return static_cast<int>(count_lines(root_.get())); }
+int RopeTextBufferCore::line_count() const { return static_cast<int>(count_lines(root_)); }
 
 std::string RopeTextBufferCore::get_line(int r) const {
-  if (r < 0) return std::string();
+  std::string scratch;
+  return std::string(get_line_view(r, scratch));
+}
+
+std::string_view RopeTextBufferCore::get_line_view(int r, std::string& scratch) const {
+  if (r < 0) return {};
+  if (is_hot(r)) return hot_view(scratch);
   size_t rr = static_cast<size_t>(r);
-  if (rr >= count_lines(root_.get())) return std::string();
-  return get_line_at(root_.get(), rr);
+  if (rr >= count_lines(root_)) return {};
+  return line_at(root_, rr);
+}
+
+size_t RopeTextBufferCore::line_length(int r) const {
+  if (is_hot(r)) return hot_.length();
+  if (r < 0 || static_cast<size_t>(r) >= count_lines(root_)) return 0;
+  return line_at(root_, static_cast<size_t>(r)).size();
+}
+
+void RopeTextBufferCore::load_hot(size_t row) {
+  std::string_view line = line_at(root_, row);
+  hot_.clear();
+  hot_.insert_text(line);
+  hot_row_ = static_cast<int>(row);
+  hot_base_bytes_ = line.size();
+  hot_base_chars_ = hot_chars_ = utf8_length(line);
+}
+
+void RopeTextBufferCore::fold() {
+  if (hot_row_ < 0) return;
+  // gap to the end, so the line is one contiguous run
+  hot_.move_gap_to(hot_.length());
+  std::string scratch;
+  replace_at(root_, static_cast<size_t>(hot_row_), hot_view(scratch));
+  hot_row_ = -1;
+}
+
+void RopeTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= count_lines(root_) || s.empty()) return;
+  if (!is_hot(static_cast<int>(row))) { fold(); load_hot(row); }
+  hot_.move_gap_to(std::min(col, hot_.length()));
+  hot_.insert_text(s);
+  hot_chars_ += utf8_length(s);
+}
+
+void RopeTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= count_lines(root_)) return;
+  if (!is_hot(static_cast<int>(row))) { fold(); load_hot(row); }
+  size_t n = hot_.length();
+  if (col >= n || len == 0) return;
+  len = std::min(len, n - col);
+  std::string scratch;
+  hot_chars_ -= utf8_length(hot_.view(col, len, scratch));
+  hot_.erase_range(col, len);
+}
+
+void RopeTextBufferCore::split_line(size_t row, size_t col) {
+  if (row >= count_lines(root_)) return;
+  fold();
+  std::string_view line = line_at(root_, row);
+  col = std::min(col, line.size());
+  // copy the tail out first, the view dies with the leaf edit
+  std::string tail(line.substr(col));
+  std::string head(line.substr(0, col));
+  replace_at(root_, row, head);
+  root_ = insert_at(root_, row + 1, tail);
+}
+
+void RopeTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= count_lines(root_)) return;
+  fold();
+  std::string joined(line_at(root_, row));
+  joined += line_at(root_, row + 1);
+  replace_at(root_, row, joined);
+  root_ = erase_at(root_, row + 1);
 }
 
 void RopeTextBufferCore::insert_line(size_t row, const std::string& s) { insert_line(row, std::string_view(s)); }
 
 void RopeTextBufferCore::insert_line(size_t row, std::string_view s) {
-  size_t L = count_lines(root_.get()); if (row > L) row = L;
-  auto [A, B] = split(std::move(root_), row);
-  std::vector<std::string> single{std::string(s)};
-  auto M = make_leaf(std::move(single));
-  root_ = concat(concat(std::move(A), std::move(M)), std::move(B));
-  root_ = normalize_node(std::move(root_));
+  fold();
+  if (!root_) { root_ = new_leaf(); root_->lines.push_back(s); recalc(root_); return; }
+  size_t L = count_lines(root_); if (row > L) row = L;
+  root_ = insert_at(root_, row, s);
 }
 
 void RopeTextBufferCore::insert_lines(size_t row, const std::vector<std::string>& ss) {
@@ -213,41 +430,199 @@ void RopeTextBufferCore::insert_lines(size_t row, const std::vector<std::string>
 
 void RopeTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
   if (ss.empty()) return;
-  size_t L = count_lines(root_.get()); if (row > L) row = L;
-  auto [A, B] = split(std::move(root_), row);
-  // build M in parallel if large
-  std::vector<std::string> temp; temp.reserve(ss.size()); for (const auto& s : ss) temp.push_back(s);
-  auto M = (ss.size() >= 4096) ? build_balanced_parallel(temp, 0, temp.size()) : build_balanced(temp, 0, temp.size());
-  root_ = concat(concat(std::move(A), std::move(M)), std::move(B));
-  root_ = normalize_node(std::move(root_));
+  fold();
+  size_t L = count_lines(root_); if (row > L) row = L;
+  auto [A, B] = split(root_, row);
+  auto leaves = cut_leaves(ss);
+  Node* M = build_balanced(leaves, 0, leaves.size());
+  root_ = concat(concat(A, M), B);
 }
 
 void RopeTextBufferCore::erase_line(size_t row) {
-  size_t L = count_lines(root_.get()); if (row >= L) return;
-  auto [A, B] = split(std::move(root_), row);
-  auto [M, C] = split(std::move(B), 1);
-  root_ = concat(std::move(A), std::move(C));
-  root_ = normalize_node(std::move(root_));
+  fold();
+  size_t L = count_lines(root_); if (row >= L) return;
+  root_ = erase_at(root_, row);
 }
 
 void RopeTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
-  size_t L = count_lines(root_.get());
+  fold();
+  size_t L = count_lines(root_);
   if (end_row < start_row) end_row = start_row;
   if (start_row >= L) return; if (end_row > L) end_row = L;
-  auto [A, B] = split(std::move(root_), start_row);
-  auto [M, C] = split(std::move(B), end_row - start_row);
-  root_ = concat(std::move(A), std::move(C));
-  root_ = normalize_node(std::move(root_));
+  auto [A, B] = split(root_, start_row);
+  auto [M, C] = split(B, end_row - start_row);
+  free_tree(M);
+  root_ = concat(A, C);
+}
+
+/*cut the rows out and build their replacement in one balanced subtree*/
+void RopeTextBufferCore::replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+  fold();
+  size_t L = count_lines(root_);
+  start_row = std::min(start_row, L);
+  end_row = std::clamp(end_row, start_row, L);
+  auto [A, B] = split(root_, start_row);
+  auto [M, C] = split(B, end_row - start_row);
+  free_tree(M);
+  if (!ss.empty()) {
+    auto leaves = cut_leaves(ss);
+    A = concat(A, build_balanced(leaves, 0, leaves.size()));
+  }
+  root_ = concat(A, C);
 }
 
 void RopeTextBufferCore::replace_line(size_t row, const std::string& s) { replace_line(row, std::string_view(s)); }
 
 void RopeTextBufferCore::replace_line(size_t row, std::string_view s) {
-  size_t L = count_lines(root_.get()); if (row >= L) return;
-  auto [A, B] = split(std::move(root_), row);
-  auto [M, C] = split(std::move(B), 1);
-  std::vector<std::string> single{std::string(s)};
-  auto M2 = make_leaf(std::move(single));
-  root_ = concat(concat(std::move(A), std::move(M2)), std::move(C));
-  root_ = normalize_node(std::move(root_));
+  size_t L = count_lines(root_); if (row >= L) return;
+  // the hot copy of this row is overwritten anyway, no need to fold it
+  if (is_hot(static_cast<int>(row))) hot_row_ = -1;
+  else fold();
+  replace_at(root_, row, s);
+}
+
+void RopeTextBufferCore::replace_at(Node* n, size_t row, std::string_view s) {
+  // line counts are unchanged, so the shape stays: overwrite the line in
+  // place inside the leaf's block and refresh the byte aggregates on the way up
+  if (is_leaf(n)) {
+    // adjust the leaf stats by the difference instead of rescanning the block
+    std::string_view prev = n->lines[row];
+    size_t prev_size = prev.size();
+    n->chars = n->chars - utf8_length(prev) + utf8_length(s);
+    n->lines.replace(row, s);
+    n->bytes = n->lines.bytes();
+    if (s.size() >= n->max_line) n->max_line = s.size();
+    else if (prev_size == n->max_line) n->max_line = n->lines.max_line();
+    return;
+  }
+  size_t lc = count_lines(n->left);
+  if (row < lc) replace_at(n->left, row, s);
+  else replace_at(n->right, row - lc, s);
+  recalc(n);
+}
+
+size_t RopeTextBufferCore::byte_count() const {
+  size_t L = count_lines(root_);
+  if (L == 0) return 0;
+  size_t n = count_bytes(root_) + L - 1;
+  return hot_row_ < 0 ? n : n + hot_.length() - hot_base_bytes_;
+}
+
+size_t RopeTextBufferCore::char_count() const {
+  size_t L = count_lines(root_);
+  if (L == 0) return 0;
+  size_t n = count_chars(root_) + L - 1;
+  return hot_row_ < 0 ? n : n + hot_chars_ - hot_base_chars_;
+}
+
+size_t RopeTextBufferCore::max_line_length() const {
+  if (!root_) return 0;
+  if (hot_row_ < 0) return root_->max_line;
+  if (hot_.length() >= hot_base_bytes_) return std::max(root_->max_line, hot_.length());
+  // a shrunk hot line may have been the longest one: ask the tree for the longest of the others
+  return std::max(max_line_except(root_, static_cast<size_t>(hot_row_)), hot_.length());
+}
+
+size_t RopeTextBufferCore::max_line_except(const Node* n, size_t row) {
+  if (is_leaf(n)) {
+    size_t m = 0;
+    for (size_t i = 0; i < n->lines.size(); ++i)
+      if (i != row) m = std::max(m, n->lines[i].size());
+    return m;
+  }
+  size_t lc = count_lines(n->left);
+  if (row < lc) return std::max(max_line_except(n->left, row), n->right->max_line);
+  return std::max(n->left->max_line, max_line_except(n->right, row - lc));
+}
+
+size_t RopeTextBufferCore::row_to_byte(int r) const {
+  if (r <= 0) return 0;
+  size_t L = count_lines(root_);
+  if (static_cast<size_t>(r) >= L) return byte_count();
+  size_t idx = static_cast<size_t>(r);
+  size_t off = 0;
+  const Node* cur = root_;
+  while (!is_leaf(cur)) {
+    size_t lc = count_lines(cur->left);
+    if (idx < lc) cur = cur->left;
+    else { off += span_bytes(cur->left); idx -= lc; cur = cur->right; }
+  }
+  off += cur->lines.offset(idx) + idx;
+  // rows below the hot line move by its growth, which the tree doesn't know about yet
+  if (hot_row_ >= 0 && r > hot_row_) off = off + hot_.length() - hot_base_bytes_;
+  return off;
+}
+
+std::pair<int, size_t> RopeTextBufferCore::byte_to_row(size_t off) const {
+  if (!root_) return {0, 0};
+  if (off > byte_count()) off = byte_count();
+  if (hot_row_ < 0) return tree_byte_to_row(off);
+  // the tree is right up to the hot line's start; past its end it is off by the line's growth
+  size_t start = row_to_byte(hot_row_), len = hot_.length();
+  if (off < start) return tree_byte_to_row(off);
+  if (off <= start + len) return {hot_row_, off - start};
+  return tree_byte_to_row(off - len + hot_base_bytes_);
+}
+
+std::pair<int, size_t> RopeTextBufferCore::tree_byte_to_row(size_t off) const {
+  size_t row = 0;
+  const Node* cur = root_;
+  while (!is_leaf(cur)) {
+    size_t lb = span_bytes(cur->left);
+    if (off < lb) cur = cur->left;
+    else { off -= lb; row += count_lines(cur->left); cur = cur->right; }
+  }
+  // off is now relative to the leaf, whose line i starts at offset(i) + i
+  size_t i = 0;
+  while (i + 1 < cur->lines.size() && cur->lines.offset(i + 1) + i + 1 <= off) ++i;
+  return {static_cast<int>(row + i), off - cur->lines.offset(i) - i};
+}
+
+size_t RopeTextBufferCore::leaf_count() const {
+  size_t leaves = 0;
+  std::vector<const Node*> stack;
+  if (root_) stack.push_back(root_);
+  while (!stack.empty()) {
+    const Node* n = stack.back(); stack.pop_back();
+    if (is_leaf(n)) { leaves++; continue; }
+    stack.push_back(n->left);
+    stack.push_back(n->right);
+  }
+  return leaves;
+}
+
+bool RopeTextBufferCore::check_invariants(std::string* why) const {
+  // the hot line's stale copy is still a consistent part of the tree: check it as it is
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  if (hot_row_ >= 0 && static_cast<size_t>(hot_row_) >= count_lines(root_)) return fail("hot row past the end");
+  size_t leaves = 0;
+  bool ok = true;
+  auto walk = [&](auto&& self, const Node* n) -> void {
+    if (!ok) return;
+    if (is_leaf(n)) {
+      leaves++;
+      if (n->lines.empty() || n->lines.size() > LEAF_MAX_LINES) ok = fail("leaf size out of bounds");
+      else if (n->lines_count != n->lines.size() || n->height != 1) ok = fail("bad leaf aggregates");
+      else if (n->bytes != n->lines.bytes() || n->chars != n->lines.codepoints() || n->max_line != n->lines.max_line()) ok = fail("bad leaf byte aggregates");
+      return;
+    }
+    if (!n->left || !n->right) { ok = fail("internal node with one child"); return; }
+    if (!n->lines.empty()) { ok = fail("internal node holds lines"); return; }
+    self(self, n->left);
+    self(self, n->right);
+    if (!ok) return;
+    if (n->lines_count != n->left->lines_count + n->right->lines_count) ok = fail("bad lines_count");
+    else if (n->bytes != n->left->bytes + n->right->bytes || n->chars != n->left->chars + n->right->chars) ok = fail("bad byte aggregates");
+    else if (n->max_line != std::max(n->left->max_line, n->right->max_line)) ok = fail("bad max_line");
+    else if (n->height != 1 + std::max(n->left->height, n->right->height)) ok = fail("bad height");
+    else if (std::abs(balance_factor(n)) > 1) ok = fail("AVL balance violated");
+  };
+  if (!root_) return true;
+  walk(walk, root_);
+  if (!ok) return false;
+  // an AVL tree of height h has at least fib(h + 1) leaves
+  size_t a = 1, b = 1;
+  for (int h = 1; h < root_->height; ++h) { size_t c = a + b; a = b; b = c; }
+  if (leaves < b) return fail("height exceeds AVL bound");
+  return true;
 }
@@ -1,18 +1,50 @@
 #pragma once
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
 #include <string_view>
 #include <span>
-#include <future>
 #include "i_text_buffer_core.hpp"
+#include "node_pool.hpp"
+#include "packed_lines.hpp"
+#include "gap_buffer.hpp"
+#include "avl_line_cursor.hpp"
 
+/*
+  rope backend: AVL tree whose leaves hold up to LEAF_MAX lines, packed
+  into one contiguous block per leaf.
+  edits descend to the touched leaf or use join/split, so every
+  operation is O(log n) (plus the size of the edit itself).
+  nodes also aggregate bytes, UTF-8 codepoints and the longest line, so
+  document size, byte <-> row conversion and scroll bounds are O(log n).
+  typing goes through insert_text/erase_text, which keep the line under
+  edit in a gap buffer and leave its leaf untouched until the next
+  structural edit folds it back. queries work around the hot line and
+  never fold, so const calls leave the tree alone.
+  nodes live in a per-core slab pool and are recycled, so edits don't hit
+  malloc for every node and dropping the buffer frees whole slabs.
+*/
 class RopeTextBufferCore : public TextBufferCoreCRTP<RopeTextBufferCore> {
 public:
   static constexpr std::string_view get_name_sv() { return "rope"; }
+  static constexpr size_t LEAF_MAX_LINES = 128;
+  static constexpr size_t LEAF_MIN_LINES = LEAF_MAX_LINES / 4;
+  static constexpr size_t SPARE_LEAVES = 64; /* recycled leaf vectors kept around */
+
+  RopeTextBufferCore() = default;
+  RopeTextBufferCore(RopeTextBufferCore&& o) noexcept;
+  RopeTextBufferCore& operator=(RopeTextBufferCore&& o) noexcept;
+
   void init_from_lines(const std::vector<std::string>& lines);
+  /*leaves are packed, so lines are still copied, but each is freed once its leaf is built*/
+  void adopt_lines(std::vector<std::string>&& lines);
+  /*leaves are cut straight out of the arena*/
+  void init_from_arena(const LineArena& arena);
   int line_count() const;
   std::string get_line(int r) const;
+  std::string_view get_line_view(int r, std::string& scratch) const;
+  size_t line_length(int r) const;
 
   void insert_line(size_t row, const std::string& s);
   void insert_line(size_t row, std::string_view s);
@@ -22,11 +54,33 @@ public:
   void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
   void replace_line(size_t row, const std::string& s);
   void replace_line(size_t row, std::string_view s);
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss);
+
+  /*edits inside one line: O(1) amortized while they stay on the same row*/
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col);
+  void join_lines(size_t row);
+
+  /*debug: verify AVL balance, aggregates, leaf sizes and the height bound*/
+  bool check_invariants(std::string* why = nullptr) const;
+  int height() const { return node_height(root_); }
+  size_t leaf_count() const;
+
+  size_t byte_count() const;
+  size_t char_count() const;
+  size_t max_line_length() const;
+  size_t row_to_byte(int r) const;
+  std::pair<int, size_t> byte_to_row(size_t off) const;
 
   /*forward to CRTP impl*/
   void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_adopt_lines(std::vector<std::string>&& lines) { adopt_lines(std::move(lines)); }
+  void do_init_from_arena(const LineArena& arena) { init_from_arena(arena); }
   int do_line_count() const { return line_count(); }
   std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  size_t do_line_length(int r) const { return line_length(r); }
   void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
   void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
   void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
@@ -35,33 +89,113 @@ public:
   void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
   void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
   void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+  size_t do_byte_count() const { return byte_count(); }
+  size_t do_char_count() const { return char_count(); }
+  size_t do_max_line_length() const { return max_line_length(); }
+  size_t do_row_to_byte(int r) const { return row_to_byte(r); }
+  std::pair<int, size_t> do_byte_to_row(size_t off) const { return byte_to_row(off); }
 
 private:
+  /*
+    leaves: no children, 1..LEAF_MAX_LINES lines, height 1.
+    internal nodes: always two children, no lines.
+  */
   struct Node {
-    std::unique_ptr<Node> left;
-    std::unique_ptr<Node> right;
-    std::vector<std::string> lines; /* non-empty only for leaves */
+    Node* left = nullptr;
+    Node* right = nullptr;
+    PackedLines lines;              /* non-empty only for leaves */
     size_t lines_count = 0;         /* aggregated number of lines */
+    size_t bytes = 0;               /* aggregated line bytes, no '\n' */
+    size_t chars = 0;               /* aggregated UTF-8 codepoints, no '\n' */
+    size_t max_line = 0;            /* longest line below, in bytes */
     int height = 1;                 /* AVL height */
   };
-  std::unique_ptr<Node> root_;
+  NodePool<Node> pool_;
+  Node* root_ = nullptr;
+  std::vector<PackedLines> spare_lines_; /* cleared leaf storage */
+
+  /*
+    the line under edit. its copy in the leaf is stale while hot_row_ >= 0:
+    readers of that row go to hot_, and the tree's byte/char aggregates are
+    off by the hot line's growth until fold() writes it back.
+  */
+  GapBuffer hot_;
+  int hot_row_ = -1;
+  size_t hot_base_bytes_ = 0; /* size of the stale copy in the leaf */
+  size_t hot_base_chars_ = 0;
+  size_t hot_chars_ = 0;
+  void load_hot(size_t row);
+  /*write the hot line back into its leaf; only edits do this*/
+  void fold();
+  bool is_hot(int r) const { return r == hot_row_; }
+  std::string_view hot_view(std::string& scratch) const { return hot_.view(0, hot_.length(), scratch); }
 
+  static bool is_leaf(const Node* n) { return !n->left && !n->right; }
   static size_t count_lines(const Node* n) { return n ? n->lines_count : 0; }
+  static size_t count_bytes(const Node* n) { return n ? n->bytes : 0; }
+  static size_t count_chars(const Node* n) { return n ? n->chars : 0; }
+  /*bytes a subtree spans in the saved text, one '\n' per line*/
+  static size_t span_bytes(const Node* n) { return count_bytes(n) + count_lines(n); }
   static int node_height(const Node* n) { return n ? n->height : 0; }
-  static int balance_factor(const Node* n) { return n ? (node_height(n->left.get()) - node_height(n->right.get())) : 0; }
+  static int balance_factor(const Node* n) { return n ? (node_height(n->left) - node_height(n->right)) : 0; }
   static void recalc(Node* n);
-  static std::unique_ptr<Node> rotate_left(std::unique_ptr<Node> x);
-  static std::unique_ptr<Node> rotate_right(std::unique_ptr<Node> y);
-  static std::unique_ptr<Node> balance(std::unique_ptr<Node> n);
-
-  static std::unique_ptr<Node> make_leaf(std::vector<std::string>&& lines);
-  static std::unique_ptr<Node> concat(std::unique_ptr<Node> a, std::unique_ptr<Node> b);
-  static std::pair<std::unique_ptr<Node>, std::unique_ptr<Node>> split(std::unique_ptr<Node> n, size_t k);
-  static std::unique_ptr<Node> build_balanced(const std::vector<std::string>& lines, size_t l, size_t r);
-  static std::unique_ptr<Node> build_balanced_parallel(const std::vector<std::string>& lines, size_t l, size_t r);
-  static std::string get_line_at(const Node* n, size_t r);
-
-  static std::unique_ptr<Node> normalize_node(std::unique_ptr<Node> n);
+  static Node* rotate_left(Node* x);
+  static Node* rotate_right(Node* y);
+  static Node* balance(Node* n);
+
+  /*pool plumbing: fresh leaves reuse spare line blocks, freed ones give theirs back*/
+  Node* new_leaf();
+  void free_node(Node* n);
+  void free_tree(Node* n);
+
+  Node* make_leaf(PackedLines&& lines);
+  Node* make_internal(Node* a, Node* b);
+  /*height-aware join: O(|h(a) - h(b)|), keeps the result balanced*/
+  Node* join(Node* a, Node* b);
+  /*join that also merges/rebalances the two leaves meeting at the seam*/
+  Node* concat(Node* a, Node* b);
+  std::pair<Node*, Node*> split(Node* n, size_t k);
+  Node* pop_leftmost(Node* n, PackedLines& out);
+  static void fix_left_spine(Node* n);
+  static void fix_right_spine(Node* n);
+  Node* insert_at(Node* n, size_t row, std::string_view s);
+  Node* erase_at(Node* n, size_t row);
+  static void replace_at(Node* n, size_t row, std::string_view s);
+  /*longest line below n other than its row-th one*/
+  static size_t max_line_except(const Node* n, size_t row);
+  /*byte_to_row on the tree alone, as if there were no hot line*/
+  std::pair<int, size_t> tree_byte_to_row(size_t off) const;
+  Node* build_balanced(std::vector<PackedLines>& leaves, size_t l, size_t r);
+  /*pack lines into evenly sized leaf blocks, in parallel for big inputs*/
+  /*consume: free each string as soon as its leaf holds a copy*/
+  static std::vector<PackedLines> cut_leaves(std::span<const std::string> lines, std::span<std::string> consume = {});
+  static std::string_view line_at(const Node* n, size_t r);
+
+public:
+  /*AVL cursor that reads the hot line from the gap buffer*/
+  class LineCursor : public AvlLineCursor<Node> {
+  public:
+    LineCursor(const RopeTextBufferCore& core, int r) : AvlLineCursor<Node>(core.root_, r), core_(&core) {}
+    std::string_view view(std::string& scratch) const {
+      return core_->is_hot(row()) ? core_->hot_view(scratch) : AvlLineCursor<Node>::view(scratch);
+    }
+    size_t length() const { return core_->is_hot(row()) ? core_->hot_.length() : AvlLineCursor<Node>::length(); }
+    std::string slice(size_t col, size_t len) const {
+      if (!core_->is_hot(row())) return AvlLineCursor<Node>::slice(col, len);
+      size_t n = core_->hot_.length();
+      return col < n ? core_->hot_.slice(col, std::min(len, n - col)) : std::string();
+    }
+
+  private:
+    const RopeTextBufferCore* core_;
+  };
+  LineCursor line_cursor(int r) const { return LineCursor(*this, r); }
+  LineCursor do_line_cursor(int r) const { return line_cursor(r); }
 };
 
 static_assert(TextBufferCoreCRTPConcept<RopeTextBufferCore>, "Rope backend must satisfy CRTP concept");
@@ -0,0 +1,53 @@
+#include "spill_file.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+char* SpillFile::allocate(size_t n) {
+  if (n > SEGMENT) return nullptr;
+  if (used_ + n > SEGMENT) {
+    if (!fd_.valid()) {
+      const char* dir = std::getenv("TMPDIR");
+      std::string tmpl = std::string(dir && *dir ? dir : "/tmp") + "/mvim-spill-XXXXXX";
+      fd_.reset(::mkstemp(tmpl.data()));
+      if (!fd_.valid()) return nullptr;
+      // nobody else needs the name: the file goes away with the descriptor
+      ::unlink(tmpl.c_str());
+    }
+    off_t end = static_cast<off_t>(bytes());
+    if (::ftruncate(fd_.get(), end + static_cast<off_t>(SEGMENT)) != 0) return nullptr;
+    void* mem = ::mmap(nullptr, SEGMENT, PROT_READ | PROT_WRITE, MAP_SHARED, fd_.get(), end);
+    if (mem == MAP_FAILED) {
+      (void)::ftruncate(fd_.get(), end);
+      return nullptr;
+    }
+    segments_.emplace_back(static_cast<char*>(mem));
+    used_ = 0;
+  }
+  char* at = segments_.back().get() + used_;
+  used_ += n;
+  return at;
+}
+
+void SpillFile::page_out(size_t keep) {
+  size_t hot = std::max<size_t>(keep / SEGMENT, 1);
+  for (size_t i = paged_; i + hot < segments_.size(); ++i) {
+    char* p = segments_[i].get();
+#ifdef MADV_PAGEOUT
+    // write back and free now, instead of when the kernel gets round to it
+    (void)::madvise(p, SEGMENT, MADV_PAGEOUT);
+#endif
+    // a shared mapping keeps dirty data in the page cache; this only unmaps it from us
+    (void)::madvise(p, SEGMENT, MADV_DONTNEED);
+  }
+  paged_ = std::max(paged_, segments_.size() - std::min(hot, segments_.size()));
+}
+
+void SpillFile::clear() {
+  segments_.clear();
+  used_ = SEGMENT;
+  paged_ = 0;
+  if (fd_.valid()) (void)::ftruncate(fd_.get(), 0);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <sys/mman.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "posix_fd.hpp"
+
+/*
+  scratch space on disk for bytes that need not stay in memory: an
+  unlinked temp file under $TMPDIR (/tmp without it), handed out in blocks
+  carved from shared mappings of SEGMENT bytes each. blocks never move.
+  page_out gives the older segments back to the kernel, which writes them
+  to the file and reads them in again when they are next touched.
+*/
+class SpillFile {
+public:
+  static constexpr size_t SEGMENT = 4 * 1024 * 1024;
+
+  /*a new block of n bytes (n <= SEGMENT), or nullptr when the file cannot be made or grown*/
+  char* allocate(size_t n);
+  /*
+    drop every segment from memory but the newest ones that fit in keep
+    bytes, at least one. segments dropped by an earlier call are skipped,
+    so each one is advised once however many times this runs.
+  */
+  void page_out(size_t keep);
+  /*bytes of the file handed out in segments so far*/
+  size_t bytes() const { return segments_.size() * SEGMENT; }
+  /*unmap everything and truncate the file, for a fresh start*/
+  void clear();
+
+private:
+  struct Unmap {
+    void operator()(char* p) const { ::munmap(p, SEGMENT); }
+  };
+  UniqueFd fd_;
+  std::vector<std::unique_ptr<char, Unmap>> segments_;
+  size_t used_ = SEGMENT; /* bytes handed out of the last segment */
+  size_t paged_ = 0;      /* segments [0, paged_) were already paged out */
+};
@@ -0,0 +1,105 @@
+#include "task_pool.hpp"
+#include <chrono>
+#include <utility>
+
+namespace {
+/*the pool whose worker this thread is, and its queue there*/
+thread_local const TaskPool* tl_pool = nullptr;
+thread_local size_t tl_queue = 0;
+}  // namespace
+
+TaskPool& TaskPool::instance() {
+  static TaskPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+  return pool;
+}
+
+TaskPool::TaskPool(unsigned workers) {
+  for (unsigned i = 0; i <= workers; ++i) queues_.push_back(std::make_unique<Queue>());
+  threads_.reserve(workers);
+  for (unsigned i = 0; i < workers; ++i) threads_.emplace_back([this, i] { worker_loop(i); });
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lk(sleep_mu_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+void TaskPool::push(Task t) {
+  Queue& q = tl_pool == this ? *queues_[tl_queue] : *queues_.back();
+  {
+    std::lock_guard<std::mutex> lk(q.mu);
+    q.tasks.push_back(std::move(t));
+  }
+  queued_.fetch_add(1, std::memory_order_release);
+  { std::lock_guard<std::mutex> lk(sleep_mu_); }
+  sleep_cv_.notify_one();
+}
+
+bool TaskPool::try_run_one() {
+  Task t;
+  bool found = false;
+  size_t self = tl_pool == this ? tl_queue : queues_.size() - 1;
+  {
+    // newest first from our own queue: it is the one still warm in cache
+    Queue& q = *queues_[self];
+    std::lock_guard<std::mutex> lk(q.mu);
+    if (!q.tasks.empty()) { t = std::move(q.tasks.back()); q.tasks.pop_back(); found = true; }
+  }
+  for (size_t k = 1; !found && k < queues_.size(); ++k) {
+    // oldest first from the others: the biggest pieces of their work
+    Queue& q = *queues_[(self + k) % queues_.size()];
+    std::lock_guard<std::mutex> lk(q.mu);
+    if (!q.tasks.empty()) { t = std::move(q.tasks.front()); q.tasks.pop_front(); found = true; }
+  }
+  if (!found) return false;
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  std::exception_ptr error;
+  try { t.fn(); } catch (...) { error = std::current_exception(); }
+  t.group->finish(error);
+  return true;
+}
+
+void TaskPool::worker_loop(unsigned i) {
+  tl_pool = this;
+  tl_queue = i;
+  for (;;) {
+    if (try_run_one()) continue;
+    std::unique_lock<std::mutex> lk(sleep_mu_);
+    sleep_cv_.wait(lk, [&] { return stop_ || queued_.load(std::memory_order_acquire) > 0; });
+    if (stop_) return;
+  }
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  if (pool_.workers() == 0) {
+    // nobody else could pick it up before wait() anyway
+    std::exception_ptr error;
+    try { fn(); } catch (...) { error = std::current_exception(); }
+    finish(error);
+    return;
+  }
+  pool_.push({std::move(fn), this});
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+  // decrement under the lock, so wait() cannot return while we still touch the group
+  std::lock_guard<std::mutex> lk(done_mu_);
+  if (error && !error_) error_ = error;
+  if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) done_cv_.notify_all();
+}
+
+void TaskGroup::wait() {
+  while (!done()) {
+    if (pool_.try_run_one()) continue;
+    // our last tasks are running elsewhere; wake up now and then to help with any they fork
+    std::unique_lock<std::mutex> lk(done_mu_);
+    done_cv_.wait_for(lk, std::chrono::microseconds(200), [&] { return done(); });
+  }
+  std::lock_guard<std::mutex> lk(done_mu_);
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
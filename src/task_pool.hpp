@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+/*
+  process-wide work-stealing pool for fork/join work: one worker per core
+  but the caller's. each worker pushes and pops its own deque at the back
+  and steals from the front of the others'; tasks forked from threads
+  outside the pool go to a shared queue. a thread waiting on a TaskGroup
+  runs queued tasks instead of blocking, so nested groups cannot deadlock
+  and with no workers everything runs inline on the caller.
+*/
+class TaskPool {
+public:
+  static TaskPool& instance();
+  explicit TaskPool(unsigned workers);
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+  ~TaskPool();
+
+  unsigned workers() const { return static_cast<unsigned>(threads_.size()); }
+  /*threads that can run tasks at once: the workers plus a waiting caller*/
+  unsigned concurrency() const { return workers() + 1; }
+
+private:
+  friend class TaskGroup;
+  struct Task {
+    std::function<void()> fn;
+    TaskGroup* group = nullptr;
+  };
+  struct Queue {
+    std::mutex mu;
+    std::deque<Task> tasks;
+  };
+  void push(Task t);
+  /*pop from this thread's own queue, else steal; false when every queue is empty*/
+  bool try_run_one();
+  void worker_loop(unsigned i);
+
+  std::vector<std::unique_ptr<Queue>> queues_; /* one per worker, the shared one last */
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> queued_{0};
+  std::mutex sleep_mu_;
+  std::condition_variable sleep_cv_;
+  bool stop_ = false;
+};
+
+/*
+  fork/join handle: run() forks a task into the pool, wait() joins all of
+  them and rethrows the first exception one threw. the destructor waits
+  too, so tasks may capture locals of the forking frame by reference.
+*/
+class TaskGroup {
+public:
+  explicit TaskGroup(TaskPool& pool = TaskPool::instance()) : pool_(pool) {}
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+  ~TaskGroup() { try { wait(); } catch (...) {} }
+
+  void run(std::function<void()> fn);
+  void wait();
+  /*every forked task has finished; never blocks*/
+  bool done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class TaskPool;
+  void finish(std::exception_ptr error);
+
+  TaskPool& pool_;
+  std::atomic<size_t> pending_{0};
+  std::mutex done_mu_;
+  std::condition_variable done_cv_;
+  std::exception_ptr error_;
+};
+
+/*fn(i) for every i in [begin, end), in chunks of at least grain indices spread over the pool*/
+template <typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& fn, TaskPool& pool = TaskPool::instance()) {
+  if (end <= begin) return;
+  size_t n = end - begin;
+  // a few chunks per thread, so stealing can even out uneven ones
+  size_t chunks = std::min<size_t>(n / std::max<size_t>(grain, 1), size_t(pool.concurrency()) * 4);
+  if (chunks <= 1 || pool.workers() == 0) {
+    for (size_t i = begin; i < end; ++i) fn(i);
+    return;
+  }
+  auto range = [&](size_t c) {
+    for (size_t i = begin + c * n / chunks; i < begin + (c + 1) * n / chunks; ++i) fn(i);
+  };
+  TaskGroup g(pool);
+  for (size_t c = 1; c < chunks; ++c) g.run([&range, c] { range(c); });
+  range(0);
+  g.wait();
+}
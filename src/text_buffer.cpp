@@ -1,10 +1,12 @@
 #include "text_buffer.hpp"
+#include <algorithm>
 #include <fstream>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstring>
 #include "posix_fd.hpp"
 #include <sys/stat.h>
+#include <type_traits>
 #include "file_reader.hpp"
 #include "config.hpp"
 #include "config.hpp"
@@ -12,65 +14,244 @@
 TextBuffer::TextBuffer() {}
 
 std::string_view TextBuffer::backend_name() const {
-  return core.get_name();
+  return std::visit([](const auto& c) { return c.get_name(); }, core);
+}
+
+std::string TextBuffer::backend_names() {
+  std::string names;
+  auto add = [&]<typename... Cs>(std::variant<Cs...>*) {
+    auto one = [&](std::string_view name, bool read_only) {
+      if (read_only) return;
+      if (!names.empty()) names += "|";
+      names += name;
+    };
+    (one(Cs::get_name_sv(), requires { Cs::read_only; }), ...);
+  };
+  add(static_cast<CoreVariant*>(nullptr));
+  return names;
+}
+
+std::string_view TextBuffer::auto_backend(size_t bytes, size_t lines, size_t longest) {
+#if TB_BACKEND == TB_BACKEND_AUTO
+  if (longest >= TB_AUTO_BYTEROPE_LINE_BYTES) return "byterope";
+  return bytes >= TB_AUTO_ROPE_BYTES || lines >= TB_AUTO_ROPE_LINES ? "rope" : "vector";
+#else
+  (void)bytes; (void)lines; (void)longest;
+  return TB_BACKEND_NAME;
+#endif
+}
+
+/*
+  find the alternative called name; when it is not the live one, rebuild it
+  from the current lines. a read-only core cannot be rebuilt into. a core
+  with a memory budget gets it before the lines, so they never sit in its heap.
+*/
+template <size_t I = 0>
+static bool migrate_core(TextBuffer::CoreVariant& core, std::string_view name, size_t budget) {
+  if constexpr (I < std::variant_size_v<TextBuffer::CoreVariant>) {
+    using C = std::variant_alternative_t<I, TextBuffer::CoreVariant>;
+    if (C::get_name_sv() != name) return migrate_core<I + 1>(core, name, budget);
+    if (core.index() == I) return true;
+    if constexpr (requires { C::read_only; }) return false;
+    std::vector<std::string> ls;
+    std::visit([&](const auto& c) {
+      ls.reserve(static_cast<size_t>(c.line_count()));
+      std::string scratch;
+      for (auto it = c.line_cursor(0); it.valid(); it.next()) ls.emplace_back(it.view(scratch));
+    }, core);
+    C& fresh = core.template emplace<I>();
+    if constexpr (requires { fresh.do_set_memory_budget(budget); }) {
+      if (budget > 0) fresh.do_set_memory_budget(budget);
+    }
+    fresh.adopt_lines(std::move(ls));
+    return true;
+  } else {
+    (void)core; (void)name; (void)budget;
+    return false;
+  }
+}
+
+bool TextBuffer::set_backend(std::string_view name, size_t memory_budget) {
+  if (!migrate_core(core, name, memory_budget)) return false;
+  ensure_not_empty();
+  return true;
 }
 
 bool TextBuffer::empty() const { return line_count() == 0; }
-int TextBuffer::line_count() const { return core.line_count(); }
-std::string TextBuffer::line(int r) const { return core.get_line(r); }
+int TextBuffer::line_count() const { return std::visit([](const auto& c) { return c.line_count(); }, core); }
+std::string TextBuffer::line(int r) const { return std::visit([r](const auto& c) { return c.get_line(r); }, core); }
+
+std::string_view TextBuffer::line_view(int r, std::string& scratch) const {
+  return std::visit([&](const auto& c) { return c.get_line_view(r, scratch); }, core);
+}
+
+int TextBuffer::line_length(int r) const {
+  return static_cast<int>(std::visit([r](const auto& c) { return c.line_length(r); }, core));
+}
+
+std::string TextBuffer::line_slice(int r, int col, int len) const {
+  if (col < 0 || len <= 0) return std::string();
+  return std::visit([&](const auto& c) { return c.line_slice(r, static_cast<size_t>(col), static_cast<size_t>(len)); }, core);
+}
+
+TextBuffer::LineCursor TextBuffer::line_cursor(int r) const {
+  return std::visit([r](const auto& c) { return LineCursor(c.line_cursor(r)); }, core);
+}
+
+size_t TextBuffer::byte_count() const { return std::visit([](const auto& c) { return c.byte_count(); }, core); }
+size_t TextBuffer::char_count() const { return std::visit([](const auto& c) { return c.char_count(); }, core); }
+
+int TextBuffer::max_line_length() const {
+  return static_cast<int>(std::visit([](const auto& c) { return c.max_line_length(); }, core));
+}
+
+size_t TextBuffer::row_to_byte(int r) const { return std::visit([r](const auto& c) { return c.row_to_byte(r); }, core); }
+
+Cursor TextBuffer::byte_to_cursor(size_t off) const {
+  auto [row, col] = std::visit([off](const auto& c) { return c.byte_to_row(off); }, core);
+  return Cursor{row, static_cast<int>(col)};
+}
+
+bool TextBuffer::fast_measures() const {
+  return std::visit([](const auto& c) { return has_fast_measures<std::decay_t<decltype(c)>>; }, core) ||
+         line_count() < TB_AUTO_ROPE_LINES;
+}
 
 void TextBuffer::ensure_not_empty() {
-  if (line_count() == 0) core.insert_line(static_cast<size_t>(0), std::string());
+  if (line_count() == 0) std::visit([](auto& c) { c.insert_line(static_cast<size_t>(0), std::string()); }, core);
 }
 
 void TextBuffer::init_from_lines(const std::vector<std::string>& src) {
-  core.init_from_lines(src);
+  std::visit([&](auto& c) { c.init_from_lines(src); }, core);
   ensure_not_empty();
 }
 
 void TextBuffer::init_from_lines(std::vector<std::string>&& src) {
-  core.init_from_lines(src);
+  std::visit([&](auto& c) { c.adopt_lines(std::move(src)); }, core);
+  ensure_not_empty();
+}
+
+void TextBuffer::init_from_arena(const LineArena& arena) {
+  std::visit([&](auto& c) { c.init_from_arena(arena); }, core);
   ensure_not_empty();
 }
 
 void TextBuffer::insert_line(int row, const std::string& s) {
-  core.insert_line(static_cast<size_t>(row), s);
+  std::visit([&](auto& c) { c.insert_line(static_cast<size_t>(row), s); }, core);
 }
 
 
 void TextBuffer::insert_lines(int row, const std::vector<std::string>& ss) {
-  core.insert_lines(static_cast<size_t>(row), ss);
+  std::visit([&](auto& c) { c.insert_lines(static_cast<size_t>(row), ss); }, core);
 }
 
 
 void TextBuffer::erase_line(int row) {
-  core.erase_line(static_cast<size_t>(row));
+  std::visit([&](auto& c) { c.erase_line(static_cast<size_t>(row)); }, core);
   ensure_not_empty();
 }
 
 void TextBuffer::erase_lines(int start_row, int end_row) {
-  core.erase_lines(static_cast<size_t>(start_row), static_cast<size_t>(end_row));
+  std::visit([&](auto& c) { c.erase_lines(static_cast<size_t>(start_row), static_cast<size_t>(end_row)); }, core);
   ensure_not_empty();
 }
 
 void TextBuffer::replace_line(int row, const std::string& s) {
-  core.replace_line(static_cast<size_t>(row), s);
+  std::visit([&](auto& c) { c.replace_line(static_cast<size_t>(row), s); }, core);
+}
+
+void TextBuffer::insert_text(int row, int col, std::string_view s) {
+  if (row < 0 || row >= line_count() || col < 0) return;
+  std::visit([&](auto& c) { c.insert_text(static_cast<size_t>(row), static_cast<size_t>(col), s); }, core);
+}
+
+void TextBuffer::erase_text(int row, int col, int len) {
+  if (row < 0 || row >= line_count() || col < 0 || len <= 0) return;
+  std::visit([&](auto& c) { c.erase_text(static_cast<size_t>(row), static_cast<size_t>(col), static_cast<size_t>(len)); }, core);
+}
+
+void TextBuffer::split_line(int row, int col) {
+  if (row < 0 || row >= line_count() || col < 0) return;
+  std::visit([&](auto& c) { c.split_line(static_cast<size_t>(row), static_cast<size_t>(col)); }, core);
+}
+
+void TextBuffer::join_lines(int row) {
+  if (row < 0 || row + 1 >= line_count()) return;
+  std::visit([&](auto& c) { c.join_lines(static_cast<size_t>(row)); }, core);
+}
+
+void TextBuffer::apply_edits(std::vector<LineEdit> edits) {
+  std::stable_sort(edits.begin(), edits.end(), [](const LineEdit& a, const LineEdit& b) { return a.row < b.row; });
+  size_t L = static_cast<size_t>(line_count()), end = 0, n = 0;
+  for (LineEdit& e : edits) {
+    if (e.row > L || e.row < end) continue;
+    e.erase = std::min(e.erase, L - e.row);
+    if (e.erase == 0 && e.lines.empty()) continue;
+    end = e.row + e.erase;
+    if (&edits[n] != &e) edits[n] = std::move(e);
+    ++n;
+  }
+  edits.resize(n);
+  std::visit([&](auto& c) { c.apply_edits(edits); }, core);
+  ensure_not_empty();
+}
+
+/*structural copy when the core supports it, otherwise rebuild from lines*/
+template <typename Core>
+static void copy_core(Core& dst, const Core& src) {
+  if constexpr (std::is_copy_assignable_v<Core>) {
+    dst = src;
+  } else {
+    std::vector<std::string> ls;
+    ls.reserve(static_cast<size_t>(src.line_count()));
+    std::string scratch;
+    for (auto it = src.line_cursor(0); it.valid(); it.next()) ls.emplace_back(it.view(scratch));
+    dst.adopt_lines(std::move(ls));
+  }
+}
+
+TextBuffer TextBuffer::snapshot() const {
+  TextBuffer t;
+  std::visit([&](const auto& c) { copy_core(t.core.template emplace<std::decay_t<decltype(c)>>(), c); }, core);
+  return t;
 }
 
 
 TextBuffer TextBuffer::from_file(const std::filesystem::path& path, std::string& msg, bool& ok) {
   TextBuffer b;
   ok = true;
-  std::vector<std::string> ls;
-  if (!mmap_readlines(path, ls, msg)) {
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+  // big files stay mapped; CRLF files and mapping failures take the copying read below
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (!ec && (TB_BACKEND == TB_BACKEND_PIECE || size >= TB_AUTO_PIECE_BYTES)) {
+    if (b.core.emplace<PieceTableTextBufferCore>().open_file(path, msg)) return b;
+  }
+#endif
+  LineArena arena;
+  if (!mmap_readarena(path, arena, msg)) {
     ok = false;
     b.ensure_not_empty();
     return b;
   }
-  b.init_from_lines(std::move(ls));
+  size_t longest = 0;
+  for (size_t i = 0; i < arena.size(); ++i) longest = std::max(longest, arena.end(i) - arena.start(i));
+  b.set_backend(auto_backend(arena.bytes() + arena.size(), arena.size(), longest));
+  b.init_from_arena(arena);
   return b;
 }
 
+bool TextBuffer::set_memory_budget(size_t bytes) {
+  return std::visit([bytes](auto& c) {
+    if constexpr (requires { c.do_set_memory_budget(bytes); }) {
+      c.do_set_memory_budget(bytes);
+      return true;
+    } else {
+      return false;
+    }
+  }, core);
+}
+
 bool TextBuffer::write_file(const std::filesystem::path& path, std::string& msg) const {
   std::filesystem::path tmp = path;
   tmp += ".tmp";
@@ -79,7 +260,6 @@ bool TextBuffer::write_file(const std::filesystem::path& path, std::string& msg)
     msg = std::string("write file failed: ") + tmp.string();
     return false;
   }
-  int n = line_count();
   std::vector<char> buf(static_cast<size_t>(TB_WRITE_CHUNK_SIZE));
   size_t used = 0;
   auto flush_buf = [&](int fd) -> bool {
@@ -105,36 +285,17 @@ bool TextBuffer::write_file(const std::filesystem::path& path, std::string& msg)
     }
     return true;
   };
-  for (int i = 0; i < n; ++i) {
-    std::string s = line(i);
-    bool need_nl = (i + 1 < n);
-    if (s.size() + (need_nl ? 1u : 0u) > buf.size() - used) {
-      if (used > 0) {
-        if (!flush_buf(ufd.get())) return false;
-      }
-      if (s.size() >= buf.size()) {
-        if (!write_span(ufd.get(), s.data(), s.size())) return false;
-        if (need_nl) {
-          char nl = '\n';
-          if (!write_span(ufd.get(), &nl, 1)) return false;
-        }
-        continue;
-      }
+  // the core hands over its text span by span: lines, or pieces of the mapping and the add buffer as they are
+  auto put = [&](std::string_view s) -> bool {
+    if (s.size() > buf.size() - used) {
+      if (used > 0 && !flush_buf(ufd.get())) return false;
+      if (s.size() >= buf.size()) return write_span(ufd.get(), s.data(), s.size());
     }
     std::memcpy(buf.data() + used, s.data(), s.size());
     used += s.size();
-    if (need_nl) {
-      if (used == buf.size()) {
-        if (!flush_buf(ufd.get())) return false;
-      }
-      if (used < buf.size()) {
-        buf[used++] = '\n';
-      } else {
-        char nl = '\n';
-        if (!write_span(ufd.get(), &nl, 1)) return false;
-      }
-    }
-  }
+    return true;
+  };
+  if (!std::visit([&](const auto& c) { return c.for_each_span(put); }, core)) return false;
   if (used > 0) {
     if (!flush_buf(ufd.get())) return false;
   }
@@ -147,6 +308,6 @@ bool TextBuffer::write_file(const std::filesystem::path& path, std::string& msg)
   std::error_code ec;
   std::filesystem::rename(tmp, path, ec);
   if (ec) { msg = std::string("write file failed: ") + path.string(); return false; }
-  msg = std::string("saved file: ") + path.string();
+  msg = std::string("saved file: ") + path.string() + " " + std::to_string(byte_count()) + "B";
   return true;
 }
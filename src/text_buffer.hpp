@@ -11,44 +11,160 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <variant>
 #include "i_text_buffer_core.hpp"
 #include "config.hpp"
-#if TB_BACKEND == TB_BACKEND_GAP
+#include "types.hpp"
+#if TB_BACKEND == TB_BACKEND_AUTO
+#include "vector_text_buffer_core.hpp"
+#include "gap_text_buffer_core.hpp"
+#include "rope_text_buffer_core.hpp"
+#include "persistent_rope_text_buffer_core.hpp"
+#include "btree_text_buffer_core.hpp"
+#include "byte_rope_text_buffer_core.hpp"
+#include "piece_table_text_buffer_core.hpp"
+#include "tiered_vector_text_buffer_core.hpp"
+#include "mapped_view_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_GAP
 #include "gap_text_buffer_core.hpp"
 #elif TB_BACKEND == TB_BACKEND_ROPE
 #include "rope_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_PROPE
+#include "persistent_rope_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_BTREE
+#include "btree_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_BYTEROPE
+#include "byte_rope_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_PIECE
+#include "piece_table_text_buffer_core.hpp"
+#elif TB_BACKEND == TB_BACKEND_TIERED
+#include "tiered_vector_text_buffer_core.hpp"
 #else
 #include "vector_text_buffer_core.hpp"
 #endif
 
+/*the line cursor of whichever core is live, one alternative per core*/
+template <typename Cores> struct CursorVariantOf;
+template <typename... Cs> struct CursorVariantOf<std::variant<Cs...>> {
+  using type = std::variant<decltype(std::declval<const Cs&>().line_cursor(0))...>;
+};
+
 class TextBuffer {
 public:
   TextBuffer();
-#if TB_BACKEND == TB_BACKEND_GAP
-  using CoreType = GapTextBufferCore;
+  /*
+    the cores this build can switch between; the first is the default.
+    with a fixed TB_BACKEND the variant has one alternative and every
+    visit is a direct call. the auto build also has the read-only view,
+    which documents are opened on but never switched to.
+  */
+#if TB_BACKEND == TB_BACKEND_AUTO
+  using CoreVariant = std::variant<VectorTextBufferCore, GapTextBufferCore, RopeTextBufferCore, PersistentRopeTextBufferCore, BTreeTextBufferCore, ByteRopeTextBufferCore, PieceTableTextBufferCore, TieredVectorTextBufferCore, MappedViewTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_GAP
+  using CoreVariant = std::variant<GapTextBufferCore>;
 #elif TB_BACKEND == TB_BACKEND_ROPE
-  using CoreType = RopeTextBufferCore;
+  using CoreVariant = std::variant<RopeTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_PROPE
+  using CoreVariant = std::variant<PersistentRopeTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_BTREE
+  using CoreVariant = std::variant<BTreeTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_BYTEROPE
+  using CoreVariant = std::variant<ByteRopeTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_PIECE
+  using CoreVariant = std::variant<PieceTableTextBufferCore>;
+#elif TB_BACKEND == TB_BACKEND_TIERED
+  using CoreVariant = std::variant<TieredVectorTextBufferCore>;
 #else
-  using CoreType = VectorTextBufferCore;
+  using CoreVariant = std::variant<VectorTextBufferCore>;
 #endif
-  static_assert(TextBufferCoreCRTPConcept<CoreType>, "Selected backend must satisfy CRTP concept");
-  CoreType core;
+  CoreVariant core;
 
   std::string_view backend_name() const;
+  /*names accepted by set_backend, separated by '|'*/
+  static std::string backend_names();
+  /*the backend a document of this size, and longest line in bytes, should start on*/
+  static std::string_view auto_backend(size_t bytes, size_t lines, size_t longest = 0);
+  /*
+    move the contents to another backend; false if this build has no
+    backend of that name, or it is read-only. a nonzero memory_budget is
+    set on a backend that takes one (see set_memory_budget) before the text
+    moves in, so the text goes straight to its spill file.
+  */
+  bool set_backend(std::string_view name, size_t memory_budget = 0);
   bool empty() const;
   int line_count() const;
   std::string line(int r) const;
+  /*borrowed line: valid until the buffer is edited or scratch is reused; const calls never invalidate it*/
+  std::string_view line_view(int r, std::string& scratch) const;
+  /*length / column window of a line, without copying the whole line on backends that support it*/
+  int line_length(int r) const;
+  std::string line_slice(int r, int col, int len) const;
+  /*sequential line access starting at row r, see TextBufferCoreCRTP::line_cursor*/
+  class LineCursor {
+  public:
+    template <typename C> explicit LineCursor(C c) : c_(std::move(c)) {}
+    bool valid() const { return std::visit([](const auto& c) { return c.valid(); }, c_); }
+    int row() const { return std::visit([](const auto& c) { return c.row(); }, c_); }
+    void seek(int r) { std::visit([r](auto& c) { c.seek(r); }, c_); }
+    void next() { std::visit([](auto& c) { c.next(); }, c_); }
+    void prev() { std::visit([](auto& c) { c.prev(); }, c_); }
+    std::string_view view(std::string& scratch) const { return std::visit([&](const auto& c) { return c.view(scratch); }, c_); }
+    size_t length() const { return std::visit([](const auto& c) { return static_cast<size_t>(c.length()); }, c_); }
+    std::string slice(size_t col, size_t len) const { return std::visit([&](const auto& c) { return c.slice(col, len); }, c_); }
+
+  private:
+    CursorVariantOf<CoreVariant>::type c_;
+  };
+  LineCursor line_cursor(int r) const;
+  /*size of the saved text, codepoints, longest line and byte <-> (row, col), see TextBufferCoreCRTP::byte_count*/
+  size_t byte_count() const;
+  size_t char_count() const;
+  int max_line_length() const;
+  size_t row_to_byte(int r) const;
+  Cursor byte_to_cursor(size_t off) const;
+  /*true when the measures above are cheap enough for every frame: O(log n) on the core, or few lines to scan*/
+  bool fast_measures() const;
   void ensure_not_empty();
 
   void init_from_lines(const std::vector<std::string>& lines);
   void init_from_lines(std::vector<std::string>&& lines);
+  void init_from_arena(const LineArena& arena);
 
   void insert_line(int row, const std::string& s);
   void insert_lines(int row, const std::vector<std::string>& ss);
   void erase_line(int row);
   void erase_lines(int start_row, int end_row);
   void replace_line(int row, const std::string& s);
+  /*in-line edits, done natively by every backend*/
+  void insert_text(int row, int col, std::string_view s);
+  void erase_text(int row, int col, int len);
+  /*split_line moves [col, end) of row onto a new row below; join_lines appends row + 1 to row*/
+  void split_line(int row, int col);
+  void join_lines(int row);
+  /*
+    a transaction of line edits in one pass over the core. rows refer to the
+    text before the batch; edits may come in any order, an edit overlapping
+    an earlier one is dropped.
+  */
+  void apply_edits(std::vector<LineEdit> edits);
+
+  /*
+    consistent read-only copy of the current contents, safe to read from
+    another thread while this buffer keeps changing. O(1) on the prope
+    backend (shared nodes); other backends fall back to a full copy.
+    const calls change no core's state, so several threads may also read
+    one buffer directly, as long as none of them edits it.
+  */
+  TextBuffer snapshot() const;
+
+  /*
+    cap the memory the document's edits may hold, spilling the rest to a
+    temp file; 0 lifts it. false when the backend has no such cap: only
+    the piece table keeps its edits apart from the mapped file.
+  */
+  bool set_memory_budget(size_t bytes);
 
   static TextBuffer from_file(const std::filesystem::path& path, std::string& msg, bool& ok);
+  /*stream the text to path through a temp file, without building it in memory*/
   bool write_file(const std::filesystem::path& path, std::string& msg) const;
 };
@@ -0,0 +1,260 @@
+#include "tiered_vector_text_buffer_core.hpp"
+#include <algorithm>
+
+void TieredVectorTextBufferCore::Ring::insert(size_t i, std::string s) {
+  if (i < size_ / 2) {
+    head_ = (head_ - 1) & mask_;
+    ++size_;
+    for (size_t j = 0; j < i; ++j) (*this)[j] = std::move((*this)[j + 1]);
+  } else {
+    ++size_;
+    for (size_t j = size_ - 1; j > i; --j) (*this)[j] = std::move((*this)[j - 1]);
+  }
+  (*this)[i] = std::move(s);
+}
+
+std::vector<std::string> TieredVectorTextBufferCore::Ring::pop_back_n(size_t q) {
+  std::vector<std::string> out(q);
+  for (size_t t = q; t-- > 0;) out[t] = pop_back();
+  return out;
+}
+
+void TieredVectorTextBufferCore::Ring::erase(size_t i) {
+  if (i < size_ / 2) {
+    for (size_t j = i; j > 0; --j) (*this)[j] = std::move((*this)[j - 1]);
+    (void)pop_front();
+  } else {
+    for (size_t j = i; j + 1 < size_; ++j) (*this)[j] = std::move((*this)[j + 1]);
+    (void)pop_back();
+  }
+}
+
+size_t TieredVectorTextBufferCore::shift_for(size_t n) {
+  size_t s = MIN_SHIFT;
+  while ((size_t(1) << (2 * s)) < n) ++s;
+  return s;
+}
+
+void TieredVectorTextBufferCore::push_back(std::string s) {
+  if (chunks_.empty() || chunks_.back().full()) chunks_.emplace_back(chunk_lines());
+  chunks_.back().push_back(std::move(s));
+  ++n_;
+}
+
+void TieredVectorTextBufferCore::insert_at(size_t row, std::string s) {
+  if (row >= n_) { push_back(std::move(s)); maybe_retier(); return; }
+  size_t k = row >> shift_;
+  Ring& c = chunks_[k];
+  if (!c.full()) {
+    c.insert(row & (chunk_lines() - 1), std::move(s));
+    ++n_;
+    maybe_retier();
+    return;
+  }
+  // the chunk's last line is carried to the front of the next one, and so on down
+  std::string carry = c.pop_back();
+  c.insert(row & (chunk_lines() - 1), std::move(s));
+  for (++k; k < chunks_.size(); ++k) {
+    Ring& d = chunks_[k];
+    if (!d.full()) { d.push_front(std::move(carry)); ++n_; maybe_retier(); return; }
+    std::string next = d.pop_back();
+    d.push_front(std::move(carry));
+    carry = std::move(next);
+  }
+  chunks_.emplace_back(chunk_lines()).push_back(std::move(carry));
+  ++n_;
+  maybe_retier();
+}
+
+void TieredVectorTextBufferCore::erase_at(size_t row) {
+  size_t k = row >> shift_;
+  chunks_[k].erase(row & (chunk_lines() - 1));
+  // refill from the front of each later chunk
+  for (++k; k < chunks_.size(); ++k) chunks_[k - 1].push_back(chunks_[k].pop_front());
+  if (chunks_.back().size() == 0) chunks_.pop_back();
+  --n_;
+  maybe_retier();
+}
+
+void TieredVectorTextBufferCore::truncate(size_t row) {
+  if (row >= n_) return;
+  size_t k = row >> shift_, i = row & (chunk_lines() - 1);
+  chunks_[k].truncate(i);
+  chunks_.erase(chunks_.begin() + static_cast<std::ptrdiff_t>(i == 0 ? k : k + 1), chunks_.end());
+  n_ = row;
+}
+
+bool TieredVectorTextBufferCore::carry_cheaper(size_t row, size_t m) const {
+  size_t later = chunks_.size() - (row >> shift_) - 1;
+  // a carried line is swapped, about three moves, where a shifted line is moved once
+  return m < chunk_lines() && chunk_lines() + 3 * m * later < n_ - row;
+}
+
+void TieredVectorTextBufferCore::insert_carry(size_t row, std::span<const std::string> ss) {
+  size_t k = row >> shift_;
+  Ring& c = chunks_[k];
+  // refill row's chunk with ss and its own tail; what no longer fits is carried on
+  std::vector<std::string> tail = c.pop_back_n(c.size() - (row & (chunk_lines() - 1)));
+  std::vector<std::string> carry;
+  auto put = [&](std::string s) { if (c.full()) carry.push_back(std::move(s)); else c.push_back(std::move(s)); };
+  for (const auto& s : ss) put(s);
+  for (auto& s : tail) put(std::move(s));
+  // each later ring takes the carry at its front and hands on as many lines from its back
+  for (++k; k < chunks_.size() && !carry.empty(); ++k) {
+    Ring& d = chunks_[k];
+    if (d.full()) {
+      d.rotate_back(carry.size());
+      for (size_t t = 0; t < carry.size(); ++t) std::swap(d[t], carry[t]);
+      continue;
+    }
+    size_t room = chunk_lines() - d.size();
+    std::vector<std::string> next = d.pop_back_n(carry.size() > room ? carry.size() - room : 0);
+    for (size_t q = carry.size(); q-- > 0;) d.push_front(std::move(carry[q]));
+    carry = std::move(next);
+  }
+  n_ += ss.size() - carry.size();
+  for (auto& s : carry) push_back(std::move(s));
+}
+
+void TieredVectorTextBufferCore::erase_carry(size_t row, size_t m) {
+  size_t end = std::min(n_, ((((row + m - 1) >> shift_) + 1) << shift_));
+  for (size_t r = row; r + m < end; ++r) at(r) = std::move(at(r + m));
+  if (end == n_) { truncate(n_ - m); return; }
+  // the m dead lines sit at the back of a full chunk; each later ring refills the one before it
+  size_t C = chunk_lines(), dead = (end - 1) >> shift_;
+  bool has_dead = true;
+  for (size_t k = dead + 1; k < chunks_.size() && has_dead; ++k) {
+    Ring& prev = chunks_[k - 1];
+    Ring& d = chunks_[k];
+    if (d.full()) {
+      d.rotate_fwd(m);
+      for (size_t t = C - m; t < C; ++t) std::swap(prev[t], d[t]);
+      dead = k;
+      continue;
+    }
+    size_t q = std::min(m, d.size());
+    for (size_t t = 0; t < q; ++t) prev[C - m + t] = d.pop_front();
+    prev.truncate(C - m + q);
+    has_dead = false;
+  }
+  if (has_dead) chunks_[dead].truncate(C - m);
+  if (chunks_.back().size() == 0) chunks_.pop_back();
+  n_ -= m;
+}
+
+void TieredVectorTextBufferCore::insert_shift(size_t row, std::span<const std::string> ss) {
+  size_t m = ss.size();
+  for (size_t t = 0; t < m; ++t) push_back(std::string());
+  for (size_t r = n_ - 1; r >= row + m; --r) at(r) = std::move(at(r - m));
+  for (size_t t = 0; t < m; ++t) at(row + t) = ss[t];
+}
+
+void TieredVectorTextBufferCore::erase_shift(size_t row, size_t m) {
+  for (size_t r = row; r + m < n_; ++r) at(r) = std::move(at(r + m));
+  truncate(n_ - m);
+}
+
+void TieredVectorTextBufferCore::maybe_retier() {
+  size_t want = shift_for(n_);
+  if (want <= shift_ + 1 && want + 1 >= shift_) return;
+  std::vector<std::string> all;
+  all.reserve(n_);
+  for (size_t r = 0; r < n_; ++r) all.push_back(std::move(at(r)));
+  chunks_.clear();
+  n_ = 0;
+  shift_ = want;
+  chunks_.reserve((all.size() >> shift_) + 1);
+  for (auto& s : all) push_back(std::move(s));
+}
+
+void TieredVectorTextBufferCore::init_from_lines(const std::vector<std::string>& lines) {
+  chunks_.clear();
+  n_ = 0;
+  shift_ = shift_for(lines.size());
+  chunks_.reserve((lines.size() >> shift_) + 1);
+  for (const auto& s : lines) push_back(s);
+}
+
+void TieredVectorTextBufferCore::adopt_lines(std::vector<std::string>&& lines) {
+  chunks_.clear();
+  n_ = 0;
+  shift_ = shift_for(lines.size());
+  chunks_.reserve((lines.size() >> shift_) + 1);
+  for (auto& s : lines) push_back(std::move(s));
+  std::vector<std::string>().swap(lines);
+}
+
+void TieredVectorTextBufferCore::insert_lines(size_t row, std::span<const std::string> ss) {
+  if (ss.empty()) return;
+  row = std::min(row, n_);
+  if (row == n_) for (const auto& s : ss) push_back(s);
+  else if (ss.size() == 1) insert_at(row, ss[0]);
+  else if (carry_cheaper(row, ss.size())) insert_carry(row, ss);
+  else insert_shift(row, ss);
+  maybe_retier();
+}
+
+void TieredVectorTextBufferCore::erase_lines(size_t start_row, size_t end_row) {
+  if (end_row < start_row) end_row = start_row;
+  start_row = std::min(start_row, n_);
+  end_row = std::min(end_row, n_);
+  size_t m = end_row - start_row;
+  if (m == 1) erase_at(start_row);
+  else if (m > 0) {
+    if (end_row == n_) truncate(start_row);
+    else if (carry_cheaper(start_row, m)) erase_carry(start_row, m);
+    else erase_shift(start_row, m);
+    maybe_retier();
+  }
+  if (n_ == 0) push_back(std::string());
+}
+
+/*overwrite the common prefix, then insert or erase the rest*/
+void TieredVectorTextBufferCore::replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+  start_row = std::min(start_row, n_);
+  end_row = std::clamp(end_row, start_row, n_);
+  size_t common = std::min(end_row - start_row, ss.size());
+  for (size_t i = 0; i < common; ++i) at(start_row + i) = ss[i];
+  if (common < ss.size()) insert_lines(start_row + common, ss.subspan(common));
+  else erase_lines(start_row + common, end_row);
+}
+
+void TieredVectorTextBufferCore::insert_text(size_t row, size_t col, std::string_view s) {
+  if (row >= n_) return;
+  std::string& l = at(row);
+  l.insert(std::min(col, l.size()), s);
+}
+
+void TieredVectorTextBufferCore::erase_text(size_t row, size_t col, size_t len) {
+  if (row >= n_ || col >= at(row).size()) return;
+  at(row).erase(col, len);
+}
+
+void TieredVectorTextBufferCore::split_line(size_t row, size_t col) {
+  if (row >= n_) return;
+  std::string& l = at(row);
+  col = std::min(col, l.size());
+  std::string tail(l, col);
+  l.erase(col);
+  insert_at(row + 1, std::move(tail));
+}
+
+void TieredVectorTextBufferCore::join_lines(size_t row) {
+  if (row + 1 >= n_) return;
+  at(row) += at(row + 1);
+  erase_at(row + 1);
+}
+
+bool TieredVectorTextBufferCore::check_invariants(std::string* why) const {
+  auto fail = [&](const char* m) { if (why) *why = m; return false; };
+  size_t total = 0;
+  for (size_t k = 0; k < chunks_.size(); ++k) {
+    if (k + 1 < chunks_.size() && !chunks_[k].full()) return fail("chunk before the last is not full");
+    if (chunks_[k].size() == 0) return fail("empty chunk");
+    total += chunks_[k].size();
+  }
+  if (total != n_) return fail("line count mismatch");
+  size_t want = shift_for(n_);
+  if (want > shift_ + 1 || want + 1 < shift_) return fail("chunk size far from sqrt(n)");
+  return true;
+}
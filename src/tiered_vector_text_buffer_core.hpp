@@ -0,0 +1,127 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <span>
+#include "i_text_buffer_core.hpp"
+
+/*
+  tiered vector backend: lines live in fixed-capacity ring buffers
+  (chunks) of C lines each, all full except the last. row r is
+  chunks_[r / C][r % C], so reads are two indexings like the vector. an
+  insert or erase shifts inside one chunk and then carries one line
+  through each later chunk's ring in O(1), O(C + n / C) in all; C tracks
+  sqrt(n) and all chunks are rebuilt once it is 4x off.
+*/
+class TieredVectorTextBufferCore : public TextBufferCoreCRTP<TieredVectorTextBufferCore> {
+public:
+  static constexpr std::string_view get_name_sv() { return "tiered"; }
+  /*smallest chunk is 1 << MIN_SHIFT lines*/
+  static constexpr size_t MIN_SHIFT = 6;
+
+  void init_from_lines(const std::vector<std::string>& lines);
+  void adopt_lines(std::vector<std::string>&& lines);
+  int line_count() const { return static_cast<int>(n_); }
+  std::string get_line(int r) const { if (r < 0 || static_cast<size_t>(r) >= n_) return std::string(); return at(static_cast<size_t>(r)); }
+  std::string_view get_line_view(int r, std::string&) const { if (r < 0 || static_cast<size_t>(r) >= n_) return {}; return at(static_cast<size_t>(r)); }
+
+  void insert_line(size_t row, const std::string& s) { insert_at(row, s); }
+  void insert_line(size_t row, std::string_view s) { insert_at(row, std::string(s)); }
+  void insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, std::span<const std::string>(ss.begin(), ss.end())); }
+  void insert_lines(size_t row, std::span<const std::string> ss);
+  void erase_line(size_t row) { erase_lines(row, row + 1); }
+  void erase_lines(size_t start_row, size_t end_row); // end_row exclusive
+  void replace_line(size_t row, const std::string& s) { if (row < n_) at(row) = s; }
+  void replace_line(size_t row, std::string_view s) { if (row < n_) at(row).assign(s); }
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss);
+
+  void insert_text(size_t row, size_t col, std::string_view s);
+  void erase_text(size_t row, size_t col, size_t len);
+  void split_line(size_t row, size_t col);
+  void join_lines(size_t row);
+
+  size_t chunk_lines() const { return size_t(1) << shift_; }
+  /*debug: every chunk but the last is full, counts agree, chunk size fits n*/
+  bool check_invariants(std::string* why = nullptr) const;
+
+  /*forward to CRTP impl*/
+  void do_init_from_lines(const std::vector<std::string>& lines) { init_from_lines(lines); }
+  void do_adopt_lines(std::vector<std::string>&& lines) { adopt_lines(std::move(lines)); }
+  int do_line_count() const { return line_count(); }
+  std::string do_get_line(int r) const { return get_line(r); }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
+  void do_insert_line(size_t row, const std::string& s) { insert_line(row, s); }
+  void do_insert_line(size_t row, std::string_view s) { insert_line(row, s); }
+  void do_insert_lines(size_t row, const std::vector<std::string>& ss) { insert_lines(row, ss); }
+  void do_insert_lines(size_t row, std::span<const std::string> ss) { insert_lines(row, ss); }
+  void do_erase_line(size_t row) { erase_line(row); }
+  void do_erase_lines(size_t start_row, size_t end_row) { erase_lines(start_row, end_row); }
+  void do_replace_line(size_t row, const std::string& s) { replace_line(row, s); }
+  void do_replace_line(size_t row, std::string_view s) { replace_line(row, s); }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+
+private:
+  /*ring of 2^k lines; insert/erase move whichever side of i is shorter*/
+  class Ring {
+  public:
+    explicit Ring(size_t cap) : slot_(std::make_unique<std::string[]>(cap)), mask_(cap - 1) {}
+    /*copies come out unrotated, so snapshot() is a plain copy of the core*/
+    Ring(const Ring& o) : Ring(o.mask_ + 1) { for (size_t i = 0; i < o.size_; ++i) push_back(o[i]); }
+    Ring& operator=(const Ring& o) { Ring t(o); std::swap(*this, t); return *this; }
+    Ring(Ring&&) noexcept = default;
+    Ring& operator=(Ring&&) noexcept = default;
+    size_t size() const { return size_; }
+    bool full() const { return size_ == mask_ + 1; }
+    std::string& operator[](size_t i) { return slot_[(head_ + i) & mask_]; }
+    const std::string& operator[](size_t i) const { return slot_[(head_ + i) & mask_]; }
+    void push_back(std::string s) { slot_[(head_ + size_) & mask_] = std::move(s); ++size_; }
+    void push_front(std::string s) { head_ = (head_ - 1) & mask_; slot_[head_] = std::move(s); ++size_; }
+    std::string pop_back() { --size_; return std::move(slot_[(head_ + size_) & mask_]); }
+    std::string pop_front() { std::string s = std::move(slot_[head_]); head_ = (head_ + 1) & mask_; --size_; return s; }
+    void insert(size_t i, std::string s);
+    void erase(size_t i);
+    void truncate(size_t n) { while (size_ > n) (void)pop_back(); }
+    /*the last q lines, in order*/
+    std::vector<std::string> pop_back_n(size_t q);
+    /*full rings only: turn the ring so its last q lines come first (back) or its first q come last (fwd)*/
+    void rotate_back(size_t q) { head_ = (head_ - q) & mask_; }
+    void rotate_fwd(size_t q) { head_ = (head_ + q) & mask_; }
+
+  private:
+    std::unique_ptr<std::string[]> slot_;
+    size_t mask_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+  };
+  std::vector<Ring> chunks_;
+  size_t n_ = 0;
+  size_t shift_ = MIN_SHIFT;
+
+  std::string& at(size_t r) { return chunks_[r >> shift_][r & (chunk_lines() - 1)]; }
+  const std::string& at(size_t r) const { return chunks_[r >> shift_][r & (chunk_lines() - 1)]; }
+  /*chunk shift for n lines: C = 2^shift is the first power of two with C * C >= n*/
+  static size_t shift_for(size_t n);
+  void push_back(std::string s);
+  void insert_at(size_t row, std::string s);
+  void erase_at(size_t row);
+  void truncate(size_t row);
+  /*
+    m lines in or out at row, row < n_. m < C carries m lines through each
+    later ring, O(C + m * n / C); otherwise every line after row moves by m
+    in place, O(n - row). carry_cheaper picks the smaller.
+  */
+  bool carry_cheaper(size_t row, size_t m) const;
+  void insert_carry(size_t row, std::span<const std::string> ss);
+  void erase_carry(size_t row, size_t m);
+  void insert_shift(size_t row, std::span<const std::string> ss);
+  void erase_shift(size_t row, size_t m);
+  /*re-chunk when shift_for(n_) is two or more away from shift_*/
+  void maybe_retier();
+};
+
+static_assert(TextBufferCoreCRTPConcept<TieredVectorTextBufferCore>, "Tiered vector backend must satisfy CRTP concept");
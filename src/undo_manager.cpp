@@ -1,4 +1,5 @@
 #include "undo_manager.hpp"
+#include <algorithm>
 
 void UndoManager::begin_group(const Cursor& pre) {
   if (!grouping_) {
@@ -30,12 +31,51 @@ void UndoManager::clear_redo() { redo_entries_.clear(); }
 bool UndoManager::can_undo() const { return !undo_entries_.empty(); }
 bool UndoManager::can_redo() const { return !redo_entries_.empty(); }
 
+/*
+  ReplaceLine ops never move rows, so a run of them is replayed as one
+  batch: ops[first, last) in the order given by undo, where the last write
+  to a row wins.
+*/
+static void replay_replace_run(TextBuffer& buf, const std::vector<Operation>& ops, size_t first, size_t last, bool undo) {
+  std::vector<const Operation*> run;
+  run.reserve(last - first);
+  for (size_t k = first; k < last; ++k) {
+    const Operation& op = ops[undo ? last - 1 - (k - first) : k];
+    if (op.row >= 0 && op.row < buf.line_count()) run.push_back(&op);
+  }
+  std::stable_sort(run.begin(), run.end(), [](const Operation* a, const Operation* b) { return a->row < b->row; });
+  std::vector<LineEdit> edits;
+  edits.reserve(run.size());
+  for (size_t k = 0; k < run.size(); ++k) {
+    if (k + 1 < run.size() && run[k + 1]->row == run[k]->row) continue;
+    edits.push_back({static_cast<size_t>(run[k]->row), 1, {undo ? run[k]->payload : run[k]->alt_payload}});
+  }
+  buf.apply_edits(std::move(edits));
+}
+
+/*bounds of the run of ReplaceLine ops reaching forward from ops[i], or back from ops[end - 1]*/
+static size_t replace_run_end(const std::vector<Operation>& ops, size_t i) {
+  while (i < ops.size() && ops[i].type == Operation::ReplaceLine) ++i;
+  return i;
+}
+
+static size_t replace_run_begin(const std::vector<Operation>& ops, size_t end) {
+  while (end > 0 && ops[end - 1].type == Operation::ReplaceLine) --end;
+  return end;
+}
+
 void UndoManager::undo(TextBuffer& buf, Cursor& cur) {
   if (undo_entries_.empty()) return;
   UndoEntry e = undo_entries_.back();
   undo_entries_.pop_back();
   for (int i = static_cast<int>(e.ops.size()) - 1; i >= 0; --i) {
     const Operation& op = e.ops[i];
+    size_t run_begin = replace_run_begin(e.ops, static_cast<size_t>(i) + 1);
+    if (run_begin + 1 < static_cast<size_t>(i) + 1) {
+      replay_replace_run(buf, e.ops, run_begin, static_cast<size_t>(i) + 1, true);
+      i = static_cast<int>(run_begin);
+      continue;
+    }
     switch (op.type) {
       case Operation::InsertChar: {
         std::string s = buf.line(op.row);
@@ -90,6 +130,12 @@ void UndoManager::redo(TextBuffer& buf, Cursor& cur) {
   redo_entries_.pop_back();
   for (size_t i = 0; i < e.ops.size(); ++i) {
     const Operation& op = e.ops[i];
+    size_t run_end = replace_run_end(e.ops, i);
+    if (run_end > i + 1) {
+      replay_replace_run(buf, e.ops, i, run_end, false);
+      i = run_end - 1;
+      continue;
+    }
     switch (op.type) {
       case Operation::InsertChar: {
         std::string s = buf.line(op.row);
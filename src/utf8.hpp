@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+/*number of UTF-8 codepoints in s: every byte that is not a continuation byte starts one*/
+inline size_t utf8_length(std::string_view s) {
+  size_t n = 0;
+  for (unsigned char c : s) n += (c & 0xC0) != 0x80;
+  return n;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <string_view>
@@ -10,12 +11,16 @@ public:
   static constexpr std::string_view get_name_sv() { return "vector"; }
 
   void init_from_lines(const std::vector<std::string>& lines) { lines_ = lines; }
+  void adopt_lines(std::vector<std::string>&& lines) { lines_ = std::move(lines); lines.clear(); }
   int line_count() const { return static_cast<int>(lines_.size()); }
   std::string get_line(int r) const { if (r < 0 || r >= static_cast<int>(lines_.size())) return std::string(); return lines_[r]; }
   /*forward to CRTP impl*/
   void do_init_from_lines(const std::vector<std::string>& lines) { lines_ = lines; }
+  void do_adopt_lines(std::vector<std::string>&& lines) { adopt_lines(std::move(lines)); }
   int do_line_count() const { return static_cast<int>(lines_.size()); }
   std::string do_get_line(int r) const { if (r < 0 || r >= static_cast<int>(lines_.size())) return std::string(); return lines_[r]; }
+  std::string_view get_line_view(int r, std::string&) const { if (r < 0 || r >= static_cast<int>(lines_.size())) return {}; return lines_[r]; }
+  std::string_view do_get_line_view(int r, std::string& scratch) const { return get_line_view(r, scratch); }
 
   void insert_line(size_t row, const std::string& s) {
     size_t pos = std::min(row, lines_.size());
@@ -63,6 +68,45 @@ public:
   void do_replace_line(size_t row, const std::string& s) { if (row >= lines_.size()) return; lines_[row] = s; }
   void do_replace_line(size_t row, std::string_view s) { if (row >= lines_.size()) return; lines_[row] = std::string(s); }
 
+  void insert_text(size_t row, size_t col, std::string_view s) {
+    if (row >= lines_.size()) return;
+    std::string& l = lines_[row];
+    l.insert(std::min(col, l.size()), s);
+  }
+  void erase_text(size_t row, size_t col, size_t len) {
+    if (row >= lines_.size() || col >= lines_[row].size()) return;
+    lines_[row].erase(col, len);
+  }
+  void split_line(size_t row, size_t col) {
+    if (row >= lines_.size()) return;
+    std::string& l = lines_[row];
+    col = std::min(col, l.size());
+    std::string tail(l, col);
+    l.erase(col);
+    lines_.insert(lines_.begin() + static_cast<std::ptrdiff_t>(row + 1), std::move(tail));
+  }
+  void join_lines(size_t row) {
+    if (row + 1 >= lines_.size()) return;
+    lines_[row] += lines_[row + 1];
+    lines_.erase(lines_.begin() + static_cast<std::ptrdiff_t>(row + 1));
+  }
+  /*overwrite the common prefix, then shift the tail of the vector once*/
+  void replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) {
+    start_row = std::min(start_row, lines_.size());
+    end_row = std::clamp(end_row, start_row, lines_.size());
+    size_t common = std::min(end_row - start_row, ss.size());
+    std::copy(ss.begin(), ss.begin() + static_cast<std::ptrdiff_t>(common), lines_.begin() + static_cast<std::ptrdiff_t>(start_row));
+    auto at = lines_.begin() + static_cast<std::ptrdiff_t>(start_row + common);
+    if (common < ss.size()) lines_.insert(at, ss.begin() + static_cast<std::ptrdiff_t>(common), ss.end());
+    else lines_.erase(at, lines_.begin() + static_cast<std::ptrdiff_t>(end_row));
+    if (lines_.empty()) lines_.emplace_back("");
+  }
+  void do_replace_lines(size_t start_row, size_t end_row, std::span<const std::string> ss) { replace_lines(start_row, end_row, ss); }
+  void do_insert_text(size_t row, size_t col, std::string_view s) { insert_text(row, col, s); }
+  void do_erase_text(size_t row, size_t col, size_t len) { erase_text(row, col, len); }
+  void do_split_line(size_t row, size_t col) { split_line(row, col); }
+  void do_join_lines(size_t row) { join_lines(row); }
+
   const std::vector<std::string>& raw_lines() const { return lines_; }
 private:
   std::vector<std::string> lines_;
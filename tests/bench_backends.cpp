@@ -3,11 +3,49 @@
 #include "vector_text_buffer_core.hpp"
 #include "rope_text_buffer_core.hpp"
 #include "rope_text_buffer_core.hpp"
+#include "persistent_rope_text_buffer_core.hpp"
+#include "btree_text_buffer_core.hpp"
+#include "byte_rope_text_buffer_core.hpp"
+#include "piece_table_text_buffer_core.hpp"
+#include "tiered_vector_text_buffer_core.hpp"
+#include "file_reader.hpp"
+#include "newline_scan.hpp"
 #include <string>
 #include <vector>
 #include <chrono>
 #include <iostream>
 #include <random>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+/*count every heap allocation and the live heap bytes so the benches can report malloc traffic and memory*/
+static std::atomic<size_t> g_allocs{0};
+static std::atomic<size_t> g_live_bytes{0};
+static std::atomic<size_t> g_peak_bytes{0};
+static constexpr size_t kAllocHeader = alignof(std::max_align_t);
+void* operator new(size_t n) {
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  size_t live = g_live_bytes.fetch_add(n, std::memory_order_relaxed) + n;
+  for (size_t peak = g_peak_bytes.load(std::memory_order_relaxed); live > peak && !g_peak_bytes.compare_exchange_weak(peak, live);) {}
+  if (char* p = static_cast<char*>(std::malloc(n + kAllocHeader))) {
+    *reinterpret_cast<size_t*>(p) = n;
+    return p + kAllocHeader;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+  if (!p) return;
+  char* base = static_cast<char*>(p) - kAllocHeader;
+  g_live_bytes.fetch_sub(*reinterpret_cast<size_t*>(base), std::memory_order_relaxed);
+  std::free(base);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
 
 struct BenchCfg {
   int N = 200000;               /*init lines count*/
@@ -18,6 +56,51 @@ struct BenchCfg {
   int block_iters = 500;        /*batch insert/erase iters (head/mid/tail)*/
 };
 
+/*debug invariant check, only the rope exposes one*/
+template <typename Core>
+static void check_invariants(const char*, const Core&) {}
+static void check_invariants(const char* tag, const RopeTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why)
+            << " height=" << core.height() << " leaves=" << core.leaf_count()
+            << " lines=" << core.line_count() << "\n";
+}
+
+static void check_invariants(const char* tag, const PersistentRopeTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why) << "\n";
+}
+
+static void check_invariants(const char* tag, const BTreeTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why)
+            << " height=" << core.height() << " lines=" << core.line_count() << "\n";
+}
+
+static void check_invariants(const char* tag, const ByteRopeTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why)
+            << " height=" << core.height() << " bytes=" << core.byte_size() << "\n";
+}
+
+static void check_invariants(const char* tag, const PieceTableTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why)
+            << " bytes=" << core.byte_size() << " added=" << core.added_bytes() << "\n";
+}
+
+static void check_invariants(const char* tag, const TieredVectorTextBufferCore& core) {
+  std::string why;
+  bool ok = core.check_invariants(&why);
+  std::cout << tag << " invariants " << (ok ? "ok" : "BROKEN: " + why)
+            << " chunk=" << core.chunk_lines() << " lines=" << core.line_count() << "\n";
+}
+
 static std::vector<std::string> make_lines(int n) {
   std::vector<std::string> lines;
   lines.reserve(n);
@@ -25,24 +108,133 @@ static std::vector<std::string> make_lines(int n) {
   return lines;
 }
 
+/*source-code-like lines, ~40 bytes each, too long for the small string buffer*/
+static std::vector<std::string> make_source_lines(int n) {
+  std::vector<std::string> lines;
+  lines.reserve(n);
+  for (int i = 0; i < n; ++i) lines.push_back("    auto value_" + std::to_string(i) + " = compute(lhs, rhs); // x");
+  return lines;
+}
+
 template <typename Core>
 static void bench_init_one(const char* tag, const BenchCfg& cfg) {
-  auto lines = make_lines(cfg.N);
+  auto lines = make_source_lines(cfg.N);
   Core core;
+  size_t mem0 = g_live_bytes.load();
   auto t0 = std::chrono::steady_clock::now();
   core.init_from_lines(lines);
   auto t1 = std::chrono::steady_clock::now();
   std::chrono::duration<double> dt = t1 - t0;
-  std::cout << tag << " init_from_lines N=" << cfg.N << " took " << dt.count() << "s\n";
+  size_t mem = g_live_bytes.load() - mem0;
+  std::cout << tag << " init_from_lines N=" << cfg.N << " took " << dt.count() << "s mem=" << mem / 1024
+            << "KB (" << static_cast<double>(mem) / cfg.N << " B/line)\n";
+  check_invariants(tag, core);
 }
 static void bench_init(const BenchCfg& cfg) {
   bench_init_one<VectorTextBufferCore>("[vector]   ", cfg);
   bench_init_one<GapTextBufferCore>("[gap]      ", cfg);
   bench_init_one<RopeTextBufferCore>("[rope]     ", cfg);
+  bench_init_one<PersistentRopeTextBufferCore>("[prope]    ", cfg);
+  bench_init_one<BTreeTextBufferCore>("[btree]    ", cfg);
+  bench_init_one<ByteRopeTextBufferCore>("[byterope] ", cfg);
+  bench_init_one<PieceTableTextBufferCore>("[piece]    ", cfg);
+  bench_init_one<TieredVectorTextBufferCore>("[tiered]   ", cfg);
+}
+
+/*peak heap while a freshly read file goes into a core: copied from the reader's vector, or handed over*/
+template <typename Core>
+static void bench_adopt_one(const char* tag, const BenchCfg& cfg) {
+  auto measure = [&](bool adopt) {
+    auto lines = make_source_lines(cfg.N);
+    size_t base = g_live_bytes.load();
+    g_peak_bytes.store(base);
+    auto t0 = std::chrono::steady_clock::now();
+    Core core;
+    if (adopt) core.adopt_lines(std::move(lines));
+    else { core.init_from_lines(lines); std::vector<std::string>().swap(lines); }
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << tag << (adopt ? " adopt_lines    " : " init_from_lines") << " N=" << cfg.N << " took " << dt.count()
+              << "s peak=" << (g_peak_bytes.load() - base) / 1024 << "KB\n";
+  };
+  measure(false);
+  measure(true);
+}
+static void bench_adopt(const BenchCfg& cfg) {
+  bench_adopt_one<VectorTextBufferCore>("[vector]   ", cfg);
+  bench_adopt_one<GapTextBufferCore>("[gap]      ", cfg);
+  bench_adopt_one<RopeTextBufferCore>("[rope]     ", cfg);
+  bench_adopt_one<PersistentRopeTextBufferCore>("[prope]    ", cfg);
+  bench_adopt_one<BTreeTextBufferCore>("[btree]    ", cfg);
+  bench_adopt_one<TieredVectorTextBufferCore>("[tiered]   ", cfg);
+}
+
+/*open a file from disk: the copying line reader against the mapped piece table*/
+static void bench_open(const BenchCfg& cfg) {
+  auto path = std::filesystem::temp_directory_path() / "mvim_bench_open.txt";
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (const auto& l : make_source_lines(cfg.N * 10)) out << l << '\n';
+  }
+  std::string msg;
+  {
+    size_t mem0 = g_live_bytes.load();
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::string> ls;
+    mmap_readlines(path, ls, msg);
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << "[readlines] open lines=" << ls.size() << " took " << dt.count() << "s mem=" << (g_live_bytes.load() - mem0) / 1024 << "KB\n";
+  }
+  {
+    // newline counting alone, per kernel, against the file's size
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string best = newline_scan_kernel();
+    for (const char* kernel : {"scalar", "sse2", "avx2"}) {
+      if (!use_newline_scan_kernel(kernel)) continue;
+      auto t0 = std::chrono::steady_clock::now();
+      size_t nl = 0;
+      for (int rep = 0; rep < 10; ++rep) nl += count_newlines(bytes.data(), bytes.size()).newlines;
+      auto t1 = std::chrono::steady_clock::now();
+      std::chrono::duration<double> dt = t1 - t0;
+      std::cout << "[scan " << kernel << "] count newlines=" << nl / 10 << " " << 10.0 * static_cast<double>(bytes.size()) / dt.count() / (1 << 20) << "MB/s\n";
+    }
+    use_newline_scan_kernel(best);
+  }
+  {
+    // one arena for the whole file, then the rope cuts its leaves out of it
+    size_t mem0 = g_live_bytes.load(), allocs0 = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    LineArena arena;
+    mmap_readarena(path, arena, msg);
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << "[readarena] open lines=" << arena.size() << " took " << dt.count() << "s mem=" << (g_live_bytes.load() - mem0) / 1024
+              << "KB allocs=" << g_allocs.load() - allocs0 << "\n";
+    RopeTextBufferCore core;
+    auto t2 = std::chrono::steady_clock::now();
+    core.init_from_arena(arena);
+    auto t3 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dl = t3 - t2;
+    std::cout << "[rope]      load arena lines=" << core.line_count() << " took " << dl.count() << "s\n";
+    check_invariants("[rope]     ", core);
+  }
+  {
+    size_t mem0 = g_live_bytes.load();
+    auto t0 = std::chrono::steady_clock::now();
+    PieceTableTextBufferCore core;
+    core.open_file(path, msg);
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << "[piece]     open lines=" << core.line_count() << " took " << dt.count() << "s mem=" << (g_live_bytes.load() - mem0) / 1024 << "KB\n";
+    check_invariants("[piece]    ", core);
+  }
+  std::filesystem::remove(path);
 }
 
 static void bench_get_line(const BenchCfg& cfg) {
-  auto lines = make_lines(cfg.N);
+  auto lines = make_source_lines(cfg.N);
   std::mt19937 rng(12345);
   std::uniform_int_distribution<int> dist(0, cfg.N - 1);
   auto bench_one = [&](const char* tag, auto& core){
@@ -55,11 +247,31 @@ static void bench_get_line(const BenchCfg& cfg) {
     auto t1 = std::chrono::steady_clock::now();
     std::chrono::duration<double> dt = t1 - t0;
     std::cout << tag << " get_line iters=" << cfg.get_iters << " took " << dt.count() << "s\n";
+    // in-order scan, the render/search/save access pattern
+    size_t sink = 0;
+    auto t2 = std::chrono::steady_clock::now();
+    for (int r = 0; r < core.line_count(); ++r) sink += core.get_line(r).size();
+    auto t3 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt2 = t3 - t2;
+    std::cout << tag << " get_line sequential lines=" << core.line_count() << " took " << dt2.count() << "s (" << sink << ")\n";
+    // same scan through a line cursor
+    std::string scratch;
+    sink = 0;
+    auto t4 = std::chrono::steady_clock::now();
+    for (auto it = core.line_cursor(0); it.valid(); it.next()) sink += it.view(scratch).size();
+    auto t5 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt3 = t5 - t4;
+    std::cout << tag << " line_cursor sequential took " << dt3.count() << "s (" << sink << ")\n";
   };
   {
     VectorTextBufferCore v; bench_one("[vector]   ", v);
     GapTextBufferCore g; bench_one("[gap]      ", g);
     RopeTextBufferCore r; bench_one("[rope]     ", r);
+    PersistentRopeTextBufferCore p; bench_one("[prope]    ", p);
+    BTreeTextBufferCore bt; bench_one("[btree]    ", bt);
+    ByteRopeTextBufferCore br; bench_one("[byterope] ", br);
+    PieceTableTextBufferCore pt; bench_one("[piece]    ", pt);
+    TieredVectorTextBufferCore tv; bench_one("[tiered]   ", tv);
   }
 }
 
@@ -92,10 +304,15 @@ static void bench_insert_line(const BenchCfg& cfg) {
       std::chrono::duration<double> dt = t1 - t0;
       std::cout << tag << " insert_line tail iters=" << cfg.insert_iters << " took " << dt.count() << "s\n";
     }
+    check_invariants(tag, core);
   };
   { VectorTextBufferCore v; run("[vector]  ", v); }
   { GapTextBufferCore g; run("[gap]     ", g); }
   { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore bt; run("[btree]   ", bt); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
 }
 
 static void bench_insert_lines(const BenchCfg& cfg) {
@@ -128,10 +345,15 @@ static void bench_insert_lines(const BenchCfg& cfg) {
       std::chrono::duration<double> dt = t1 - t0;
       std::cout << tag << " insert_lines tail iters=" << cfg.block_iters << " blk=" << cfg.block_size << " took " << dt.count() << "s\n";
     }
+    check_invariants(tag, core);
   };
   { VectorTextBufferCore v; run("[vector]  ", v); }
   { GapTextBufferCore g; run("[gap]     ", g); }
   { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore bt; run("[btree]   ", bt); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
 }
 
 static void bench_erase_line(const BenchCfg& cfg) {
@@ -167,10 +389,15 @@ static void bench_erase_line(const BenchCfg& cfg) {
       std::chrono::duration<double> dt = t1 - t0;
       std::cout << tag << " erase_line  tail iters=" << cfg.erase_iters << " took " << dt.count() << "s\n";
     }
+    check_invariants(tag, core);
   };
   { VectorTextBufferCore v; run("[vector]  ", v); }
   { GapTextBufferCore g; run("[gap]     ", g); }
   { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore bt; run("[btree]   ", bt); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
 }
 
 static void bench_erase_lines(const BenchCfg& cfg) {
@@ -212,10 +439,15 @@ static void bench_erase_lines(const BenchCfg& cfg) {
       std::chrono::duration<double> dt = t1 - t0;
       std::cout << tag << " erase_lines tail iters=" << cfg.block_iters << " blk=" << cfg.block_size << " took " << dt.count() << "s\n";
     }
+    check_invariants(tag, core);
   };
   { VectorTextBufferCore v; run("[vector]  ", v); }
   { GapTextBufferCore g; run("[gap]     ", g); }
   { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore bt; run("[btree]   ", bt); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
 }
 
 static void bench_replace_line(const BenchCfg& cfg) {
@@ -232,10 +464,181 @@ static void bench_replace_line(const BenchCfg& cfg) {
     auto t1 = std::chrono::steady_clock::now();
     std::chrono::duration<double> dt = t1 - t0;
     std::cout << tag << " replace_line iters=" << cfg.get_iters << " took " << dt.count() << "s\n";
+    // insert mode: every keystroke rewrites the same, growing line
+    {
+      size_t row = static_cast<size_t>(core.line_count() / 2);
+      std::string typed;
+      auto t2 = std::chrono::steady_clock::now();
+      for (int i = 0; i < cfg.get_iters; ++i) {
+        typed.push_back(static_cast<char>('a' + i % 26));
+        if (typed.size() > 80) typed.clear();
+        core.replace_line(row, std::string_view(typed));
+      }
+      auto t3 = std::chrono::steady_clock::now();
+      std::chrono::duration<double> dt2 = t3 - t2;
+      std::cout << tag << " replace_line typing iters=" << cfg.get_iters << " took " << dt2.count() << "s\n";
+    }
+    check_invariants(tag, core);
+  };
+  { VectorTextBufferCore v; run("[vector]  ", v); }
+  { GapTextBufferCore g; run("[gap]     ", g); }
+  { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore bt; run("[btree]   ", bt); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
+}
+
+/*keystrokes while a snapshot of every previous version is kept alive*/
+static void bench_snapshot(const BenchCfg& cfg) {
+  auto lines = make_lines(cfg.N);
+  PersistentRopeTextBufferCore core;
+  core.init_from_lines(lines);
+  std::vector<PersistentRopeTextBufferCore> versions;
+  versions.reserve(static_cast<size_t>(cfg.insert_iters));
+  size_t row = static_cast<size_t>(cfg.N / 2);
+  std::string typed;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < cfg.insert_iters; ++i) {
+    versions.push_back(core.snapshot());
+    typed.push_back('x');
+    core.replace_line(row, std::string_view(typed));
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  std::chrono::duration<double> dt = t1 - t0;
+  std::cout << "[prope]    snapshot+replace_line iters=" << cfg.insert_iters << " took " << dt.count() << "s\n";
+  check_invariants("[prope]   ", core);
+}
+
+/*allocations of a mixed edit session, then the cost of dropping the buffer*/
+static void bench_allocs(const BenchCfg& cfg) {
+  auto lines = make_lines(cfg.N);
+  std::vector<std::string> block(cfg.block_size, std::string("blk"));
+  auto run = [&](const char* tag, auto make) {
+    auto core = make();
+    core->init_from_lines(lines);
+    std::mt19937 rng(777);
+    size_t before = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < cfg.insert_iters; ++i) {
+      size_t n = static_cast<size_t>(core->line_count());
+      size_t r = n ? rng() % n : 0;
+      switch (i % 4) {
+        case 0: core->insert_line(r, std::string_view("x")); break;
+        case 1: core->erase_line(r); break;
+        case 2: core->insert_lines(r, block); break;
+        default: core->erase_lines(r, r + static_cast<size_t>(cfg.block_size)); break;
+      }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    size_t allocs = g_allocs.load() - before;
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << tag << " mixed edits iters=" << cfg.insert_iters << " allocs=" << allocs << " took " << dt.count() << "s\n";
+    check_invariants(tag, *core);
+    auto t2 = std::chrono::steady_clock::now();
+    core.reset();
+    auto t3 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt2 = t3 - t2;
+    std::cout << tag << " teardown took " << dt2.count() << "s\n";
+  };
+  run("[vector]  ", [] { return std::make_unique<VectorTextBufferCore>(); });
+  run("[gap]     ", [] { return std::make_unique<GapTextBufferCore>(); });
+  run("[rope]    ", [] { return std::make_unique<RopeTextBufferCore>(); });
+  run("[prope]   ", [] { return std::make_unique<PersistentRopeTextBufferCore>(); });
+  run("[btree]   ", [] { return std::make_unique<BTreeTextBufferCore>(); });
+  run("[byterope]", [] { return std::make_unique<ByteRopeTextBufferCore>(); });
+  run("[tiered]  ", [] { return std::make_unique<TieredVectorTextBufferCore>(); });
+}
+
+/*one minified-json style line: redraw a screen-wide window and type in the middle of it*/
+static void bench_long_line(const BenchCfg& cfg) {
+  std::string big(static_cast<size_t>(cfg.N) * 256, 'j');
+  std::vector<std::string> lines{big};
+  size_t mid = big.size() / 2;
+  auto run = [&](const char* tag, auto& core) {
+    core.init_from_lines(lines);
+    auto t0 = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    for (int i = 0; i < 1000; ++i) sink += core.line_slice(0, mid + static_cast<size_t>(i), 200).size();
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << tag << " long line bytes=" << big.size() << " line_slice x1000 took " << dt.count() << "s (" << sink << ")\n";
+    auto t2 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+      if constexpr (requires { core.insert_text(size_t(0), size_t(0), std::string_view("k")); }) {
+        core.insert_text(0, mid, std::string_view("k"));
+      } else {
+        std::string s = core.get_line(0);
+        s.insert(mid, 1, 'k');
+        core.replace_line(0, s);
+      }
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt2 = t3 - t2;
+    std::cout << tag << " long line typing x100 took " << dt2.count() << "s\n";
+    check_invariants(tag, core);
+  };
+  { GapTextBufferCore g; run("[gap]     ", g); }
+  { RopeTextBufferCore r; run("[rope]    ", r); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { PieceTableTextBufferCore pt; run("[piece]   ", pt); }
+}
+
+/*insert-mode typing: a burst of keystrokes on one row of a big file, as the editor issues them*/
+static void bench_typing(const BenchCfg& cfg) {
+  auto lines = make_lines(cfg.N);
+  auto run = [&](const char* tag, auto& core) {
+    core.init_from_lines(lines);
+    size_t row = static_cast<size_t>(cfg.N / 2);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10000; ++i) {
+      if constexpr (requires { core.insert_text(size_t(0), size_t(0), std::string_view("k")); }) {
+        if (i % 5 == 4) core.erase_text(row, 0, 1);
+        else core.insert_text(row, static_cast<size_t>(i % 7), std::string_view("k"));
+      } else {
+        std::string s = core.get_line(static_cast<int>(row));
+        if (i % 5 == 4) s.erase(0, 1);
+        else s.insert(std::min(s.size(), static_cast<size_t>(i % 7)), 1, 'k');
+        core.replace_line(row, s);
+      }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << tag << " typing x10000 lines=" << core.line_count() << " took " << dt.count() << "s\n";
+    check_invariants(tag, core);
+  };
+  { VectorTextBufferCore v; run("[vector]  ", v); }
+  { GapTextBufferCore g; run("[gap]     ", g); }
+  { RopeTextBufferCore r; run("[rope]    ", r); }
+  { BTreeTextBufferCore b; run("[btree]   ", b); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { PieceTableTextBufferCore pt; run("[piece]   ", pt); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
+}
+
+/*">G" over the whole buffer: every line gets an indent, as one batch*/
+static void bench_indent_batch(const BenchCfg& cfg) {
+  auto lines = make_lines(cfg.N);
+  auto run = [&](const char* tag, auto& core) {
+    core.init_from_lines(lines);
+    std::vector<LineEdit> edits;
+    edits.reserve(lines.size());
+    for (size_t r = 0; r < lines.size(); ++r) edits.push_back({r, 1, {"  " + lines[r]}});
+    auto t0 = std::chrono::steady_clock::now();
+    core.apply_edits(edits);
+    auto t1 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> dt = t1 - t0;
+    std::cout << tag << " indent batch lines=" << core.line_count() << " took " << dt.count() << "s\n";
+    check_invariants(tag, core);
   };
   { VectorTextBufferCore v; run("[vector]  ", v); }
   { GapTextBufferCore g; run("[gap]     ", g); }
   { RopeTextBufferCore r; run("[rope]    ", r); }
+  { PersistentRopeTextBufferCore p; run("[prope]   ", p); }
+  { BTreeTextBufferCore b; run("[btree]   ", b); }
+  { ByteRopeTextBufferCore br; run("[byterope]", br); }
+  { PieceTableTextBufferCore pt; run("[piece]   ", pt); }
+  { TieredVectorTextBufferCore tv; run("[tiered]  ", tv); }
 }
 
 int main(int argc, char** argv) {
@@ -243,11 +646,18 @@ int main(int argc, char** argv) {
   if (argc > 1) { try { cfg.N = std::stoi(argv[1]); } catch (...) {} }
   std::cout << "Backend operations benchmark (N=" << cfg.N << ")\n";
   bench_init(cfg);
+  bench_adopt(cfg);
+  bench_open(cfg);
   bench_get_line(cfg);
   bench_insert_line(cfg);
   bench_insert_lines(cfg);
   bench_erase_line(cfg);
   bench_erase_lines(cfg);
   bench_replace_line(cfg);
+  bench_snapshot(cfg);
+  bench_allocs(cfg);
+  bench_long_line(cfg);
+  bench_typing(cfg);
+  bench_indent_batch(cfg);
   return 0;
 }
@@ -0,0 +1,651 @@
+#include "vector_text_buffer_core.hpp"
+#include "gap_text_buffer_core.hpp"
+#include "rope_text_buffer_core.hpp"
+#include "persistent_rope_text_buffer_core.hpp"
+#include "btree_text_buffer_core.hpp"
+#include "byte_rope_text_buffer_core.hpp"
+#include "piece_table_text_buffer_core.hpp"
+#include "tiered_vector_text_buffer_core.hpp"
+#include "mapped_view_text_buffer_core.hpp"
+#include "packed_lines.hpp"
+#include "file_reader.hpp"
+#include "newline_scan.hpp"
+#include "newline_index.hpp"
+#include "task_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*replay the same random edit script against a backend and a plain vector*/
+template <typename Core, typename Check>
+static void run_random_edits(unsigned seed, int steps, Check&& check, int init_lines = 1000) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> ref;
+  for (int i = 0; i < init_lines; ++i) ref.push_back("init" + std::to_string(i));
+  Core core;
+  // odd seeds start from lines handed over, even ones from a copy
+  if (seed % 2) {
+    std::vector<std::string> given(ref);
+    core.adopt_lines(std::move(given));
+    assert(given.empty());
+  } else {
+    core.init_from_lines(ref);
+  }
+  auto pick = [&](size_t n) { return n == 0 ? size_t(0) : static_cast<size_t>(rng() % n); };
+  for (int step = 0; step < steps; ++step) {
+    std::string s = "s" + std::to_string(step);
+    switch (rng() % 8) {
+      case 0: {
+        size_t r = pick(ref.size() + 1);
+        ref.insert(ref.begin() + static_cast<std::ptrdiff_t>(r), s);
+        core.insert_line(r, std::string_view(s));
+      } break;
+      case 1: {
+        size_t r = pick(ref.size() + 1);
+        std::vector<std::string> block(1 + rng() % 300, s);
+        ref.insert(ref.begin() + static_cast<std::ptrdiff_t>(r), block.begin(), block.end());
+        core.insert_lines(r, block);
+      } break;
+      case 2: {
+        if (ref.size() <= 1) break;
+        size_t r = pick(ref.size());
+        ref.erase(ref.begin() + static_cast<std::ptrdiff_t>(r));
+        core.erase_line(r);
+      } break;
+      case 3: {
+        if (ref.size() <= 1) break;
+        size_t a = pick(ref.size());
+        size_t b = std::min(ref.size() - 1, a + rng() % 200);
+        ref.erase(ref.begin() + static_cast<std::ptrdiff_t>(a), ref.begin() + static_cast<std::ptrdiff_t>(b));
+        core.erase_lines(a, b);
+      } break;
+      case 4: {
+        // runs of in-line edits on one row, like typing
+        size_t r = pick(ref.size());
+        for (int k = 0, n = 1 + static_cast<int>(rng() % 8); k < n; ++k) {
+          size_t c = pick(ref[r].size() + 1);
+          if (rng() % 3 == 0) {
+            size_t len = 1 + rng() % 3;
+            if (c < ref[r].size()) ref[r].erase(c, len);
+            core.erase_text(r, c, len);
+          } else {
+            ref[r].insert(c, "\xc3\xa9");
+            core.insert_text(r, c, "\xc3\xa9");
+          }
+        }
+      } break;
+      case 5: {
+        // enter and backspace at a line boundary
+        size_t r = pick(ref.size());
+        if (rng() % 2 == 0) {
+          size_t c = pick(ref[r].size() + 1);
+          ref.insert(ref.begin() + static_cast<std::ptrdiff_t>(r) + 1, ref[r].substr(c));
+          ref[r].erase(c);
+          core.split_line(r, c);
+        } else if (r + 1 < ref.size()) {
+          ref[r] += ref[r + 1];
+          ref.erase(ref.begin() + static_cast<std::ptrdiff_t>(r) + 1);
+          core.join_lines(r);
+        }
+      } break;
+      case 6: {
+        // a batch of edits in one pass, sometimes dense enough to be spliced
+        std::vector<LineEdit> batch;
+        size_t step_rows = rng() % 2 ? 1 : 40;
+        for (size_t r = pick(ref.size()); r < ref.size() && batch.size() < 200; r += 1 + pick(step_rows)) {
+          LineEdit e{r, std::min<size_t>(rng() % 3, ref.size() - r), {}};
+          for (size_t k = rng() % 3; k > 0; --k) e.lines.push_back(s + "b" + std::to_string(k));
+          r += e.erase;
+          batch.push_back(std::move(e));
+        }
+        std::vector<std::string> next;
+        size_t kept = 0;
+        for (const LineEdit& e : batch) {
+          next.insert(next.end(), ref.begin() + static_cast<std::ptrdiff_t>(kept), ref.begin() + static_cast<std::ptrdiff_t>(e.row));
+          next.insert(next.end(), e.lines.begin(), e.lines.end());
+          kept = e.row + e.erase;
+        }
+        next.insert(next.end(), ref.begin() + static_cast<std::ptrdiff_t>(kept), ref.end());
+        ref = std::move(next);
+        if (ref.empty()) ref.emplace_back();
+        core.apply_edits(batch);
+        if (core.line_count() == 0) core.insert_line(0, std::string_view());
+      } break;
+      default: {
+        size_t r = pick(ref.size());
+        ref[r] = s;
+        core.replace_line(r, std::string_view(s));
+      } break;
+    }
+    assert(core.line_count() == static_cast<int>(ref.size()));
+    check(core);
+  }
+  std::string scratch;
+  for (size_t i = 0; i < ref.size(); ++i) {
+    assert(core.get_line(static_cast<int>(i)) == ref[i]);
+    assert(core.get_line_view(static_cast<int>(i), scratch) == ref[i]);
+  }
+  // cursors: a full forward and backward walk, then a seek into the middle
+  auto it = core.line_cursor(0);
+  for (size_t i = 0; i < ref.size(); ++i, it.next()) assert(it.valid() && it.row() == static_cast<int>(i) && it.view(scratch) == ref[i]);
+  assert(!it.valid());
+  it.prev();
+  for (size_t i = ref.size(); i-- > 0; it.prev()) assert(it.valid() && it.view(scratch) == ref[i]);
+  assert(!it.valid());
+  it.seek(static_cast<int>(ref.size() / 2));
+  assert(it.length() == ref[ref.size() / 2].size());
+  // measures and byte <-> row conversion against the joined text
+  std::string text;
+  size_t widest = 0;
+  for (size_t i = 0; i < ref.size(); ++i) { if (i) text += '\n'; text += ref[i]; widest = std::max(widest, ref[i].size()); }
+  assert(core.byte_count() == text.size() && core.char_count() == utf8_length(text) && core.max_line_length() == widest);
+  for (size_t i = 0; i < ref.size(); i += 1 + ref.size() / 50) {
+    size_t off = core.row_to_byte(static_cast<int>(i));
+    assert(off == (i == 0 ? 0 : text.find('\n', core.row_to_byte(static_cast<int>(i - 1))) + 1));
+    assert(core.byte_to_row(off) == std::make_pair(static_cast<int>(i), size_t(0)));
+    assert(core.byte_to_row(off + ref[i].size()) == std::make_pair(static_cast<int>(i), ref[i].size()));
+  }
+  assert(core.byte_to_row(text.size() + 10).first == static_cast<int>(ref.size()) - 1);
+}
+
+static void test_packed_lines() {
+  std::vector<std::string> src{"alpha", "", "gamma", "delta"};
+  PackedLines a;
+  a.assign(src);
+  assert(a.size() == 4 && a[1].empty() && a[2] == "gamma");
+  PackedLines b;
+  b.push_back("x");
+  b.push_back("y");
+  b.insert(1, a, 2, 4); // x gamma delta y
+  assert(b.size() == 4 && b[1] == "gamma" && b[2] == "delta" && b[3] == "y");
+  b.replace(1, "g");
+  b.erase(0);
+  assert(b[0] == "g" && b[1] == "delta" && b[2] == "y" && b.bytes() == 7);
+  a.erase(1, 3);
+  assert(a.size() == 2 && a[0] == "alpha" && a[1] == "delta");
+}
+
+static void test_rope_measures() {
+  RopeTextBufferCore c;
+  c.init_from_lines({"héllo", "", "wörld!"});
+  assert(c.byte_count() == 15 && c.char_count() == 13 && c.max_line_length() == 7);
+  assert(c.row_to_byte(2) == 8 && c.byte_to_row(9) == std::make_pair(2, size_t(1)));
+  c.replace_line(1, std::string_view("a much longer line"));
+  assert(c.max_line_length() == 18 && c.byte_count() == 33 && c.check_invariants());
+  c.erase_line(1);
+  assert(c.max_line_length() == 7 && c.row_to_byte(1) == 7 && c.check_invariants());
+  // a hot line, grown or shrunk, is measured around without folding: views handed out before stay valid
+  std::vector<std::string> ref;
+  for (int i = 0; i < 600; ++i) ref.push_back(std::string(static_cast<size_t>(i % 13), 'a' + static_cast<char>(i % 26)));
+  ref[300] = std::string(40, 'L');
+  c.init_from_lines(ref);
+  for (int round = 0; round < 3; ++round) {
+    if (round == 0) { c.insert_text(300, 5, "grow"); ref[300].insert(5, "grow"); }
+    else { c.erase_text(300, 0, 30); ref[300].erase(0, 30); }
+    std::string scratch;
+    std::string_view before = c.get_line_view(299, scratch);
+    const char* data = before.data();
+    size_t longest = 0, off = 0;
+    for (const auto& s : ref) longest = std::max(longest, s.size());
+    assert(c.max_line_length() == longest && c.check_invariants());
+    for (int r = 0; r < static_cast<int>(ref.size()); ++r) {
+      const std::string& s = ref[static_cast<size_t>(r)];
+      for (size_t k = 0; k <= s.size(); ++k) assert(c.byte_to_row(off + k) == std::make_pair(r, k));
+      off += s.size() + 1;
+    }
+    assert(c.get_line_view(299, scratch).data() == data && before == ref[299]);
+  }
+}
+
+/*open_file reads the mapping as mmap_readlines would, and refuses CRLF*/
+static void test_piece_open() {
+  auto path = std::filesystem::temp_directory_path() / "mvim_piece_open.txt";
+  auto open_as = [&](const std::string& bytes, PieceTableTextBufferCore& c) {
+    { std::ofstream(path, std::ios::binary) << bytes; }
+    std::string msg;
+    return c.open_file(path, msg);
+  };
+  PieceTableTextBufferCore c;
+  assert(open_as("", c) && c.line_count() == 1 && c.get_line(0).empty());
+  assert(open_as("a\nbc\n", c) && c.line_count() == 3 && c.get_line(1) == "bc" && c.get_line(2).empty());
+  assert(open_as("a\nbc", c) && c.line_count() == 2 && c.get_line(1) == "bc" && c.byte_count() == 4);
+  assert(!open_as("a\r\nb", c));
+  // a file over several pieces, edited: the mapping is never written
+  std::string big;
+  for (int i = 0; i < 5000; ++i) big += "row" + std::to_string(i) + "\n";
+  assert(open_as(big, c) && c.line_count() == 5001 && c.added_bytes() > 0);
+  c.insert_text(2500, 3, "-x");
+  c.split_line(10, 1);
+  c.join_lines(4000);
+  c.erase_lines(0, 5);
+  assert(c.get_line(2496) == "row-x2500" && c.get_line(5) == "r" && c.get_line(6) == "ow10");
+  assert(c.get_line(3995) == "row3999row4000" && c.check_invariants());
+  std::string scratch;
+  size_t n = 0;
+  for (auto it = c.line_cursor(0); it.valid(); it.next()) n += it.view(scratch).size() + 1;
+  assert(n == c.byte_count() + 1);
+  std::filesystem::remove(path);
+}
+
+/*a piece table under a memory budget: heap blocks move to the spill file, new ones go there, the text never changes*/
+static void test_piece_spill() {
+  PieceTableTextBufferCore c;
+  std::vector<std::string> ref;
+  for (int i = 0; i < 3000; ++i) ref.push_back("row " + std::to_string(i));
+  c.init_from_lines(ref);
+  c.insert_text(10, 0, "edited ");
+  ref[10] = "edited " + ref[10];
+  assert(c.spilled_bytes() == 0);
+  c.set_memory_budget(1);
+  assert(c.spilled_bytes() > 0 && c.spilled_bytes() >= c.added_bytes() && c.check_invariants());
+  // enough typing for several segments, all but the newest paged out on the way
+  std::string word(1000, 'x');
+  for (int i = 0; i < 12000; ++i) {
+    size_t row = static_cast<size_t>(i % 3000);
+    c.insert_text(row, 0, word.substr(0, static_cast<size_t>(i % 7 + 1)));
+    ref[row].insert(0, word.substr(0, static_cast<size_t>(i % 7 + 1)));
+    if (i % 1000 == 0) { c.insert_line(row, word); ref.insert(ref.begin() + static_cast<long>(row), word); }
+  }
+  for (int i = 0; i < 3000; ++i) { c.insert_line(0, word + word); ref.insert(ref.begin(), word + word); }
+  assert(c.spilled_bytes() > SpillFile::SEGMENT && c.check_invariants());
+  assert(c.line_count() == static_cast<int>(ref.size()));
+  for (size_t i = 0; i < ref.size(); ++i) assert(c.get_line(static_cast<int>(i)) == ref[i]);
+  std::string all, joined;
+  assert(c.for_each_span([&](std::string_view s) { all += s; return true; }));
+  for (size_t i = 0; i < ref.size(); ++i) joined += (i ? "\n" : "") + ref[i];
+  assert(all == joined && all.size() == c.byte_count());
+  // a stop is passed back
+  int spans = 0;
+  assert(!c.for_each_span([&](std::string_view) { return ++spans < 3; }) && spans == 3);
+  c.set_memory_budget(0);
+  c.insert_text(0, 0, "after");
+  assert(c.get_line(0) == "after" + ref[0] && c.get_line(1) == ref[1]);
+}
+
+/*a view indexed in chunks reads like the file split into lines; offsets count the '\r's*/
+static void test_mapped_view() {
+  auto path = std::filesystem::temp_directory_path() / "mvim_mapped_view.txt";
+  std::string bytes;
+  for (int i = 0; i < 200; ++i) bytes += "line " + std::to_string(i) + (i % 7 == 0 ? "\r\n" : "\n");
+  bytes += "\n\ntail\r";
+  { std::ofstream(path, std::ios::binary) << bytes; }
+  std::vector<std::string> want;
+  std::string msg;
+  assert(mmap_readlines(path, want, msg));
+  auto file = std::make_shared<MappedFile>();
+  assert(file->open(path.string().c_str()));
+  MappedViewTextBufferCore c(3);
+  c.adopt_mapping(file);
+  std::string_view text = file->view();
+  for (size_t at = 0; at < text.size();) {
+    size_t end = text.find('\n', std::min(at + 50, text.size() - 1));
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    c.append_mapped(text.substr(at, end - at), end == text.size());
+    at = end;
+    assert(c.line_count() <= static_cast<int>(want.size()));
+  }
+  assert(c.line_count() == static_cast<int>(want.size()) && c.byte_count() == bytes.size());
+  assert(c.checkpoints() == 1 + (want.size() - 1) / 3);
+  std::string scratch;
+  for (size_t i = 0; i < want.size(); ++i) {
+    int r = static_cast<int>(i);
+    assert(c.get_line_view(r, scratch) == want[i] && c.line_length(r) == want[i].size());
+    assert(c.byte_to_row(c.row_to_byte(r)) == std::make_pair(r, size_t(0)));
+  }
+  assert(c.line_slice(7, 2, 3) == "ne " && c.line_slice(7, 99, 1).empty());
+  // rows outside the file read as empty, even while only part of it is indexed
+  int n = c.line_count();
+  assert(c.get_line(-1).empty() && c.get_line(n).empty() && c.line_length(n + 5) == 0 && c.line_slice(-3, 0, 4).empty());
+  assert(c.row_to_byte(-1) == 0 && c.row_to_byte(n) == c.byte_count());
+  {
+    MappedViewTextBufferCore part(3);
+    part.adopt_mapping(file);
+    part.append_mapped(text.substr(0, text.find('\n') + 1), false);
+    assert(part.line_count() == 1 && part.get_line(0) == want[0]);
+    assert(part.get_line(1).empty() && part.get_line(100).empty() && part.row_to_byte(50) == part.byte_count());
+  }
+  // the '\r' of a CRLF is the end of its line
+  size_t cr = c.row_to_byte(7) + want[7].size();
+  assert(bytes[cr] == '\r' && c.byte_to_row(cr) == std::make_pair(7, want[7].size()));
+  assert(c.byte_to_row(cr + 1) == std::make_pair(7, want[7].size()) && c.byte_to_row(bytes.size()).first == c.line_count() - 1);
+  int r = 0;
+  for (auto it = c.line_cursor(0); it.valid(); it.next(), ++r) assert(it.row() == r && it.view(scratch) == want[r]);
+  assert(r == c.line_count());
+  for (auto it = c.line_cursor(r - 1); it.valid(); it.prev()) assert(it.view(scratch) == want[--r]);
+  assert(r == 0);
+  auto it = c.line_cursor(100);
+  it.prev();
+  it.seek(150);
+  assert(it.view(scratch) == want[150] && it.length() == want[150].size());
+  // edits leave the file as it is
+  c.insert_text(0, 0, "x");
+  c.erase_lines(0, 10);
+  assert(c.get_line(0) == want[0] && c.line_count() == static_cast<int>(want.size()));
+  file.reset();
+  std::filesystem::remove(path);
+}
+
+/*fork/join on pools with and without workers: every task runs once, nested groups finish, errors reach wait()*/
+static void test_task_pool() {
+  for (unsigned workers : {0u, 3u}) {
+    TaskPool pool(workers);
+    std::atomic<size_t> sum{0};
+    parallel_for(0, 100000, 100, [&](size_t i) { sum += i; }, pool);
+    assert(sum == size_t(100000) * 99999 / 2);
+    std::atomic<int> leaves{0};
+    {
+      TaskGroup outer(pool);
+      for (int i = 0; i < 8; ++i) outer.run([&] {
+        TaskGroup inner(pool);
+        for (int j = 0; j < 8; ++j) inner.run([&] { ++leaves; });
+        inner.wait();
+      });
+      outer.wait();
+      assert(outer.done());
+    }
+    assert(leaves == 64);
+    TaskGroup g(pool);
+    g.run([] { throw std::length_error("task"); });
+    g.run([&] { ++leaves; });
+    bool caught = false;
+    try { g.wait(); } catch (const std::length_error&) { caught = true; }
+    assert(caught && leaves == 65);
+  }
+}
+
+/*every kernel finds and counts the same newlines as a byte loop, at any alignment and length*/
+static void test_newline_scan() {
+  std::mt19937 rng(20);
+  std::string buf(4096 + 64, 'a');
+  const char alphabet[] = {'\n', '\r', 'a', '\n', 'a', 'a', 'a', 'a'};
+  for (char& ch : buf) ch = alphabet[rng() % 8];
+  std::string best = newline_scan_kernel();
+  for (const char* kernel : {"scalar", "sse2", "avx2"}) {
+    if (!use_newline_scan_kernel(kernel)) continue;
+    std::vector<size_t> pos(buf.size());
+    for (int round = 0; round < 500; ++round) {
+      size_t off = rng() % 64, n = round < 100 ? static_cast<size_t>(round) : rng() % (buf.size() - off);
+      const char* p = buf.data() + off;
+      size_t nl = 0, crlf = 0, k = 0;
+      for (size_t i = 0; i < n; ++i) {
+        if (p[i] != '\n') continue;
+        ++nl;
+        if (i > 0 && p[i - 1] == '\r') ++crlf;
+      }
+      NewlineCount c = count_newlines(p, n);
+      assert(c.newlines == nl && c.crlf == crlf);
+      assert(find_newlines(p, n, 7, pos.data()) == nl);
+      for (size_t i = 0; i < n; ++i) if (p[i] == '\n') assert(pos[k++] == i + 7);
+    }
+  }
+  use_newline_scan_kernel(best);
+}
+
+/*the readers split lines at '\n', drop a '\r' before one and at the end, and every core loads an arena like the same lines*/
+static void test_read_arena() {
+  auto path = std::filesystem::temp_directory_path() / "mvim_read_arena.txt";
+  auto same = [&](const std::string& bytes) {
+    { std::ofstream(path, std::ios::binary) << bytes; }
+    std::vector<std::string> want(1);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      if (bytes[i] == '\n') { if (!want.back().empty() && want.back().back() == '\r') want.back().pop_back(); want.emplace_back(); }
+      else want.back() += bytes[i];
+    }
+    if (!want.back().empty() && want.back().back() == '\r') want.back().pop_back();
+    std::string msg;
+    std::vector<std::string> lines;
+    LineArena arena;
+    assert(mmap_readlines(path, lines, msg) && mmap_readarena(path, arena, msg));
+    assert(lines == want && arena.size() == lines.size());
+    size_t bytes_in = 0;
+    for (size_t i = 0; i < lines.size(); ++i) { assert(arena[i] == lines[i]); bytes_in += lines[i].size(); }
+    assert(arena.bytes() == bytes_in);
+    return lines;
+  };
+  same("");
+  same("a\nbc\n");
+  same("a\nbc");
+  same("a\r\nb\r\n\r\n");
+  same("\r\r\n\r");
+  same("x\r");
+  // many parts, with CRLF pairs and lone CRs landing on their boundaries
+  std::string big;
+  for (int i = 0; big.size() < (5u << 20); ++i) big += "line " + std::to_string(i) + (i % 3 == 0 ? "\r\n" : i % 7 == 0 ? "\r\r\n" : "\n");
+  // two parts split between a '\r' and its '\n', and a line running through several parts
+  const size_t part = 1 << 20;
+  same(std::string(part - 1, 'a') + "\r\n" + std::string(part - 3, 'b') + "\r\n");
+  same("x\n" + std::string(3 * part, 'c') + "\r\ny\r");
+  auto lines = same(big);
+  LineArena arena;
+  std::string msg;
+  assert(mmap_readarena(path, arena, msg));
+  auto loads_same = [&](auto core) {
+    core.init_from_arena(arena);
+    assert(core.line_count() == static_cast<int>(lines.size()));
+    for (size_t i = 0; i < lines.size(); i += 997) assert(core.get_line(static_cast<int>(i)) == lines[i]);
+    assert(core.get_line(static_cast<int>(lines.size()) - 1) == lines.back());
+  };
+  loads_same(VectorTextBufferCore());
+  loads_same(GapTextBufferCore());
+  loads_same(RopeTextBufferCore());
+  loads_same(PersistentRopeTextBufferCore());
+  loads_same(BTreeTextBufferCore());
+  loads_same(ByteRopeTextBufferCore());
+  loads_same(PieceTableTextBufferCore());
+  loads_same(TieredVectorTextBufferCore());
+  std::filesystem::remove(path);
+}
+
+/*the index finds every '\n' across checkpoints, and its sidecar is reused, extended on growth and dropped when stale*/
+static void test_newline_index() {
+  auto dir = std::filesystem::temp_directory_path() / "mvim_nlx_cache";
+  auto path = std::filesystem::temp_directory_path() / "mvim_nlx.txt";
+  std::filesystem::remove_all(dir);
+  ::setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+  std::string text;
+  for (int i = 0; i < 5000; ++i) text += std::string(i % 200, 'x') + (i == 3000 ? "\r\n" : "\n");
+  auto positions = [](std::string_view t) {
+    std::vector<uint64_t> v;
+    for (size_t i = 0; i < t.size(); ++i) if (t[i] == '\n') v.push_back(i);
+    return v;
+  };
+  auto same = [&](const NewlineIndex& idx, std::string_view t) {
+    auto want = positions(t);
+    assert(idx.newlines() == want.size() && idx.indexed_bytes() == t.size());
+    for (size_t k = 0; k < want.size(); k += 7) assert(idx.newline(k) == want[k]);
+    std::vector<uint64_t> got;
+    idx.for_each([&](uint64_t at) { got.push_back(at); });
+    assert(got == want);
+  };
+  NewlineIndex idx;
+  idx.extend(std::string_view(text).substr(0, 1000));
+  idx.extend(text);
+  same(idx, text);
+  assert(idx.crlf() == 1);
+
+  { std::ofstream(path, std::ios::binary) << text; }
+  bool grew = true;
+  NewlineIndex miss;
+  assert(!miss.load_cached(path, text, grew));
+  assert(idx.store_cached(path, text) && std::filesystem::exists(NewlineIndex::cache_path(path)));
+  NewlineIndex hit;
+  assert(hit.load_cached(path, text, grew) && !grew && hit.crlf() == 1);
+  same(hit, text);
+  // appended to: only the tail is scanned, and a '\n' right after the old end still sees its '\r'
+  text += "\r\nmore\nlines";
+  { std::ofstream(path, std::ios::binary | std::ios::app) << "\r\nmore\nlines"; }
+  NewlineIndex grown;
+  assert(grown.load_cached(path, text, grew) && grew && grown.crlf() == 2);
+  same(grown, text);
+  // rewritten with a different tail, or truncated: stale
+  assert(grown.store_cached(path, text));
+  text[text.size() - 3] = 'X';
+  text += "\n";
+  { std::ofstream(path, std::ios::binary) << text; }
+  NewlineIndex stale;
+  assert(!stale.load_cached(path, text, grew));
+  { std::ofstream(path, std::ios::binary) << "a\n"; }
+  assert(!stale.load_cached(path, "a\n", grew));
+  // edited well before the old end, same tail, then appended to: the checkpoints catch it
+  { std::ofstream(path, std::ios::binary) << text; }
+  NewlineIndex fresh;
+  fresh.extend(text);
+  assert(fresh.store_cached(path, text));
+  std::string edited = text;
+  edited.erase(20, 1);
+  edited.insert(edited.size() / 2, "y");
+  edited += "\nappended";
+  { std::ofstream(path, std::ios::binary) << edited; }
+  assert(!stale.load_cached(path, edited, grew));
+  // a corrupt sidecar is dropped rather than trusted: a checkpoint past the end of the file
+  { std::ofstream(path, std::ios::binary) << text; }
+  assert(fresh.store_cached(path, text));
+  {
+    std::fstream f(NewlineIndex::cache_path(path), std::ios::binary | std::ios::in | std::ios::out);
+    size_t key = path.lexically_normal().string().size();
+    f.seekp(static_cast<std::streamoff>(88 + ((key + 7) & ~size_t(7)) + 16));
+    uint64_t bad = text.size() + 100;
+    f.write(reinterpret_cast<const char*>(&bad), sizeof(bad));
+  }
+  assert(!stale.load_cached(path, text, grew) && stale.newlines() == 0);
+
+  // the piece table cut from an index reads like one that scanned
+  std::string clean;
+  for (int i = 0; i < 3000; ++i) clean += "row " + std::to_string(i) + "\n";
+  clean += "end";
+  { std::ofstream(path, std::ios::binary) << clean; }
+  auto file = std::make_shared<MappedFile>();
+  assert(file->open(path.c_str()));
+  NewlineIndex ci;
+  ci.extend(file->view());
+  PieceTableTextBufferCore a, b;
+  std::string msg;
+  a.open_mapped(file, ci);
+  assert(b.open_file(path, msg));
+  assert(a.line_count() == 3001 && a.line_count() == b.line_count() && a.byte_count() == b.byte_count());
+  for (int r = 0; r < a.line_count(); r += 13) assert(a.get_line(r) == b.get_line(r));
+  assert(a.get_line(3000) == "end" && a.check_invariants());
+  ::unsetenv("XDG_CACHE_HOME");
+  std::filesystem::remove(path);
+  std::filesystem::remove_all(dir);
+}
+
+/*grow a tiered vector 16x and back so its chunks are rebuilt both ways*/
+static void test_tiered_retier() {
+  TieredVectorTextBufferCore c;
+  c.init_from_lines({"a", "b"});
+  assert(c.chunk_lines() == 64);
+  std::vector<std::string> block(500, "x");
+  for (int i = 0; i < 200; ++i) c.insert_lines(1, block);
+  assert(c.line_count() == 100002 && c.chunk_lines() >= 256 && c.check_invariants());
+  assert(c.get_line(0) == "a" && c.get_line(50000) == "x" && c.get_line(100001) == "b");
+  c.erase_lines(1, 100001);
+  assert(c.line_count() == 2 && c.chunk_lines() <= 128 && c.check_invariants());
+  assert(c.get_line(0) == "a" && c.get_line(1) == "b");
+}
+
+void run_backend_tests() {
+  test_packed_lines();
+  test_rope_measures();
+  auto no_check = [](const auto&) {};
+  run_random_edits<VectorTextBufferCore>(1, 2000, no_check);
+  run_random_edits<GapTextBufferCore>(2, 4000, no_check);
+  // tiny index blocks, so every edit splits or merges some
+  struct SmallBlockGap : GapTextBufferCore { SmallBlockGap() { li.block_size = 4; } };
+  run_random_edits<SmallBlockGap>(8, 300, [](const SmallBlockGap& c) {
+    // the patched index must match one built from scratch
+    LineIndex fresh;
+    fresh.block_size = 4;
+    fresh.build_from_text(c.gb.buf, c.gb.gap_start, c.gb.gap_end);
+    assert(fresh.line_count() == c.li.line_count());
+    for (size_t r = 0; r < fresh.line_count(); ++r) assert(fresh.line_start(r) == c.li.line_start(r));
+  }, 200);
+  run_random_edits<RopeTextBufferCore>(3, 4000, [](const RopeTextBufferCore& c) {
+    std::string why;
+    bool ok = c.check_invariants(&why);
+    assert(ok && why.empty());
+    (void)ok;
+  });
+  run_random_edits<PersistentRopeTextBufferCore>(4, 4000, [](const PersistentRopeTextBufferCore& c) {
+    assert(c.check_invariants());
+    // editing a copy must never leak into the original
+    PersistentRopeTextBufferCore snap = c.snapshot();
+    std::string before = c.get_line(0);
+    snap.replace_line(0, std::string_view("changed"));
+    snap.insert_line(0, std::string_view("new"));
+    assert(c.get_line(0) == before);
+    assert(snap.line_count() == c.line_count() + 1);
+  });
+  auto btree_check = [](const BTreeTextBufferCore& c) {
+    std::string why;
+    bool ok = c.check_invariants(&why);
+    assert(ok && why.empty());
+    (void)ok;
+  };
+  run_random_edits<BTreeTextBufferCore>(5, 4000, btree_check);
+  // big enough for three levels, so inner nodes split, merge and rebalance too
+  run_random_edits<BTreeTextBufferCore>(6, 1000, btree_check, 20000);
+  run_random_edits<ByteRopeTextBufferCore>(7, 4000, [](const ByteRopeTextBufferCore& c) {
+    std::string why;
+    bool ok = c.check_invariants(&why);
+    assert(ok && why.empty());
+    (void)ok;
+  });
+  auto tiered_check = [](const TieredVectorTextBufferCore& c) {
+    std::string why;
+    bool ok = c.check_invariants(&why);
+    assert(ok && why.empty());
+    (void)ok;
+  };
+  run_random_edits<TieredVectorTextBufferCore>(10, 4000, tiered_check);
+  run_random_edits<TieredVectorTextBufferCore>(11, 1000, tiered_check, 20000);
+  test_tiered_retier();
+  test_mapped_view();
+  test_piece_spill();
+  run_random_edits<PieceTableTextBufferCore>(9, 4000, [](const PieceTableTextBufferCore& c) {
+    std::string why;
+    bool ok = c.check_invariants(&why);
+    assert(ok && why.empty());
+    (void)ok;
+  });
+  test_piece_open();
+  test_task_pool();
+  test_newline_scan();
+  test_read_arena();
+  test_newline_index();
+  // one huge line: windows and in-line edits must agree with a plain string
+  {
+    std::string ref(1 << 20, 'a');
+    for (size_t i = 0; i < ref.size(); i += 7) ref[i] = static_cast<char>('a' + i % 26);
+    ByteRopeTextBufferCore c;
+    c.init_from_lines({"first", ref, "last"});
+    assert(c.line_count() == 3);
+    assert(c.line_length(1) == ref.size());
+    assert(c.line_slice(1, 500000, 80) == ref.substr(500000, 80));
+    assert(c.line_slice(1, ref.size() - 3, 80) == ref.substr(ref.size() - 3));
+    c.insert_text(1, 300000, "XYZ");
+    ref.insert(300000, "XYZ");
+    c.erase_text(1, 10, 5000);
+    ref.erase(10, 5000);
+    c.insert_text(1, ref.size(), std::string(10000, 'q'));
+    ref.append(10000, 'q');
+    assert(c.get_line(1) == ref);
+    std::string scratch;
+    assert(c.get_line_view(1, scratch) == ref && c.get_line_view(0, scratch) == "first");
+    auto it = c.line_cursor(2);
+    assert(it.view(scratch) == "last");
+    it.prev();
+    assert(it.length() == ref.size() && it.view(scratch) == ref && it.slice(400000, 50) == ref.substr(400000, 50));
+    it.prev();
+    assert(it.row() == 0 && it.view(scratch) == "first");
+    assert(c.get_line(0) == "first" && c.get_line(2) == "last");
+    assert(c.check_invariants());
+  }
+}
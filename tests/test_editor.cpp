@@ -0,0 +1,69 @@
+#include "editor.hpp"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+/*drives Editor's private command path without a terminal*/
+struct EditorTestAccess {
+  static void command(Editor& ed, const std::string& line) {
+    ed.cmdline = line;
+    ed.execute_command();
+  }
+  static void keys(Editor& ed, const std::string& ks) { for (char k : ks) ed.handle_input(static_cast<unsigned char>(k)); }
+  static const Editor::Document& doc(const Editor& ed) { return ed.doc(); }
+  static const std::string& message(const Editor& ed) { return ed.message; }
+  static const Editor::Document* pane_doc(const Editor& ed, int idx) { return ed.panes[static_cast<size_t>(idx)].doc.get(); }
+};
+
+void run_editor_tests() {
+  auto path = std::filesystem::temp_directory_path() / "mvim_editor_view.txt";
+  { std::ofstream(path, std::ios::binary) << "one\ntwo\n"; }
+  // :view then :edit of the same file gives back an editable document
+  {
+    Editor ed(std::nullopt);
+    EditorTestAccess::command(ed, "view " + path.string());
+#if TB_BACKEND == TB_BACKEND_AUTO
+    assert(EditorTestAccess::doc(ed).read_only && EditorTestAccess::doc(ed).buf.backend_name() == "view");
+#endif
+    EditorTestAccess::command(ed, "edit " + path.string());
+    assert(!EditorTestAccess::doc(ed).read_only && EditorTestAccess::doc(ed).buf.backend_name() != "view");
+    assert(EditorTestAccess::doc(ed).buf.line(1) == "two");
+  }
+  // a view does not take over the editable document another pane has open
+  {
+    Editor ed(path);
+    EditorTestAccess::command(ed, "vsplit " + path.string());
+    const auto* shared = EditorTestAccess::pane_doc(ed, 0);
+    assert(EditorTestAccess::pane_doc(ed, 1) == shared);
+    EditorTestAccess::command(ed, "view");
+    EditorTestAccess::command(ed, "edit " + path.string());
+    assert(EditorTestAccess::pane_doc(ed, 0) == shared && EditorTestAccess::pane_doc(ed, 1) == shared);
+    assert(!shared->read_only);
+  }
+  // :set maxmem=0 only lifts a cap, and a size that overflows is refused; neither moves the document
+  {
+    Editor ed(path);
+    std::string before(EditorTestAccess::doc(ed).buf.backend_name());
+    EditorTestAccess::command(ed, "set maxmem=0");
+    assert(EditorTestAccess::doc(ed).buf.backend_name() == before && EditorTestAccess::message(ed) == "maxmem=0");
+    EditorTestAccess::command(ed, "set maxmem=99999999999G");
+    assert(EditorTestAccess::doc(ed).buf.backend_name() == before && EditorTestAccess::message(ed) == "set maxmem: size too large");
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+    EditorTestAccess::command(ed, "set maxmem=8M");
+    const TextBuffer& spilled = EditorTestAccess::doc(ed).buf;
+    assert(spilled.backend_name() == "piece" && spilled.line(1) == "two");
+    assert(std::get<PieceTableTextBufferCore>(spilled.core).spilled_bytes() > 0);
+#endif
+  }
+  // insert-mode keystrokes land in the buffer directly, each one undoable on its own
+  {
+    Editor ed(path);
+    EditorTestAccess::command(ed, "set pair on");
+    EditorTestAccess::keys(ed, "iab\x7f(x\x1b");
+    assert(EditorTestAccess::doc(ed).buf.line(0) == "a(x)one");
+    EditorTestAccess::keys(ed, "u");
+    assert(EditorTestAccess::doc(ed).buf.line(0) == "a()one");
+  }
+  std::filesystem::remove(path);
+}
@@ -1,9 +1,18 @@
 #include "text_buffer.hpp"
+#include "undo_manager.hpp"
+#include "progressive_load.hpp"
+#include "file_reader.hpp"
 #include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include <vector>
 
 void run_layout_tests();
+void run_backend_tests();
+void run_editor_tests();
 
 int main() {
   TextBuffer b;
@@ -22,6 +31,151 @@ int main() {
   b.erase_lines(1, 3);
   assert(b.line_count() == 1);
   assert(b.line(0) == std::string("a"));
+  TextBuffer snap = b.snapshot();
+  b.replace_line(0, "q");
+  assert(snap.line(0) == std::string("a"));
+  assert(b.line(0) == std::string("q"));
+#if TB_BACKEND == TB_BACKEND_AUTO
+  // :backend prope gives the default build O(1) snapshots that still diverge on edit
+  assert(b.set_backend("prope"));
+  TextBuffer psnap = b.snapshot();
+  assert(psnap.backend_name() == "prope");
+  b.insert_text(0, 1, "r");
+  assert(psnap.line(0) == "q" && b.line(0) == "qr");
+#endif
+  // batched edits: given out of order, the overlapping one is dropped
+  b.init_from_lines({"0", "1", "2", "3", "4"});
+  b.apply_edits({{3, 2, {"x"}}, {0, 1, {"a", "b"}}, {4, 1, {"dropped"}}, {2, 0, {"i"}}});
+  assert(b.line_count() == 6);
+  assert(b.line(0) == "a" && b.line(1) == "b" && b.line(2) == "1" && b.line(3) == "i" && b.line(4) == "2" && b.line(5) == "x");
+  b.apply_edits({{0, 6, {}}});
+  assert(b.line_count() == 1 && b.line(0).empty());
+  // a run of ReplaceLine ops is undone and redone as one batch
+  b.init_from_lines({"a", "b", "c"});
+  UndoManager um;
+  Cursor cur{0, 0};
+  um.begin_group(cur);
+  for (int r = 0; r < 3; ++r) um.push_op({Operation::ReplaceLine, r, 0, b.line(r), " " + b.line(r)});
+  um.push_op({Operation::ReplaceLine, 1, 0, " b", "  b"});
+  b.apply_edits({{0, 3, {" a", "  b", " c"}}});
+  um.commit_group(cur);
+  um.undo(b, cur);
+  assert(b.line(0) == "a" && b.line(1) == "b" && b.line(2) == "c");
+  um.redo(b, cur);
+  assert(b.line(0) == " a" && b.line(1) == "  b" && b.line(2) == " c");
+  // live migration through every backend of this build keeps the text
+  b.init_from_lines({"one", "two", "three"});
+  std::string names = TextBuffer::backend_names();
+#if TB_BACKEND == TB_BACKEND_AUTO
+  assert(names == "vector|gap|rope|prope|btree|byterope|piece|tiered");
+#endif
+  for (size_t st = 0; st <= names.size();) {
+    size_t bar = std::min(names.find('|', st), names.size());
+    std::string name = names.substr(st, bar - st);
+    st = bar + 1;
+    assert(b.set_backend(name) && b.backend_name() == name);
+    assert(b.line_count() == 3 && b.line(0) == "one" && b.line(2) == "three");
+    TextBuffer copy = b.snapshot();
+    assert(copy.backend_name() == name && copy.line_count() == 3 && copy.line(1) == "two");
+    b.insert_text(1, 3, "!");
+    assert(b.line(1) == "two!");
+    b.erase_text(1, 3, 1);
+  }
+  assert(!b.set_backend("no-such-backend"));
+  // the view is only loaded into, never switched to
+  assert(names.find("view") == std::string::npos && !b.set_backend("view"));
+  assert(b.line(1) == "two");
+  // progressive open: small batches, CRLF only past the first one, an edit mid-load
+  {
+    auto path = std::filesystem::temp_directory_path() / "mvim_progressive.txt";
+    std::string bytes;
+    for (int i = 0; i < 3000; ++i) bytes += "row " + std::to_string(i) + (i > 100 && i % 5 == 0 ? "\r\n" : "\n");
+    bytes += std::string(5000, 'w') + "\nlast\r";
+    { std::ofstream(path, std::ios::binary) << bytes; }
+    std::vector<std::string> want;
+    std::string msg;
+    assert(mmap_readlines(path, want, msg));
+    for (const char* name : {"vector", "rope", "piece"}) {
+      ProgressiveLoad::Options opt;
+      opt.first_bytes = 300;
+      opt.batch_bytes = 1000;
+      opt.backend = name;
+      TextBuffer pb;
+      auto load = ProgressiveLoad::start(path, pb, msg, opt);
+      assert(load && !load->done() && pb.line_count() < static_cast<int>(want.size()));
+      assert(pb.line(0) == "row 0" && load->percent() < 100);
+      pb.insert_text(0, 0, "> ");
+      load->wait_rows(pb, 1000);
+      assert(pb.line_count() >= 1000 && pb.line(999) == want[999]);
+      while (!load->pump(pb, std::chrono::microseconds(100))) {}
+      assert(load->done() && load->percent() == 100);
+      assert(pb.line_count() == static_cast<int>(want.size()) && pb.line(0) == "> row 0");
+      for (size_t i = 1; i < want.size(); ++i) assert(pb.line(static_cast<int>(i)) == want[i]);
+    }
+#if TB_BACKEND == TB_BACKEND_AUTO
+    {
+      ProgressiveLoad::Options opt;
+      opt.first_bytes = 300;
+      opt.batch_bytes = 1000;
+      opt.backend = "view";
+      TextBuffer pb;
+      auto load = ProgressiveLoad::start(path, pb, msg, opt);
+      assert(load && pb.backend_name() == "view" && pb.line(0) == "row 0");
+      load->wait_rows(pb, 1000);
+      assert(pb.line_count() >= 1000 && pb.line(999) == want[999]);
+      load->finish(pb);
+      assert(pb.line_count() == static_cast<int>(want.size()) && pb.byte_count() == bytes.size());
+      for (size_t i = 0; i < want.size(); ++i) assert(pb.line(static_cast<int>(i)) == want[i]);
+    }
+#endif
+    { std::ofstream(path, std::ios::binary) << "a\nb"; }
+    TextBuffer pb;
+    auto load = ProgressiveLoad::start(path, pb, msg);
+    assert(load && load->done() && pb.line_count() == 2 && pb.line(1) == "b");
+    std::filesystem::remove(path);
+  }
+#if TB_BACKEND == TB_BACKEND_AUTO
+  // a file with one huge line opens on the byterope, copied or progressive
+  {
+    auto path = std::filesystem::temp_directory_path() / "mvim_long_line.txt";
+    { std::ofstream(path, std::ios::binary) << "head\n" << std::string(TB_AUTO_BYTEROPE_LINE_BYTES, 'j') << "\ntail"; }
+    std::string msg;
+    bool ok = false;
+    TextBuffer lb = TextBuffer::from_file(path, msg, ok);
+    assert(ok && lb.backend_name() == "byterope" && lb.line_count() == 3);
+    assert(lb.line_length(1) == TB_AUTO_BYTEROPE_LINE_BYTES && lb.line(2) == "tail");
+    TextBuffer pb;
+    auto load = ProgressiveLoad::start(path, pb, msg);
+    assert(load && pb.backend_name() == "byterope");
+    load->finish(pb);
+    assert(pb.line_count() == 3 && pb.line_length(1) == TB_AUTO_BYTEROPE_LINE_BYTES);
+    std::filesystem::remove(path);
+  }
+#endif
+  // write_file streams the text: lines on the default backend, pieces on a budgeted piece table
+  {
+    auto path = std::filesystem::temp_directory_path() / "mvim_write.txt";
+    auto slurp = [&] { std::ifstream in(path, std::ios::binary); return std::string(std::istreambuf_iterator<char>(in), {}); };
+    TextBuffer wb;
+    wb.init_from_lines({"alpha", "", "gamma"});
+    std::string msg;
+    assert(wb.write_file(path, msg) && slurp() == "alpha\n\ngamma");
+#if TB_BACKEND == TB_BACKEND_AUTO || TB_BACKEND == TB_BACKEND_PIECE
+    assert(wb.set_backend("piece") && wb.set_memory_budget(1));
+    wb.insert_text(1, 0, "beta");
+    wb.split_line(2, 2);
+    assert(wb.write_file(path, msg) && slurp() == "alpha\nbeta\nga\nmma");
+#endif
+#if TB_BACKEND == TB_BACKEND_AUTO
+    assert(wb.set_backend("vector") && !wb.set_memory_budget(1));
+    // moving onto the piece table under a budget spills the text on the way in
+    assert(wb.set_backend("piece", 1) && std::get<PieceTableTextBufferCore>(wb.core).spilled_bytes() > 0);
+    assert(wb.write_file(path, msg) && slurp() == "alpha\nbeta\nga\nmma");
+#endif
+    std::filesystem::remove(path);
+  }
   run_layout_tests();
+  run_backend_tests();
+  run_editor_tests();
   return 0;
 }